@@ -30,19 +30,39 @@
 #ifndef _CB_WINDOW_H
 #define _CB_WINDOW_H
 #include <math.h>
+#include <cmath>
 #include <stdio.h>
+#include <stdlib.h>
 #include "general.h" 
-#include "lmcurve.h"
 #include "window.h"
+#include "ohlc.hpp"
+#include "pane.hpp"
+#if defined(FIT_LMCURVE)
+#include "lmcurve.h"
+#else
+#include "parabola_fit.hpp"
+#endif
 
 /**
  * The CBWindow class represent a count based window of elements Tuple.
  * It extends the abstract class Window.
  *
+ * Only the fields needed for the computation are kept, in a structure of arrays
+ * layout: timestamps, bid prices and ask prices are stored in separate contiguous
+ * (cache aligned) arrays. A price whose size is not positive is not a valid quote and
+ * it is stored as NaN. In this way an element takes 16 bytes instead of the 64 of a tuple_t.
+ *
  * It is characterized by a window_size and a window_slide. The computation
  * may be triggered after the insertion of window_slide elements and regards the last
  * window_size elements.
  *
+ * By default the parabola is fitted in closed form: the power sums of the points are
+ * updated at each insertion (adding the new quote and removing the evicted one), therefore
+ * a computation costs O(window_slide) instead of O(window_size). To limit the accumulation
+ * of rounding errors the sums are rebuilt from scratch every time the window content is
+ * completely replaced. Compiling with -DFIT_LMCURVE the original fitting with lmcurve
+ * (Levenberg-Marquardt on the whole window) is used instead, for comparison purposes.
+ *
  */
 class CBWindow : public Window<tuple_t,winresult_t>{
 	
@@ -52,35 +72,62 @@ public:
      * Constructor of the Count Based Window
      * @param window_size
      * @param window_slide
+     * @param storage if not NULL, cache aligned memory (of storageSize(window_size,window_slide) bytes) in which
+     * the window content will be kept. It is owned by the caller
      */
-	CBWindow(int window_size, int window_slide)
+	CBWindow(int window_size, int window_slide, void *storage=NULL)
 	{
 		this->window_size=window_size;
 		this->window_slide=window_slide;
-        elements=new tuple_t[window_size];
+        elements=NULL;
+        external_storage=(storage!=NULL);
+        if(!external_storage && posix_memalign(&storage,CACHE_LINE_SIZE,storageSize(window_size,window_slide))!=0)
+        {
+            fprintf(stderr,"Error in allocating window\n");
+            exit(-1);
+        }
+        //the three arrays are contiguous, each one starting on a different cache line
+        timestamps=(long *)storage;
+        bid_prices=(float *)((char *)storage+alignedSize(window_size*sizeof(long)));
+        ask_prices=(float *)((char *)bid_prices+alignedSize(window_size*sizeof(float)));
 
 
+#if defined(FIT_LMCURVE)
         x_bid=new double[window_size];
         x_ask=new double[window_size];
         y_bid=new double[window_size];
         y_ask=new double[window_size];
+#endif
 		ins_pointer=0; // DA RIPULIRE
 		eflc=0;
         total_elements=0;
+        first_iid=0;
 
 		
 	}
 
 	~CBWindow()
 	{
-        delete[] elements;
+        if(!external_storage)
+            free(timestamps);
+#if defined(FIT_LMCURVE)
         delete[] x_bid;
         delete[] x_ask;
         delete[] y_bid;
         delete[] y_ask;
+#endif
 
 	}
 
+    /**
+     * @brief storageSize returns the memory needed for the content of a window of the given size
+     * (the slide does not matter, it is there for uniformity with PaneWindow)
+     */
+    static size_t storageSize(int window_size, int /*window_slide*/)
+    {
+        return alignedSize(window_size*sizeof(long))+2*alignedSize(window_size*sizeof(float));
+    }
+
 	int getSize()
 	{
 		return window_size;
@@ -90,6 +137,20 @@ public:
 		return total_elements;
 	}
 
+    /**
+     * @brief setFirstId the window (that must be empty) receives the quotes of its class starting from the
+     * one with the given internal id, instead of the first one
+     */
+    void setFirstId(int64_t iid)
+    {
+        first_iid=iid;
+    }
+
+    int64_t getFirstId()
+    {
+        return first_iid;
+    }
+
 
 
     /**
@@ -99,13 +160,34 @@ public:
     void insert(const tuple_t& t)
 	{
 
-
-        elements[ins_pointer]=t;
+#if !defined(FIT_LMCURVE)
+        if(total_elements>=window_size) //the oldest element is going to be overwritten
+        {
+            evict(bid,true,ins_pointer);
+            evict(ask,false,ins_pointer);
+        }
+        else if(total_elements==0)
+        {
+            bid.moments.clear(t.original_timestamp);
+            ask.moments.clear(t.original_timestamp);
+        }
+#endif
+        timestamps[ins_pointer]=t.original_timestamp;
+        bid_prices[ins_pointer]=(t.bid_size>0)?t.bid_price:NAN;
+        ask_prices[ins_pointer]=(t.ask_size>0)?t.ask_price:NAN;
+#if !defined(FIT_LMCURVE)
+        push(bid,t.original_timestamp,t.bid_size>0,t.bid_price);
+        push(ask,t.original_timestamp,t.ask_size>0,t.ask_price);
+#endif
         ins_pointer++;
 		if(ins_pointer==window_size) //Reset the insertion pointer
 			ins_pointer=0;
 		eflc++;
 		total_elements++;
+#if !defined(FIT_LMCURVE)
+        if(ins_pointer==0) //the content has been completely replaced
+            rebuild();
+#endif
       //  std::cout<< "Inserted element with id: "<<t.id<<std::endl;
      }
 
@@ -130,10 +212,23 @@ public:
         if(eflc!=window_slide) //we compute only if the window is computable
             return;
 
+        eflc=0;
+#if !defined(FIT_LMCURVE)
+        //the power sums are already up to date: x-values start from the oldest element in window
+        double origin=timestamps[total_elements>=window_size?ins_pointer:0];
+        fit(bid,origin,par_bid);
+        res.p0_bid=par_bid[0];
+        res.p1_bid=par_bid[1];
+        res.p2_bid=par_bid[2];
+        fit(ask,origin,par_ask);
+        res.p0_ask=par_ask[0];
+        res.p1_ask=par_ask[1];
+        res.p2_ask=par_ask[2];
+        int start_idx, end_idx;
+#else
         lm_control_struct control = lm_control_double;
         control.verbosity = 0;
 
-        eflc=0;
         //Now we have to compute considering the last window_size element received
         //that is starting from ins_pointer (and threating the elements array as a circular buffer)
         //For the interpolation part we have to consider the element from zero up to the actual insertion pointer.
@@ -147,50 +242,11 @@ public:
         //occur with the same timestamp. In this case, for the fitting phase, it is kept a single point whose
         //y-cord correspond to the average price value
 
-        int npoints=0;
-        int j=0;
+        int npoints;
         int start_idx, end_idx;
-        if(total_elements>=window_size) //there is a full window
-        {
-            start_idx=ins_pointer;
-            end_idx=ins_pointer+window_size;
-        }
-        else //we have only a partial window (we have to start from zero)
-        {
-            start_idx=0;
-            end_idx=ins_pointer;
-
-        }
-        //if(elements[0].type==212)
-        //	printf("Partiamo da %d per un numero di punti pari a: %d\n",start_idx,end_idx-start_idx);
 
         //Building the vectors for bid quotes
-        for(int i=start_idx;i<end_idx;)
-        {
-            if(elements[i%window_size].bid_size>0)
-            {
-                x_bid[npoints]=(elements[i%window_size].original_timestamp-elements[start_idx].original_timestamp); //ins_pointer is the older element
-                y_bid[npoints]=elements[i%window_size].bid_price;
-                j=(i+1);
-
-                //check if subsequent point have the same x-value
-                while(j<end_idx && (elements[i%window_size].original_timestamp)==(elements[j%window_size].original_timestamp)  && elements[j%window_size].bid_size>0)
-                {
-                    y_bid[npoints]+=elements[j%window_size].bid_price;
-                    j++;
-                }
-                y_bid[npoints]/=(j-i);
-
-                //go ahead
-                i=j; //j point to the next value with different timestamp
-                npoints++; //next point to be derived
-            }
-            else //go to the next one
-                i++;
-
-
-
-        }
+        npoints=buildPoints(bid_prices,x_bid,y_bid);
         //now we can perform the fitting
 
         lm_status_struct status;
@@ -203,33 +259,7 @@ public:
         res.p1_bid=par_bid[1];
         res.p2_bid=par_bid[2];
         //Building the vectors for ask quotes
-        npoints=0;
-        for(int i=start_idx;i<end_idx;)
-        {
-            if(elements[i%window_size].ask_size>0)
-            {
-                x_ask[npoints]=(elements[i%window_size].original_timestamp-elements[start_idx].original_timestamp); //ins_pointer is the older element
-                y_ask[npoints]=elements[i%window_size].ask_price;
-                j=(i+1);
-
-                //check if subsequent point have the same x-value
-                while( j<end_idx && (elements[i%window_size].original_timestamp)==(elements[j%window_size].original_timestamp) && elements[j%window_size].ask_size>0)
-                {
-                    y_ask[npoints]+=elements[j%window_size].ask_price;
-                    j++;
-                }
-                y_ask[npoints]/=(j-i);
-
-                //go ahead
-                i=j; //j point to the next value with different timestamp
-                npoints++; //next point to be derived
-            }
-            else //go to the next one
-                i++;
-
-
-
-        }
+        npoints=buildPoints(ask_prices,x_ask,y_ask);
         //now we can perform the fitting
         //printf("Lmcurve: eseguo con %d punti\n",npoints);
         //just a guess
@@ -239,6 +269,7 @@ public:
         res.p0_ask=par_ask[0];
         res.p1_ask=par_ask[1];
         res.p2_ask=par_ask[2];
+#endif
         //printf("Scattato slide per classe: %d, tot elementi ricevuti: %Ld Elementi distinti:%d\n",t->type,total_elements,npoints);
         /*printf("X: ");
         for(int i=0;i<ins_pointer;i++)
@@ -266,40 +297,17 @@ public:
             end_idx=ins_pointer;
             start_idx=end_idx-window_slide;
         }
-        res.low_bid=10000;
-        res.low_ask=10000;
-        res.high_bid=0;
-        res.high_ask=0;
-        res.open_bid=0;
-        res.open_ask=0;
-        int last_valid_bid=0, last_valid_ask=0;
-        for(int i=start_idx;i<end_idx;i++)
-        {
-            //compute for both ask and bid (taking into account only vaules !=0)
-            if(elements[i].bid_size>0)
-            {
-                if(res.open_bid==0)
-                    res.open_bid=elements[i].bid_price;
-                if(elements[i].bid_price>res.high_bid)
-                    res.high_bid=elements[i].bid_price;
-                if(elements[i].bid_price<res.low_bid)
-                    res.low_bid=elements[i].bid_price;
-                last_valid_bid=i;
-            }
-            if(elements[i].ask_size>0)
-            {
-                if(res.open_ask==0)
-                    res.open_ask=elements[i].ask_price;
-                if(elements[i].ask_price>res.high_ask)
-                    res.high_ask=elements[i].ask_price;
-                if(elements[i].ask_price<res.low_ask)
-                    res.low_ask=elements[i].ask_price;
-                last_valid_ask=i;
-            }
-
-        }
-        res.close_bid=elements[last_valid_bid].bid_price;
-        res.close_ask=elements[last_valid_ask].ask_price;
+        //both the sides are computed in a single (vectorized, if possible) pass
+        candlestick_t cbid, cask;
+        ohlc(bid_prices+start_idx,ask_prices+start_idx,end_idx-start_idx,&cbid,&cask);
+        res.open_bid=cbid.open;
+        res.close_bid=cbid.close;
+        res.high_bid=cbid.high;
+        res.low_bid=cbid.low;
+        res.open_ask=cask.open;
+        res.close_ask=cask.close;
+        res.high_ask=cask.high;
+        res.low_ask=cask.low;
 
 //        if(elements[0].type==3)
 //        {
@@ -315,16 +323,60 @@ public:
 	{
 		ins_pointer=0;
 		total_elements=0;
+        first_iid=0;
 		eflc=0;
+#if !defined(FIT_LMCURVE)
+        bid=fit_side_t();
+        ask=fit_side_t();
+#endif
 	}
 
+    /**
+     * @brief forEach calls f(timestamp,bid_price,ask_price) on the elements in window, from the oldest to the
+     * newest (the last one has internal id getFirstId()+getTotalElements()-1). Prices of the sides that are not valid are NaN
+     */
+    template <typename F>
+    void forEach(F f)
+    {
+        int begin[2], len[2];
+        int nspans=spans(begin,len);
+        for(int s=0;s<nspans;s++)
+            for(int i=begin[s];i<begin[s]+len[s];i++)
+                f(timestamps[i],bid_prices[i],ask_prices[i]);
+    }
+
+    /**
+     * @brief summarize calls f(pane_summary_t *) on the summaries of the panes in window (see pane.hpp), starting
+     * from the one with internal id from_iid (that must be the first of a pane). The last one is the current pane,
+     * if it is not complete
+     */
+    template <typename F>
+    void summarize(int64_t from_iid, F f)
+    {
+        int64_t iid=first_iid+total_elements-((total_elements<window_size)?total_elements:window_size); //oldest element in window
+        pane_summary_t pane;
+        pane.n=0;
+        forEach([&](long ts, float bid, float ask){
+            if(iid>=from_iid)
+            {
+                if(pane.n==0)
+                    pane_init(&pane,iid);
+                pane_add(&pane,ts,bid,ask);
+                if((iid+1)%window_slide==0)
+                {
+                    f(&pane);
+                    pane.n=0;
+                }
+            }
+            iid++;
+        });
+        if(pane.n>0)
+            f(&pane);
+    }
+
     /*
      * Just for coding purposes
      */
-	int64_t getLastInserted()
-	{
-        return elements[(ins_pointer-1)].internal_id;
-	}
 	int getInsertionPointer()
 	{
 		return ins_pointer;
@@ -332,24 +384,264 @@ public:
 	
 
 	/**
-		Print the id of all the task contained in the elements array, starting from the oldest one
+		Print the timestamp of the first window_slide elements
 	*/
 	void printAll()
 	{
 		for(int i=0;i<window_slide;i++)
 		{
-            std::cout << i <<"-th element is: "<<elements[i].id <<std::endl;
+            std::cout << i <<"-th element has timestamp: "<<timestamps[i] <<std::endl;
 		}
 	}
 
 
 
 private:
+
+#if !defined(FIT_LMCURVE)
+    /**
+     * State of the incremental fitting for one side of the book (bid or ask).
+     * Quotes with the same timestamp that are contiguous in the window are
+     * represented by a single point (their average price): the newest point may still
+     * grow and the oldest one shrinks as its quotes are evicted. All the points in between
+     * are immutable.
+     */
+    typedef struct fit_side_t{
+        FitMoments moments;     //power sums of the points currently in window
+        int npoints=0;
+        //newest point and whether the next quote may be aggregated to it
+        long tail_ts=0;
+        int tail_n=0;
+        double tail_sum=0;
+        bool tail_open=false;
+        //oldest point
+        long head_ts=0;
+        int head_n=0;
+        double head_sum=0;
+    }fit_side_t;
+
+    /**
+     * Append a quote to the points of one side
+     */
+    void push(fit_side_t &f, long ts, bool valid, double price)
+    {
+        if(!valid)
+        {
+            f.tail_open=false;
+            return;
+        }
+        if(f.tail_open && f.tail_ts==ts)
+        {
+            f.moments.add(ts,f.tail_sum/f.tail_n,-1);
+            f.tail_n++;
+            f.tail_sum+=price;
+        }
+        else
+        {
+            f.tail_ts=ts;
+            f.tail_n=1;
+            f.tail_sum=price;
+            f.tail_open=true;
+            f.npoints++;
+        }
+        f.moments.add(ts,f.tail_sum/f.tail_n);
+        if(f.npoints==1) //oldest and newest point coincide
+        {
+            f.head_ts=f.tail_ts;
+            f.head_n=f.tail_n;
+            f.head_sum=f.tail_sum;
+        }
+    }
+
+    /**
+     * Remove from the points of one side the oldest quote in window (stored at position pos)
+     */
+    void evict(fit_side_t &f, bool is_bid, int pos)
+    {
+        if(!valid(pos,is_bid))
+            return;
+        //the quote belongs to the oldest point
+        f.moments.add(f.head_ts,f.head_sum/f.head_n,-1);
+        f.head_n--;
+        f.head_sum-=price(pos,is_bid);
+        if(f.head_n>0)
+            f.moments.add(f.head_ts,f.head_sum/f.head_n);
+        else
+            f.npoints--;
+        if(f.npoints==1 && f.head_n>0) //oldest and newest point coincide
+        {
+            f.tail_n=f.head_n;
+            f.tail_sum=f.head_sum;
+        }
+        else if(f.npoints==1)
+        {
+            f.head_ts=f.tail_ts;
+            f.head_n=f.tail_n;
+            f.head_sum=f.tail_sum;
+        }
+        else if(f.npoints==0)
+            f.tail_open=false;
+        else if(f.head_n==0)
+        {
+            //the new oldest point is not the newest one: it starts with the first valid quote
+            //after pos. Every quote is scanned here at most once in its lifetime
+            int i=(pos+1<window_size)?pos+1:0;
+            while(!valid(i,is_bid))
+                if(++i==window_size)
+                    i=0;
+            f.head_ts=timestamps[i];
+            f.head_n=0;
+            f.head_sum=0;
+            while(timestamps[i]==f.head_ts && valid(i,is_bid))
+            {
+                f.head_sum+=price(i,is_bid);
+                f.head_n++;
+                if(++i==window_size)
+                    i=0;
+            }
+        }
+    }
+
+
+    /**
+     * Recompute from scratch the power sums, using the oldest element in window as origin
+     */
+    void rebuild()
+    {
+        int begin[2], len[2];
+        int nspans=spans(begin,len);
+        bid=fit_side_t();
+        ask=fit_side_t();
+        bid.moments.clear(timestamps[begin[0]]);
+        ask.moments.clear(timestamps[begin[0]]);
+        for(int s=0;s<nspans;s++)
+        {
+            const long *ts=timestamps+begin[s];
+            const float *pb=bid_prices+begin[s], *pa=ask_prices+begin[s];
+            for(int i=0;i<len[s];i++)
+            {
+                push(bid,ts[i],!std::isnan(pb[i]),pb[i]);
+                push(ask,ts[i],!std::isnan(pa[i]),pa[i]);
+            }
+        }
+    }
+
+    /**
+     * Fit the parabola for one side. As lmcurve, with less than three points the
+     * previous parameters are kept
+     */
+    void fit(fit_side_t &f, double origin, double *par)
+    {
+        //just a guess
+        if(par[0]==0 && f.npoints>0)
+            par[0]=f.head_sum/f.head_n;
+        f.moments.solve(origin,par);
+    }
+
+    fit_side_t bid, ask;
+#endif
+
+    /**
+     * The window content, from the oldest to the newest element, as (at most) two
+     * contiguous spans of the circular buffer
+     * @param begin starting positions of the spans
+     * @param len their lengths
+     * @return the number of spans
+     */
+    int spans(int *begin, int *len)
+    {
+        if(total_elements>=window_size) //full window: from ins_pointer to the end and then from zero
+        {
+            begin[0]=ins_pointer;
+            len[0]=window_size-ins_pointer;
+            begin[1]=0;
+            len[1]=ins_pointer;
+            return (ins_pointer==0)?1:2;
+        }
+        //partial window: from zero
+        begin[0]=0;
+        len[0]=ins_pointer;
+        return 1;
+    }
+
+#if defined(FIT_LMCURVE)
+    /**
+     * Build the points (x,y) for the fitting of one side. Since the market precision is at the
+     * millisecond level, subsequent quotes with the same timestamp are kept as a single point,
+     * whose y-coord corresponds to their average price. x-values start from zero (the oldest element)
+     * @return the number of points
+     */
+    int buildPoints(const float *prices, double *x, double *y)
+    {
+        int begin[2], len[2];
+        int nspans=spans(begin,len);
+        long origin=timestamps[begin[0]];
+        int npoints=0;
+        int run=0; //number of quotes aggregated in the current point (it may continue in the second span)
+        long run_ts=0;
+        for(int s=0;s<nspans;s++)
+        {
+            const long *ts=timestamps+begin[s];
+            const float *p=prices+begin[s];
+            for(int i=0;i<len[s];i++)
+            {
+                if(std::isnan(p[i]))
+                {
+                    if(run>0)
+                        y[npoints-1]/=run;
+                    run=0;
+                }
+                else if(run>0 && ts[i]==run_ts)
+                {
+                    y[npoints-1]+=p[i];
+                    run++;
+                }
+                else
+                {
+                    if(run>0)
+                        y[npoints-1]/=run;
+                    x[npoints]=ts[i]-origin;
+                    y[npoints]=p[i];
+                    run_ts=ts[i];
+                    run=1;
+                    npoints++;
+                }
+            }
+        }
+        if(run>0)
+            y[npoints-1]/=run;
+        return npoints;
+    }
+#endif
+
+    inline bool valid(int i, bool is_bid)
+    {
+        return !std::isnan(is_bid?bid_prices[i]:ask_prices[i]);
+    }
+
+    inline double price(int i, bool is_bid)
+    {
+        return is_bid?bid_prices[i]:ask_prices[i];
+    }
+
+    static size_t alignedSize(size_t size)
+    {
+        return (size+CACHE_LINE_SIZE-1)/CACHE_LINE_SIZE*CACHE_LINE_SIZE;
+    }
+
+    //window content (structure of arrays)
+    bool external_storage;  //true if the memory has not been allocated by the window
+    long *timestamps;       //original timestamps of the quotes
+    float *bid_prices;      //NaN if the quote has not a valid bid
+    float *ask_prices;      //NaN if the quote has not a valid ask
     int window_size;
     int window_slide;
     int64_t total_elements; //total elements that were contained in the window
+    int64_t first_iid;      //internal id of the first element
+#if defined(FIT_LMCURVE)
 	double *x_bid, *x_ask;
 	double *y_bid, *y_ask;
+#endif
 	//for the candlestick computation
 	double open,close, high, low;
 	int ins_pointer; //always points to the insertion point in elements
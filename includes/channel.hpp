@@ -0,0 +1,374 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Batched access to the data channels (splitter->replicas, replicas->merger)
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef CHANNEL_HPP
+#define CHANNEL_HPP
+#include <string.h>
+#include <ff/buffer.hpp>
+#include "cycle.h"
+#include "general.h"
+#include "ready_mask.hpp"
+
+/*
+ * Moving messages one at a time through a SWSR queue makes the cache lines of the queue
+ * bounce between producer and consumer at each message. The producer side (ChannelWriter)
+ * stages the messages locally and pushes them all at once when:
+ * - the batch is full;
+ * - the oldest staged message has waited more than the flush bound (checked at each push
+ *   and by checkFlush);
+ * - the producer explicitly flushes (e.g. before blocking waiting for input).
+ * The consumer side (ChannelReader) pops all the available messages (up to the batch size)
+ * and then hands them out one by one.
+ *
+ * With a batch of one message both sides behave exactly as the plain send/receive wrappers.
+ * Optionally, the writer signals each push on a ReadyMask (used toward the merger).
+ *
+ * NOTE: messages staged by the writer and held by the reader are out of the queue: who recycles
+ * memory on the basis of the queue length (TupleRing, replicas' result buffer) must take into
+ * account additional CHANNEL_MAX_BATCH messages per side.
+ */
+
+/**
+ * Producer side of a channel
+ */
+class ChannelWriter{
+public:
+    /**
+     * @param queue the underlying queue
+     * @param batch maximum number of messages staged before pushing them
+     * @param flush_ticks maximum time (in clock ticks) that a message can stay staged
+     */
+    ChannelWriter(ff::SWSR_Ptr_Buffer *queue=NULL, int batch=1, ticks flush_ticks=0)
+    {
+        init(queue,batch,flush_ticks);
+    }
+
+    void init(ff::SWSR_Ptr_Buffer *queue, int batch, ticks flush_ticks)
+    {
+        this->queue=queue;
+        this->batch=(batch<1)?1:((batch>CHANNEL_MAX_BATCH)?CHANNEL_MAX_BATCH:batch);
+        this->flush_ticks=flush_ticks;
+        n=0;
+        ready_mask=NULL;
+        ready_bit=0;
+    }
+
+    /**
+     * @brief setReadyMask after each push the bit will be set in the mask
+     */
+    inline void setReadyMask(ReadyMask *mask, int bit)
+    {
+        ready_mask=mask;
+        ready_bit=bit;
+    }
+
+    /**
+     * @brief bind changes the underlying queue (there must not be staged messages)
+     */
+    inline void bind(ff::SWSR_Ptr_Buffer *queue)
+    {
+        this->queue=queue;
+    }
+
+    inline ff::SWSR_Ptr_Buffer *getQueue()
+    {
+        return queue;
+    }
+
+    /**
+     * @brief push sends a message. As send(), it fails only if NON_BLOCKING_FF is defined
+     * and the queue remains full
+     * @return 1 on success, 0 otherwise
+     */
+    inline int push(void *t)
+    {
+        if(batch==1 && ready_mask==NULL)
+            return send(t,queue);
+        if(stage(t))
+            return flush();
+        return 1;
+    }
+
+    /**
+     * @brief bpush as push, but it never fails (see bsend)
+     */
+    inline void bpush(void *t)
+    {
+        if(batch==1 && ready_mask==NULL)
+            bsend(t,queue);
+        else
+            if(stage(t))
+                bflush();
+    }
+
+    /**
+     * @brief ci_push as push but blocking, it returns the ticks spent in stall due to backpressure (see ci_send)
+     */
+    inline ticks ci_push(void *t)
+    {
+        if(batch==1 && ready_mask==NULL)
+            return ci_send(t,queue);
+        ticks stall=0;
+        if(stage(t))
+            drain(false,&stall);
+        return stall;
+    }
+
+    /**
+     * @brief push_n pushes a sequence of messages at once, waiting for the room if needed
+     * @return the number of messages pushed (less than n only if NON_BLOCKING_FF is defined and the queue remains full)
+     */
+    inline int push_n(void **msgs, int len)
+    {
+        int i=0;
+        int waits=0;
+        #ifdef NON_BLOCKING_FF
+        int attempt=0;
+        #endif
+        while(i<len)
+        {
+            //multipush inserts the whole sequence (or nothing) and makes it visible at once
+            if(queue->multipush(msgs+i,len-i))
+            {
+                signal();
+                return len;
+            }
+            if(queue->push(msgs[i]))
+            {
+                signal();
+                i++;
+                continue;
+            }
+            stalled=true;
+            REPEAT_25(asm volatile("PAUSE" ::: "memory");)
+            //backpressure: after a while release the core, if the wait policy allows it
+            if(wait_policy()!=WaitPolicy::SPIN && ++waits>WAIT_SPIN_ROUNDS)
+                sched_yield();
+            #ifdef NON_BLOCKING_FF
+            attempt++;
+            if(attempt>MAX_SEND_RETRIES)
+                return i;
+            #endif
+        }
+        return i;
+    }
+
+    /**
+     * @brief flush pushes the staged messages
+     * @return 1 on success, 0 otherwise (see push)
+     */
+    inline int flush()
+    {
+        return drain(true,NULL);
+    }
+
+    /**
+     * @brief bflush as flush, but it never fails
+     */
+    inline void bflush()
+    {
+        drain(false,NULL);
+    }
+
+    /**
+     * @brief checkFlush flushes the staged messages if the oldest one has exceeded the flush bound
+     * @param now current time in ticks
+     */
+    inline int checkFlush(ticks now)
+    {
+        if(n>0 && now-first_staged>flush_ticks)
+            return flush();
+        return 1;
+    }
+
+    inline int pending() const
+    {
+        return n;
+    }
+
+private:
+
+    /**
+     * Notify the consumer that something has been pushed
+     */
+    inline void signal()
+    {
+        if(ready_mask)
+            ready_mask->set(ready_bit);
+        wait_notify(queue);
+    }
+
+    /**
+     * Stage a message, returns true if the staged ones have to be pushed
+     */
+    inline bool stage(void *t)
+    {
+        ticks now=getticks();
+        if(n==0)
+            first_staged=now;
+        staged[n++]=t;
+        return n==batch || now-first_staged>flush_ticks;
+    }
+
+    int drain(bool bounded, ticks *stall)
+    {
+        if(n==0)
+            return 1;
+        int pushed;
+        ticks start=0;
+        if(stall)
+            start=getticks();
+        stalled=false;
+        if(bounded)
+            pushed=push_n(staged,n);
+        else
+            while((pushed=push_n(staged,n))<n)
+            {
+                memmove(staged,staged+pushed,(n-pushed)*sizeof(void *));
+                n-=pushed;
+            }
+        if(stall)
+            *stall=stalled?getticks()-start:0;
+        if(pushed<n)
+        {
+            //keep the ones not yet pushed
+            memmove(staged,staged+pushed,(n-pushed)*sizeof(void *));
+            n-=pushed;
+            return 0;
+        }
+        n=0;
+        return 1;
+    }
+
+    ff::SWSR_Ptr_Buffer *queue;
+    int batch;
+    ticks flush_ticks;
+    bool stalled;                   //true if the last push had to wait for room in the queue
+    int n;                          //number of staged messages
+    ticks first_staged;             //when the oldest one has been staged
+    ReadyMask *ready_mask;
+    int ready_bit;
+    void *staged[CHANNEL_MAX_BATCH];
+};
+
+/**
+ * Consumer side of a channel
+ */
+class ChannelReader{
+public:
+    ChannelReader(ff::SWSR_Ptr_Buffer *queue=NULL, int batch=1)
+    {
+        init(queue,batch);
+    }
+
+    void init(ff::SWSR_Ptr_Buffer *queue, int batch)
+    {
+        this->queue=queue;
+        this->batch=(batch<1)?1:((batch>CHANNEL_MAX_BATCH)?CHANNEL_MAX_BATCH:batch);
+        head=0;
+        count=0;
+    }
+
+    /**
+     * @brief bind changes the underlying queue (all the messages of the previous one must have been consumed)
+     */
+    inline void bind(ff::SWSR_Ptr_Buffer *queue)
+    {
+        this->queue=queue;
+    }
+
+    /**
+     * @brief pop_n pops up to max messages that are currently in the queue
+     * @return the number of messages popped
+     */
+    inline int pop_n(void **msgs, int max)
+    {
+        int i=0;
+        while(i<max && queue->pop(&msgs[i]))
+            i++;
+        return i;
+    }
+
+    /**
+     * @brief pop returns the next message without waiting
+     * @return false if the channel is empty
+     */
+    inline bool pop(void **t)
+    {
+        if(head<count)
+        {
+            *t=popped[head++];
+            return true;
+        }
+        if(batch==1)
+            return queue->pop(t);
+        count=pop_n(popped,batch);
+        if(count==0)
+        {
+            head=0;
+            return false;
+        }
+        *t=popped[0];
+        head=1;
+        return true;
+    }
+
+    /**
+     * @brief empty returns true if there are no messages to be received
+     */
+    inline bool empty()
+    {
+        return head>=count && queue->empty();
+    }
+
+    /**
+     * @brief receive returns the next message, waiting for it according to the wait policy (see receive())
+     */
+    inline void receive(void **t)
+    {
+        if(!pop(t))
+            wait_for(queue,[&]{return pop(t);});
+    }
+
+    /**
+     * @brief pending returns the number of messages already popped from the queue but not yet consumed
+     */
+    inline int pending() const
+    {
+        return count-head;
+    }
+
+private:
+    ff::SWSR_Ptr_Buffer *queue;
+    int batch;
+    int head;                       //next message to hand out
+    int count;                      //number of popped messages
+    void *popped[CHANNEL_MAX_BATCH];
+};
+
+#endif // CHANNEL_HPP
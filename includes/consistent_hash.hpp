@@ -0,0 +1,84 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Consistent hashing of the classes (keys) onto the replicas
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef CONSISTENT_HASH_HPP
+#define CONSISTENT_HASH_HPP
+#include <stdint.h>
+#include "general.h"
+
+/*
+ * With the consistent hashing routing (routing=consistent_hash) a class is assigned to the replica
+ * given by the jump consistent hash of its id (Lamping and Veach, "A Fast, Minimal Memory, Consistent
+ * Hash Algorithm"), unless the controller has overridden it for balancing the load.
+ * When the replicas go from N to N+1, only the classes that hash to the new one (about 1/(N+1)) move;
+ * when the last replica is removed only its classes move. Scaling up and then down brings the classes
+ * back to their previous replica.
+ *
+ * The routing of each tuple still uses the scheduling table, that is a materialization of the hash
+ * and of the overrides: a lookup costs less than evaluating the hash (ln(N) iterations) for each tuple.
+ */
+
+/**
+ * @brief jump_consistent_hash returns the bucket of a key
+ * @param key the key (class id)
+ * @param num_buckets number of buckets (replicas)
+ * @return a bucket between 0 and num_buckets-1
+ */
+inline int32_t jump_consistent_hash(uint64_t key, int32_t num_buckets)
+{
+    //class ids are consecutive: mix them before the jumps (splitmix64 finalizer)
+    key+=0x9e3779b97f4a7c15ULL;
+    key=(key^(key>>30))*0xbf58476d1ce4e5b9ULL;
+    key=(key^(key>>27))*0x94d049bb133111ebULL;
+    key^=key>>31;
+    int64_t b=-1, j=0;
+    while(j<num_buckets)
+    {
+        b=j;
+        key=key*2862933555777941757ULL+1;
+        j=(int64_t)((b+1)*(double(1LL<<31)/double((key>>33)+1)));
+    }
+    return (int32_t)b;
+}
+
+/**
+ * @brief compute_st_hash fills the scheduling table with the hash of each class, or with its override
+ * @param overrides for each class, the replica+1 to which it is explicitly assigned (0 if it follows the hash,
+ * SPLIT_CLASS if it is split). The overrides toward replicas that do not exist anymore are dropped
+ */
+inline void compute_st_hash(int num_workers, int num_classes, worker_id_t *overrides, worker_id_t *scheduling_table)
+{
+    for(int i=0;i<num_classes;i++)
+    {
+        if(overrides[i]>0 && overrides[i]!=SPLIT_CLASS && overrides[i]-1>=num_workers)
+            overrides[i]=0;
+        scheduling_table[i]=(overrides[i]>0)?overrides[i]:jump_consistent_hash(i,num_workers)+1;
+    }
+}
+
+#endif // CONSISTENT_HASH_HPP
@@ -97,8 +97,13 @@ public:
         //compute the various calculation times metrics
         for(int i=0;i<_num_classes;i++)
         {
+            if(em->scheduling_table[i]==SPLIT_CLASS)
+            {
+                splitClassMetrics(i,num_workers,em,wm);
+                continue;
+            }
             //for each class, take the info from the worker to which was assigned
-            char assw=em->scheduling_table[i]-1;
+            int assw=em->scheduling_table[i]-1;
 
             if(wm[assw]->tcalc_per_class[i]>0) //there is some data (otherwise we will keep the one of the previous mon. step)
             {
@@ -144,10 +149,10 @@ public:
         //compute with the worker data
         for(int i=0;i<num_workers;i++)
         {
-            for(int j=0;j<(wm[i]->calc_times)->size();j++)
+            for(int j=0;j<wm[i]->calc_times.size();j++)
             {
 
-                std_dev+=((wm[i]->calc_times)->at(j)-module_tcalc)*((wm[i]->calc_times)->at(j)-module_tcalc);
+                std_dev+=(wm[i]->calc_times.at(j)-module_tcalc)*(wm[i]->calc_times.at(j)-module_tcalc);
                 samples++;
             }
         }
@@ -168,6 +173,36 @@ public:
     }
 
 private:
+
+    /**
+     * The panes of a split class are computed by all the workers: its tcalc is averaged on all of them
+     * and its load is shared according to the elements that each one received
+     */
+    void splitClassMetrics(int c, int num_workers, msg::EmitterMonitoring *em, msg::WorkerMonitoring **wm)
+    {
+        double tcalc=0;
+        int computations=0;
+        for(int w=0;w<num_workers;w++)
+        {
+            tcalc+=wm[w]->tcalc_per_class[c];
+            computations+=wm[w]->computations_per_class[c];
+        }
+        if(computations==0) //keep the one of the previous mon. step
+            return;
+        double class_freq=((double)em->elements_per_class[c])/em->elements;
+        tcalc_per_class[c]=(tcalc/computations)/1000; //msec
+        weighted_tcalc_per_class[c]=class_freq*tcalc_per_class[c];
+        module_tcalc+=weighted_tcalc_per_class[c];
+        for(int w=0;w<num_workers;w++)
+        {
+            if(wm[w]->elements_rcvd==0)
+                continue;
+            if(em->elements_per_class[c]>0)
+                freq_to_worker[w]+=class_freq*((double)wm[w]->elements_per_class[c]/em->elements_per_class[c]);
+            weighted_tcalc_per_worker[w]+=tcalc_per_class[c]*((double)wm[w]->elements_per_class[c]/wm[w]->elements_rcvd);
+        }
+    }
+
     int _num_classes;
     int _max_workers;
 
@@ -28,12 +28,16 @@
 #include "general.h"
 #include "repository.hpp"
 #include "strategy_descriptor.hpp"
+#include "ready_mask.hpp"
 #include <ff/buffer.hpp>
 #include <ff/allocator.hpp>
+#include "messages.hpp"
 #include <vector>
 #include <assert.h>
 
 
+class ReplicaPool;
+
 /**
 	Data structure passed to the various entities
 */
@@ -41,6 +45,7 @@
 typedef struct emitter_data {
 	int port; //port from which receive the connection from the generator
 	int num_workers; //number of workers
+	int max_workers; //maximum number of workers
 	int num_classes; //number of classes
 
 	ff::SWSR_Ptr_Buffer **outqueue; //queues towards workers
@@ -67,6 +72,8 @@ typedef struct emitter_data {
 
     //Strategy descriptor
     StrategyDescriptor* sd;
+    //monitoring messages toward the controller
+    msg::MonitoringRing<msg::EmitterMonitoring> *mon_ring;
 } emitter_data_t;
 
 //Struttura dati dello stato del collettore:
@@ -83,6 +90,7 @@ typedef struct collector_data {
 	long int freq; //processor frequency
 
 	char *suffix;
+	int window_size;
 	int window_slide;
 	//output queue towards the controller
 	ff::SWSR_Ptr_Buffer *cn_outqueue;
@@ -90,6 +98,10 @@ typedef struct collector_data {
 	int max_workers;
     //Strategy descriptor
     StrategyDescriptor* sd;
+    //replicas that have pushed results (set by workers)
+    ReadyMask *ready_mask;
+    //monitoring messages toward the controller
+    msg::MonitoringRing<msg::CollectorMonitoring> *mon_ring;
 } collector_data_t;
 
 //Struttura dati dello stato del generico worker:
@@ -115,6 +127,14 @@ typedef struct worker_data {
     Repository *repository;
     //Strategy descriptor
     StrategyDescriptor* sd;
+    //where to signal the results pushed toward the collector
+    ReadyMask *ready_mask;
+    //monitoring messages toward the controller (one ring for each worker id)
+    msg::MonitoringRing<msg::WorkerMonitoring> *mon_ring;
+    //preallocated result buffer (if NULL, the worker allocates it)
+    winresult_t *res_buff;
+    //arena of the windows, kept across the activations of the replica (if NULL, the worker creates it)
+    WindowArena *arena;
 
 	
 
@@ -148,6 +168,8 @@ typedef struct controller_data {
 	ff::ff_allocator *ffalloc; //fastflow memory allocator
     //Strategy descriptor
     StrategyDescriptor* sd;
+    //pre-spawned replicas, activated in case of increase of the parallelism degree
+    ReplicaPool *pool;
 	
 }controller_data_t;
 
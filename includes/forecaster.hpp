@@ -0,0 +1,318 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Forecasting of the arrival rate for the predictive strategies
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef FORECASTER_HPP
+#define FORECASTER_HPP
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include "HoltWinters.h"
+#include "strategy_descriptor.hpp"
+
+/**
+ * The controller gives to the forecaster the arrival rate measured at each control step
+ * (update) and then it asks for the rates of the next h steps (forecast).
+ * Until a model has seen enough observations, it forecasts the last one for all the steps.
+ */
+class Forecaster{
+public:
+    virtual ~Forecaster(){}
+
+    /**
+     * @brief update adds the observation of the last control step
+     */
+    virtual void update(double obs)=0;
+
+    /**
+     * @brief forecast predicts the next h values
+     * @param forecasted array of h positions in which the forecasts are stored
+     */
+    virtual void forecast(int h, double *forecasted)=0;
+
+    virtual const char *getName()=0;
+
+protected:
+    static void repeat(double value, int h, double *forecasted)
+    {
+        for(int i=0;i<h;i++)
+            forecasted[i]=value;
+    }
+};
+
+/**
+ * Simple Moving Average over the last length observations. The forecast of a step
+ * uses the ones of the previous steps when the observations are not enough
+ */
+class SMAForecaster: public Forecaster{
+public:
+    SMAForecaster(int length=3)
+    {
+        this->length=(size_t)length;
+    }
+
+    void update(double obs)
+    {
+        obs_v.push_back(obs);
+        //only the last length are needed
+        if(obs_v.size()>2*length)
+            obs_v.erase(obs_v.begin(),obs_v.end()-length);
+    }
+
+    void forecast(int h, double *forecasted)
+    {
+        if(obs_v.size()<length)
+        {
+            repeat(obs_v.empty()?0:obs_v.back(),h,forecasted);
+            return;
+        }
+        for(int i=0;i<h;i++)
+        {
+            forecasted[i]=0;
+            //add the obs value
+            for(int j=0;j<(int)length-i;j++)
+                forecasted[i]+=obs_v[obs_v.size()-length+j+i];
+            //add the already forecasted values
+            for(int j=MAX(0,i-(int)length);j<i;j++)
+                forecasted[i]+=forecasted[j];
+            forecasted[i]/=length;
+        }
+    }
+
+    const char *getName()
+    {
+        return "sma";
+    }
+
+private:
+    size_t length;
+    std::vector<double> obs_v;
+};
+
+/**
+ * Double exponential smoothing (Holt-Winters without seasonality, see HWFilter)
+ */
+class HoltWintersForecaster: public Forecaster{
+public:
+    HoltWintersForecaster(double alpha, double beta)
+    {
+        this->alpha=alpha;
+        this->beta=beta;
+        count=0;
+        first=0;
+    }
+
+    void update(double obs)
+    {
+        count++;
+        if(count==1)
+            first=obs;
+        else
+            if(count==2) //we can initialize the filter
+                filter.initialize(alpha,beta,first,obs-first);
+            else
+                filter.updateSample(obs);
+        last=obs;
+    }
+
+    void forecast(int h, double *forecasted)
+    {
+        if(count<2) //not enough data
+        {
+            repeat(count==0?0:last,h,forecasted);
+            return;
+        }
+        filter.forecast(forecasted,h);
+    }
+
+    const char *getName()
+    {
+        return "holt_winters";
+    }
+
+private:
+    HWFilter filter;
+    double alpha, beta;
+    int count;
+    double first, last;
+};
+
+/**
+ * Exponentially Weighted Moving Average: the same value is forecasted for all the steps
+ */
+class EWMAForecaster: public Forecaster{
+public:
+    EWMAForecaster(double alpha)
+    {
+        this->alpha=alpha;
+        level=0;
+        count=0;
+    }
+
+    void update(double obs)
+    {
+        level=(count==0)?obs:alpha*obs+(1-alpha)*level;
+        count++;
+    }
+
+    void forecast(int h, double *forecasted)
+    {
+        repeat(level,h,forecasted);
+    }
+
+    const char *getName()
+    {
+        return "ewma";
+    }
+
+private:
+    double alpha;
+    double level;
+    int count;
+};
+
+/**
+ * Autoregressive model of order p (with intercept):
+ *      x_t = c + a_1*x_{t-1} + ... + a_p*x_{t-p}
+ * whose coefficients are estimated online with Recursive Least Squares (each update costs O(p^2)).
+ * The forgetting factor (lambda<=1) discounts the old observations, so that the model follows
+ * the changes in the dynamics of the rate. Forecasts beyond the first step use the previous ones
+ * and negative values are clamped to zero.
+ */
+class ARForecaster: public Forecaster{
+public:
+    ARForecaster(int p, double lambda=0.99)
+    {
+        this->p=p;
+        this->lambda=lambda;
+        n=p+1;
+        theta=new double[n]();
+        P=new double[n*n]();
+        //large initial covariance: the first observations count more
+        for(int i=0;i<n;i++)
+            P[i*n+i]=1000;
+        regr=new double[n];
+        Pr=new double[n];
+        history=new double[p]();
+        count=0;
+    }
+
+    ~ARForecaster()
+    {
+        delete[] theta;
+        delete[] P;
+        delete[] regr;
+        delete[] Pr;
+        delete[] history;
+    }
+
+    void update(double obs)
+    {
+        if(count>=p)
+        {
+            //regressor: 1, x_{t-1},...,x_{t-p}
+            regr[0]=1;
+            for(int i=0;i<p;i++)
+                regr[i+1]=history[i];
+            //gain k=P*r/(lambda+r'*P*r)
+            double den=lambda;
+            for(int i=0;i<n;i++)
+            {
+                Pr[i]=0;
+                for(int j=0;j<n;j++)
+                    Pr[i]+=P[i*n+j]*regr[j];
+                den+=regr[i]*Pr[i];
+            }
+            double err=obs;
+            for(int i=0;i<n;i++)
+                err-=theta[i]*regr[i];
+            for(int i=0;i<n;i++)
+                theta[i]+=Pr[i]/den*err;
+            //P=(P-k*r'*P)/lambda (P is symmetric, so r'*P=Pr')
+            for(int i=0;i<n;i++)
+                for(int j=0;j<n;j++)
+                    P[i*n+j]=(P[i*n+j]-Pr[i]*Pr[j]/den)/lambda;
+        }
+        //history[0] is the last observation
+        memmove(history+1,history,(p-1)*sizeof(double));
+        history[0]=obs;
+        count++;
+    }
+
+    void forecast(int h, double *forecasted)
+    {
+        //the model needs some observations for being estimated
+        if(count<=2*p)
+        {
+            repeat(count==0?0:history[0],h,forecasted);
+            return;
+        }
+        for(int k=0;k<h;k++)
+        {
+            double f=theta[0];
+            for(int i=0;i<p;i++)
+                f+=theta[i+1]*((i<k)?forecasted[k-1-i]:history[i-k]);
+            forecasted[k]=(f>0)?f:0;
+        }
+    }
+
+    const char *getName()
+    {
+        return "ar";
+    }
+
+private:
+    int p;
+    int n;                  //number of coefficients (p+1)
+    double lambda;
+    double *theta;          //coefficients: c, a_1,...,a_p
+    double *P;              //inverse correlation matrix (n x n)
+    double *regr;
+    double *Pr;
+    double *history;        //last p observations (the most recent first)
+    long count;
+};
+
+/**
+ * @brief createForecaster returns the forecaster required by the strategy descriptor
+ */
+inline Forecaster *createForecaster(StrategyDescriptor *sd)
+{
+    switch(sd->forecaster)
+    {
+        case ForecasterType::HOLT_WINTERS:
+            return new HoltWintersForecaster(sd->forecaster_alpha,sd->forecaster_beta);
+        case ForecasterType::EWMA:
+            return new EWMAForecaster(sd->forecaster_alpha);
+        case ForecasterType::AR:
+            return new ARForecaster(sd->forecaster_order);
+        default:
+            return new SMAForecaster(sd->forecaster_order);
+    }
+}
+
+#endif // FORECASTER_HPP
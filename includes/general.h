@@ -31,6 +31,7 @@
 //Include:
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
@@ -49,6 +50,7 @@
 #include <assert.h>
 #include <ff/buffer.hpp>
 #include <ff/allocator.hpp>	
+#include "wait_policy.hpp"
 
 
 
@@ -58,6 +60,8 @@
 
 #define CACHE_LINE_SIZE 64                  //cache block size
 #define QUEUE_SIZE 10000                    //replicas' queue length
+#define CHANNEL_MAX_BATCH 64                //maximum number of messages moved at once on a data channel (see channel.hpp)
+#define ROUTING_PREFETCH_DISTANCE 8         //the splitter prefetches the routing entry of the tuple received this number of tuples later
 
 #define MAX_RHO_WORKER 1.1                  //maximum rho sustainable by a replica
 #define MAX_RHO_UNBALANCE_PERCENTAGE 30     //max rho unbalance between workers (percentage)
@@ -86,6 +90,9 @@
 #define MONITORING_STEP 1000                //minimum time interval between two monitoring phases of monitoring (milliseconds)
 #define QUEUE_SIZE_MON 5                    //size of queues used for sent monitoring data
 #define PRINT_RATE 1000                     //defined in msec
+#define REPLICA_RES_BUFF_SIZE (QUEUE_SIZE+2*CHANNEL_MAX_BATCH+10) //results of a replica that can be in use (see replica.cpp)
+#define MERGER_MAX_DRAIN 256                //results received from a replica before visiting the next signalled one
+#define MERGER_TIMER_CHECK 64               //results received by the merger between two checks of its timers
 
 
 //for colored prints
@@ -116,12 +123,23 @@
 
 typedef long unsigned int timestamp_t;
 
+//Identifier of a replica. The scheduling table maps each class (key) to the id+1 of the replica
+//that computes it (0 means that the class has not been assigned yet, SPLIT_CLASS that it is a hot
+//key whose panes are spread on all the replicas)
+typedef uint16_t worker_id_t;
+#define MAX_REPLICAS 65533                  //maximum number of replicas that can be addressed
+#define SPLIT_CLASS ((worker_id_t)0xFFFF)
+
 //Used to specify different type of tuple
 typedef enum punctation_t{
 	NO=0, //in order to be the default value
 	MOVING_IN=1,
     MOVING_OUT=2,
-    TESTING=3
+    TESTING=3,
+    SPLIT_PANE=4,   //tuple of a split class (see pane.hpp)
+    SPLIT_START=5,  //the class is split: the replica has to send the summaries of its window
+    SPLIT_FLUSH=6,  //the replica has to send the summary of the pane that it is computing (it is going to be removed)
+    SPLIT_END=7     //the class is no more split: the replica owns it starting from the quote with the given internal id
 }punctation_t;
 
 
@@ -155,7 +173,7 @@ typedef struct {
             long  timestamp; //used for latency computation: its represent the sending time from the generator side (equal to original_timestamp for the real dataset)
 
             int64_t internal_id; //id assigned to the task while being computed in the program (e.g. incremental for each class). Not necessary for all implementations
-            char worker; //tmp for debug
+            worker_id_t worker; //tmp for debug
             punctation_t punctuation;
         };
         char padding[CACHE_LINE_SIZE];
@@ -183,9 +201,10 @@ typedef struct{
     int64_t id; //id of the task that has triggered the computation
     bool isEOS; //true if it will represent to the collector the end of the stream
     int type; //class
-    char wid; //id of the worker that performed the computation
+    worker_id_t wid; //id of the worker that performed the computation
     ticks ts;
     void *res_buff=NULL; //this will be valid only if it is the EOS sent from a Worker to the Collector (for freeing the result_buffer)
+    void *pane=NULL; //if not NULL, this is a partial result of a split class: the summary of a pane (see pane.hpp)
 } winresult_t;
 
 
@@ -194,7 +213,9 @@ typedef struct{
 ****************************************/
 
 /**
-	Fastflow queue operations wrappers
+	Fastflow queue operations wrappers. The waiting on empty queues (receive) and full
+	queues (bsend) follows the current wait policy (see wait_policy.hpp), while send
+	and ci_send always spin
 */
 inline int send ( void *t, ff::SWSR_Ptr_Buffer *outqueue) __attribute__((always_inline))/* __attribute__((noinline))*/; 
 inline int bsend ( void *t, ff::SWSR_Ptr_Buffer *outqueue) __attribute__((always_inline))/* __attribute__((noinline))*/; 
@@ -219,6 +240,7 @@ inline int send ( void *t, ff::SWSR_Ptr_Buffer *outqueue)
 		#endif
 
 	}
+	wait_notify(outqueue);
 	return 1;
 	
 }
@@ -236,6 +258,7 @@ inline ticks ci_send ( void *t, ff::SWSR_Ptr_Buffer *outqueue)
                REPEAT_25(asm volatile("PAUSE" ::: "memory");)
                attempts++;
        }
+       wait_notify(outqueue);
        if(attempts>0)
                return getticks()-start;
        else
@@ -245,11 +268,9 @@ inline ticks ci_send ( void *t, ff::SWSR_Ptr_Buffer *outqueue)
 
 inline int bsend ( void *t, ff::SWSR_Ptr_Buffer *outqueue)
 {
-	int attempt=0;
-	while(!outqueue->push((void*)t))
-	{
-		REPEAT_25(asm volatile("PAUSE" ::: "memory");)
-	}
+	if(!outqueue->push((void*)t))
+		wait_room([&]{return outqueue->push((void*)t);});
+	wait_notify(outqueue);
 	return 1;
 	
 }
@@ -257,10 +278,8 @@ inline int bsend ( void *t, ff::SWSR_Ptr_Buffer *outqueue)
 
 inline void receive ( void **t, ff::SWSR_Ptr_Buffer *inqueue)
 {
-	while (!inqueue->pop( t)) {
-		// Small sleep
-		REPEAT_25(asm volatile("PAUSE" ::: "memory");)
-	}
+	if(!inqueue->pop(t))
+		wait_for(inqueue,[&]{return inqueue->pop(t);});
 }
 
 /**
@@ -271,10 +290,7 @@ inline void receiveLast ( void **t, ff::SWSR_Ptr_Buffer *inqueue)
 {
 	do
 	{
-		while (!inqueue->pop( t)) {
-			// Small sleep
-			REPEAT_25(asm volatile("PAUSE" ::: "memory");)
-		}
+		receive(t,inqueue);
 	}while(!inqueue->empty());
 }
 
@@ -297,6 +313,24 @@ inline long current_time_nsecs(){
     return (t.tv_sec)*1000000000L + t.tv_nsec;
 }
 
+/**
+	Scheduling table
+*/
+//the table is read by the splitter for each tuple: it is allocated on cache line boundaries, so that the entries
+//of consecutive classes share the minimum number of lines
+inline worker_id_t *alloc_scheduling_table(int num_classes)
+{
+    worker_id_t *table;
+    size_t size=((num_classes*sizeof(worker_id_t)+CACHE_LINE_SIZE-1)/CACHE_LINE_SIZE)*CACHE_LINE_SIZE;
+    if(posix_memalign((void **)&table,CACHE_LINE_SIZE,size)!=0)
+    {
+        fprintf(stderr,"Error in allocating the scheduling table\n");
+        exit(-1);
+    }
+    memset(table,0,size);
+    return table;
+}
+
 /**
 	Fitting function
 */
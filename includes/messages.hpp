@@ -22,6 +22,15 @@
     */
 #ifndef MESSAGES_HPP
 #define MESSAGES_HPP
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <stdexcept>
+#include <ff/buffer.hpp>
+#include "general.h"
+
+#define CALC_TIMES_SAMPLE 512               //maximum number of computation times reported by a worker at each monitoring step
+
 namespace msg{
 enum class MonitoringTag{
     MONITORING_TAG,             //used to indicate that the message is used for monitored data
@@ -35,10 +44,123 @@ enum class ReconfTag{
     REBALANCE                   //used to indicate that the message is used to rebalance load through a new sched table
 };
 
+/*
+ * Monitoring messages are not allocated at each monitoring step: each entity owns a
+ * MonitoringRing of NMONITORING preallocated messages. A message taken from the ring is
+ * in use until the controller releases it (instead of deleting it), then it can be reused.
+ * The controller holds at most a couple of messages per entity and at most QUEUE_SIZE_MON are
+ * in the queue: NMONITORING messages are enough for an entity never to wait.
+ */
+
+/**
+ * @brief The MonitoringMessage class contains the ownership flag of a monitoring message
+ */
+class MonitoringMessage{
+public:
+    MonitoringMessage()
+    {
+        _in_use.store(false);
+    }
+
+    /**
+     * @brief release gives back the message to its owner. To be called by the controller
+     * once it has finished with the message
+     */
+    inline void release()
+    {
+        _in_use.store(false,std::memory_order_release);
+    }
+
+    inline bool inUse() const
+    {
+        return _in_use.load(std::memory_order_acquire);
+    }
+
+    inline void acquire()
+    {
+        _in_use.store(true,std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> _in_use;
+};
+
+/**
+ * @brief The MonitoringRing class contains the preallocated monitoring messages of an entity
+ */
+template <typename T>
+class MonitoringRing{
+public:
+    /**
+     * @param num_classes number of classes of each message
+     * @param size number of messages
+     */
+    MonitoringRing(int num_classes, int size=NMONITORING)
+    {
+        _size=size;
+        _next=0;
+        _msgs=new T*[size];
+        for(int i=0;i<size;i++)
+            _msgs[i]=new T(num_classes);
+    }
+
+    ~MonitoringRing()
+    {
+        for(int i=0;i<_size;i++)
+            delete _msgs[i];
+        delete[] _msgs;
+    }
+
+    MonitoringRing(const MonitoringRing &)=delete;
+
+    /**
+     * @brief next returns a free message, already reset
+     */
+    T *next()
+    {
+        T *m=nullptr;
+        while(m==nullptr)
+        {
+            for(int i=0;i<_size && m==nullptr;i++)
+            {
+                T *cand=_msgs[_next];
+                _next=(_next+1)%_size;
+                if(!cand->inUse())
+                    m=cand;
+            }
+            if(m==nullptr) //the controller is holding all of them
+                REPEAT_25(asm volatile("PAUSE" ::: "memory");)
+        }
+        m->reset();
+        m->acquire();
+        return m;
+    }
+
+private:
+    T **_msgs;
+    int _size;
+    int _next;
+};
+
+/**
+ * @brief receiveLast receives the last monitoring message in the queue (as receiveLast), releasing the older ones
+ */
+template <typename T>
+inline void receiveLast(T **m, ff::SWSR_Ptr_Buffer *inqueue)
+{
+    receive((void **)m,inqueue);
+    while(!inqueue->empty())
+    {
+        T *prev=*m;
+        receive((void **)m,inqueue);
+        prev->release();
+    }
+}
+
 /**
  * @brief The EmitterMonitoring class for monitored data sent from the Emitter towards the Controller
  */
-class EmitterMonitoring{
+class EmitterMonitoring: public MonitoringMessage{
 
 public:
     MonitoringTag tag;          //type of message
@@ -46,7 +168,7 @@ public:
     int buffer_elements;        //number of elements that are in the tcp buffer while sending monitoring data
     int* elements_per_class;    //numb of elements per class
     bool stop;                  //used for stopping monitoring
-    char *scheduling_table;     //actual scheduling table (pointer)
+    worker_id_t *scheduling_table;  //actual scheduling table (pointer)
     double ta_timestamp;        //interarrival time in msec for the last monitoring step
     double std_dev_timestamp;   //standard deviation of interarrival time in msec for the last monitoring step
     bool congestion;            //used by TPDS strategy for signaling a congestion
@@ -86,8 +208,11 @@ public:
      */
     void reset()
     {
+        tag=MonitoringTag::MONITORING_TAG;
         elements=0;
         buffer_elements=0;
+        stop=false;
+        congestion=false;
         memset(elements_per_class,0,_num_classes*sizeof(int));
     }
 
@@ -100,10 +225,63 @@ private:
 
 
 
+/**
+ * @brief The CalcTimesSample class keeps a uniform sample (reservoir) of at most
+ * CALC_TIMES_SAMPLE computation times: its cost does not depend on the number of computations
+ */
+class CalcTimesSample{
+public:
+    CalcTimesSample()
+    {
+        _n=0;
+        _seen=0;
+        _rnd=0x9E3779B97F4A7C15ULL;
+    }
+
+    inline void push_back(double t)
+    {
+        _seen++;
+        if(_n<CALC_TIMES_SAMPLE)
+            _times[_n++]=t;
+        else
+        {
+            //replace a sampled value with probability CALC_TIMES_SAMPLE/seen (xorshift64)
+            _rnd^=_rnd<<13;
+            _rnd^=_rnd>>7;
+            _rnd^=_rnd<<17;
+            uint64_t j=_rnd%_seen;
+            if(j<CALC_TIMES_SAMPLE)
+                _times[j]=t;
+        }
+    }
+
+    inline int size() const
+    {
+        return _n;
+    }
+
+    inline double at(int i) const
+    {
+        return _times[i];
+    }
+
+    inline void clear()
+    {
+        _n=0;
+        _seen=0;
+    }
+
+private:
+    double _times[CALC_TIMES_SAMPLE];
+    int _n;                             //sampled values
+    int64_t _seen;                      //values pushed since the last clear
+    uint64_t _rnd;
+};
+
 /**
  * @brief The WorkerMonitoring class for monitored data sent from Worker to Controller
  */
-class WorkerMonitoring{
+class WorkerMonitoring: public MonitoringMessage{
 
 public:
     MonitoringTag tag;                 //the type of data
@@ -111,7 +289,7 @@ public:
     int *computations_per_class;        //numb of computation per class (it is redundant but we have to keep it for the worker and will be helpful in computing the right metrics when the module is bottleneck)
     double *tcalc_per_class;            //tcalc expressed in usec (total tcalc per class, not on average)
     double *max_tcalc_per_class;        //TMP per vedere come va NC (usecs)
-    std::vector<double> * calc_times;   //reports all the computation times (for every class assigned to the worker)
+    CalcTimesSample calc_times;         //reports (a sample of) the computation times (for every class assigned to the worker)
     int elements_rcvd;                  //total number of element received
     int computations;                   //number of computation performed
 
@@ -128,8 +306,6 @@ public:
         computations_per_class=new int[num_classes]();
         tcalc_per_class=new double[num_classes]();
         max_tcalc_per_class=new double[num_classes]();
-        calc_times=new std::vector<double>;
-        calc_times->reserve(500);
         _num_classes=num_classes;
 
     }
@@ -147,7 +323,6 @@ public:
         delete[] computations_per_class;
         delete[] tcalc_per_class;
         delete[] max_tcalc_per_class;
-        delete(calc_times);
     }
 
     /**
@@ -155,13 +330,14 @@ public:
      */
     void reset()
     {
+        tag=MonitoringTag::MONITORING_TAG;
         elements_rcvd=0;
         computations=0;
         memset(elements_per_class,0,_num_classes*sizeof(int));
         memset(computations_per_class,0,_num_classes*sizeof(int));
         memset(tcalc_per_class,0,_num_classes*sizeof(double));
         memset(max_tcalc_per_class,0,_num_classes*sizeof(double));
-        calc_times->clear();
+        calc_times.clear();
 
 
     }
@@ -175,7 +351,7 @@ private:
 /**
  * @brief The CollectorMonitoring class for send Collector monitoring data to Controller
  */
-class CollectorMonitoring{
+class CollectorMonitoring: public MonitoringMessage{
 
 public:
 
@@ -221,6 +397,7 @@ public:
      */
     void reset()
     {
+        tag=MonitoringTag::MONITORING_TAG;
         results=0;
         avg_lat=0;
         lat_95=0;
@@ -244,7 +421,7 @@ class ReconfEmitter{
 public:
     ReconfTag tag;                  //identifies the type of message
     int par_degree_changes;         //identifies how many worker have been added (if >0) or removed (if <0). It is equal to zero if there are no changes
-    char *scheduling_table;         //the new scheuling table
+    worker_id_t *scheduling_table;  //the new scheuling table
     ff::SWSR_Ptr_Buffer **wqueues;  //queues to the newly spawned workers (if any)
 
     /**
@@ -254,13 +431,13 @@ public:
      * @param num_classes number of
      * @param scheduling_table
      */
-    ReconfEmitter(int par_changes, int num_classes,char *scheduling_table)
+    ReconfEmitter(int par_changes, int num_classes,worker_id_t *scheduling_table)
     {
         par_degree_changes=par_changes;
         _num_classes=num_classes;
-        this->scheduling_table=new char[num_classes]();
+        this->scheduling_table=alloc_scheduling_table(num_classes);
         //copy the passed scheduling table
-        memcpy(this->scheduling_table,scheduling_table,num_classes*sizeof(char));
+        memcpy(this->scheduling_table,scheduling_table,num_classes*sizeof(worker_id_t));
         if(par_changes>0) //we are going to increase the parallelism degree. We need other info
         {
             tag=ReconfTag::INCREASE_PAR_DEGREE;
@@ -281,7 +458,7 @@ public:
     ~ReconfEmitter()
     {
 
-        delete[] scheduling_table;
+        free(scheduling_table);
         //NOTE: i want to delete only the arrays of pointers not the queues themselves: the delete[] does not know how to delete them
         if(wqueues!=nullptr)
             delete[] wqueues;
@@ -0,0 +1,251 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Candlestick (open, high, low, close) computation over a sequence of quotes.
+
+    The prices of the bid and ask sides are stored in two arrays, where
+    a NaN denotes a non valid quote (see CBWindow). Both the sides are
+    computed with a single pass. Vectorized versions (AVX2 and AVX-512) are provided:
+    the one to use is selected at runtime according to the CPU capabilities,
+    with a scalar version as fallback.
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef OHLC_HPP
+#define OHLC_HPP
+#include <cmath>
+#if defined(__x86_64__) && defined(__GNUC__) && (__GNUC__>=5)
+#define OHLC_X86_DISPATCH
+#include <immintrin.h>
+#if (__GNUC__>=7)
+#define OHLC_AVX512
+#endif
+#endif
+
+/**
+ * Candlestick of one side. If there are no valid quotes open and close are zero,
+ * while high and low keep their initial values (0 and 10000)
+ */
+typedef struct{
+    float open, high, low, close;
+}candlestick_t;
+
+/**
+ * Signature of the kernels: n quotes of the two sides
+ */
+typedef void (*ohlc_kernel_t)(const float *bid, const float *ask, int n, candlestick_t *cbid, candlestick_t *cask);
+
+
+static inline void ohlc_init(candlestick_t *c)
+{
+    c->open=0;
+    c->close=0;
+    c->high=0;
+    c->low=10000;
+}
+
+
+/**
+ * Scalar version: it is also used for the remaining elements of the vectorized ones.
+ * The candlesticks passed as parameters are updated
+ */
+static inline void ohlc_scalar_update(const float *bid, const float *ask, int n, candlestick_t *cbid, candlestick_t *cask, bool bid_opened, bool ask_opened)
+{
+    for(int i=0;i<n;i++)
+    {
+        float b=bid[i], a=ask[i];
+        if(!std::isnan(b))
+        {
+            if(!bid_opened)
+            {
+                cbid->open=b;
+                bid_opened=true;
+            }
+            cbid->high=b>cbid->high?b:cbid->high;
+            cbid->low=b<cbid->low?b:cbid->low;
+            cbid->close=b;
+        }
+        if(!std::isnan(a))
+        {
+            if(!ask_opened)
+            {
+                cask->open=a;
+                ask_opened=true;
+            }
+            cask->high=a>cask->high?a:cask->high;
+            cask->low=a<cask->low?a:cask->low;
+            cask->close=a;
+        }
+    }
+}
+
+static void ohlc_scalar(const float *bid, const float *ask, int n, candlestick_t *cbid, candlestick_t *cask)
+{
+    ohlc_init(cbid);
+    ohlc_init(cask);
+    ohlc_scalar_update(bid,ask,n,cbid,cask,false,false);
+}
+
+#if defined(OHLC_X86_DISPATCH)
+
+__attribute__((target("avx2")))
+static inline float ohlc_hmax256(__m256 v)
+{
+    __m128 m=_mm_max_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1));
+    m=_mm_max_ps(m,_mm_movehl_ps(m,m));
+    m=_mm_max_ss(m,_mm_shuffle_ps(m,m,1));
+    return _mm_cvtss_f32(m);
+}
+
+__attribute__((target("avx2")))
+static inline float ohlc_hmin256(__m256 v)
+{
+    __m128 m=_mm_min_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1));
+    m=_mm_min_ps(m,_mm_movehl_ps(m,m));
+    m=_mm_min_ss(m,_mm_shuffle_ps(m,m,1));
+    return _mm_cvtss_f32(m);
+}
+
+/**
+ * AVX2 version: 8 quotes per side at each iteration. max/min return the second operand
+ * if the first one is NaN, therefore non valid quotes do not need any masking.
+ * First and last valid positions are derived from the movemask of the ordered comparison
+ */
+__attribute__((target("avx2")))
+static void ohlc_avx2(const float *bid, const float *ask, int n, candlestick_t *cbid, candlestick_t *cask)
+{
+    __m256 hb=_mm256_setzero_ps(), ha=_mm256_setzero_ps();
+    __m256 lb=_mm256_set1_ps(10000), la=_mm256_set1_ps(10000);
+    int first_b=-1, first_a=-1, last_b=-1, last_a=-1;
+    int i=0;
+    for(;i+8<=n;i+=8)
+    {
+        __m256 b=_mm256_loadu_ps(bid+i);
+        __m256 a=_mm256_loadu_ps(ask+i);
+        hb=_mm256_max_ps(b,hb);
+        lb=_mm256_min_ps(b,lb);
+        ha=_mm256_max_ps(a,ha);
+        la=_mm256_min_ps(a,la);
+        int mb=_mm256_movemask_ps(_mm256_cmp_ps(b,b,_CMP_ORD_Q));
+        int ma=_mm256_movemask_ps(_mm256_cmp_ps(a,a,_CMP_ORD_Q));
+        if(mb)
+        {
+            if(first_b<0)
+                first_b=i+__builtin_ctz(mb);
+            last_b=i+31-__builtin_clz(mb);
+        }
+        if(ma)
+        {
+            if(first_a<0)
+                first_a=i+__builtin_ctz(ma);
+            last_a=i+31-__builtin_clz(ma);
+        }
+    }
+    cbid->high=ohlc_hmax256(hb);
+    cbid->low=ohlc_hmin256(lb);
+    cbid->open=first_b>=0?bid[first_b]:0;
+    cbid->close=last_b>=0?bid[last_b]:0;
+    cask->high=ohlc_hmax256(ha);
+    cask->low=ohlc_hmin256(la);
+    cask->open=first_a>=0?ask[first_a]:0;
+    cask->close=last_a>=0?ask[last_a]:0;
+    ohlc_scalar_update(bid+i,ask+i,n-i,cbid,cask,first_b>=0,first_a>=0);
+}
+
+#if defined(OHLC_AVX512)
+/**
+ * AVX-512 version: 16 quotes per side at each iteration, the last (partial) block is
+ * loaded with a mask that fills the missing lanes with NaN
+ */
+__attribute__((target("avx512f")))
+static void ohlc_avx512(const float *bid, const float *ask, int n, candlestick_t *cbid, candlestick_t *cask)
+{
+    __m512 hb=_mm512_setzero_ps(), ha=_mm512_setzero_ps();
+    __m512 lb=_mm512_set1_ps(10000), la=_mm512_set1_ps(10000);
+    const __m512 nan=_mm512_set1_ps(NAN);
+    int first_b=-1, first_a=-1, last_b=-1, last_a=-1;
+    for(int i=0;i<n;i+=16)
+    {
+        __mmask16 lanes=(n-i>=16)?(__mmask16)0xFFFF:(__mmask16)((1u<<(n-i))-1);
+        __m512 b=_mm512_mask_loadu_ps(nan,lanes,bid+i);
+        __m512 a=_mm512_mask_loadu_ps(nan,lanes,ask+i);
+        hb=_mm512_max_ps(b,hb);
+        lb=_mm512_min_ps(b,lb);
+        ha=_mm512_max_ps(a,ha);
+        la=_mm512_min_ps(a,la);
+        unsigned mb=_mm512_cmp_ps_mask(b,b,_CMP_ORD_Q);
+        unsigned ma=_mm512_cmp_ps_mask(a,a,_CMP_ORD_Q);
+        if(mb)
+        {
+            if(first_b<0)
+                first_b=i+__builtin_ctz(mb);
+            last_b=i+31-__builtin_clz(mb);
+        }
+        if(ma)
+        {
+            if(first_a<0)
+                first_a=i+__builtin_ctz(ma);
+            last_a=i+31-__builtin_clz(ma);
+        }
+    }
+    cbid->high=_mm512_reduce_max_ps(hb);
+    cbid->low=_mm512_reduce_min_ps(lb);
+    cbid->open=first_b>=0?bid[first_b]:0;
+    cbid->close=last_b>=0?bid[last_b]:0;
+    cask->high=_mm512_reduce_max_ps(ha);
+    cask->low=_mm512_reduce_min_ps(la);
+    cask->open=first_a>=0?ask[first_a]:0;
+    cask->close=last_a>=0?ask[last_a]:0;
+}
+#endif
+#endif
+
+/**
+ * @brief ohlc_select_kernel returns the best kernel supported by the CPU
+ */
+static inline ohlc_kernel_t ohlc_select_kernel()
+{
+#if defined(OHLC_X86_DISPATCH)
+    __builtin_cpu_init();
+#if defined(OHLC_AVX512)
+    if(__builtin_cpu_supports("avx512f"))
+        return ohlc_avx512;
+#endif
+    if(__builtin_cpu_supports("avx2"))
+        return ohlc_avx2;
+#endif
+    return ohlc_scalar;
+}
+
+/**
+ * @brief ohlc computes the candlesticks of the two sides with the kernel selected
+ * (once) for the running CPU
+ */
+static inline void ohlc(const float *bid, const float *ask, int n, candlestick_t *cbid, candlestick_t *cask)
+{
+    static const ohlc_kernel_t kernel=ohlc_select_kernel();
+    kernel(bid,ask,n,cbid,cask);
+}
+
+#endif // OHLC_HPP
@@ -0,0 +1,564 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Pane summaries: partial aggregates of window_slide consecutive quotes of a class,
+    from which the window results can be computed without the quotes
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef PANE_HPP
+#define PANE_HPP
+#include <math.h>
+#include <cmath>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "general.h"
+#include "ohlc.hpp"
+#include "parabola_fit.hpp"
+
+#define SPLIT_MAX_FRAGMENTS 4           //maximum number of non contiguous fragments of a pane (the splitter produces at most three)
+
+/*
+ * Since window_size is a multiple of window_slide, the stream of a class can be divided in panes of
+ * window_slide quotes (the pane p contains the quotes with internal id between p*window_slide and
+ * (p+1)*window_slide-1). Each window is made of window_size/window_slide consecutive panes and its result
+ * is triggered by the last quote of its last pane.
+ *
+ * The summary of a pane (or of a fragment of it) keeps, for each side:
+ * - the power sums of its fitting points. Contiguous valid quotes with the same timestamp are a single point
+ *   (see CBWindow) and such a group can span more panes: therefore the first and the last group of the
+ *   pane are kept apart, and they are joined to the ones of the adjacent panes when summaries are combined;
+ * - the candlestick of its quotes.
+ * Combining the summaries of the panes of a window gives the same result of CBWindow (apart from rounding).
+ */
+
+//group of valid quotes with the same timestamp (a fitting point)
+typedef struct{
+    long ts;
+    int n;          //quotes in the group
+    double sum;     //sum of their prices
+}quote_group_t;
+
+typedef struct{
+    FitMoments inner;           //points of the groups between the first and the last one
+    quote_group_t first, last;  //first is valid only if there is more than one group
+    int ngroups;
+    bool first_open;            //the first quote is valid: the first group may continue the last one of the previous pane
+    bool last_open;             //the last quote is valid: the last group may continue in the next pane
+    candlestick_t cs;           //valid only if ngroups>0
+}pane_side_t;
+
+typedef struct pane_summary_t{
+    int64_t first_iid;          //internal id of the first quote
+    int n;                      //number of quotes
+    long origin;                //timestamp of the first quote
+    pane_side_t bid, ask;
+}pane_summary_t;
+
+/**
+ * @brief pane_init prepares an empty summary
+ * @param first_iid internal id of the quote that will be added first
+ */
+inline void pane_init(pane_summary_t *p, int64_t first_iid)
+{
+    p->first_iid=first_iid;
+    p->n=0;
+    p->origin=0;
+    pane_side_t *sides[2]={&p->bid,&p->ask};
+    for(int i=0;i<2;i++)
+    {
+        sides[i]->ngroups=0;
+        sides[i]->first_open=false;
+        sides[i]->last_open=false;
+        ohlc_init(&sides[i]->cs);
+    }
+}
+
+inline void pane_side_add(pane_side_t *s, long ts, float price, bool first_quote)
+{
+    if(std::isnan(price))
+    {
+        s->last_open=false;
+        return;
+    }
+    if(first_quote)
+        s->first_open=true;
+    if(s->ngroups==0)
+        s->cs.open=price;
+    s->cs.high=price>s->cs.high?price:s->cs.high;
+    s->cs.low=price<s->cs.low?price:s->cs.low;
+    s->cs.close=price;
+    if(s->ngroups>0 && s->last_open && s->last.ts==ts)
+    {
+        s->last.n++;
+        s->last.sum+=price;
+        return;
+    }
+    //a new group: the previous last one is complete
+    if(s->ngroups>=2)
+        s->inner.add(s->last.ts,s->last.sum/s->last.n);
+    else if(s->ngroups==1)
+        s->first=s->last;
+    s->last.ts=ts;
+    s->last.n=1;
+    s->last.sum=price;
+    s->last_open=true;
+    s->ngroups++;
+}
+
+/**
+ * @brief pane_add adds a quote to the summary. Prices are NaN for the sides that are not valid
+ */
+inline void pane_add(pane_summary_t *p, long ts, float bid, float ask)
+{
+    bool first=(p->n==0);
+    if(first)
+    {
+        p->origin=ts;
+        p->bid.inner.clear(ts);
+        p->ask.inner.clear(ts);
+    }
+    pane_side_add(&p->bid,ts,bid,first);
+    pane_side_add(&p->ask,ts,ask,first);
+    p->n++;
+}
+
+inline void pane_side_combine(pane_side_t *o, const pane_side_t &a, const pane_side_t &b, long origin)
+{
+    //groups at the boundaries of the two summaries, in order: the one across them may have to be joined
+    quote_group_t g[4];
+    int n=0;
+    if(a.ngroups>1)
+        g[n++]=a.first;
+    if(a.ngroups>0)
+        g[n++]=a.last;
+    bool join=false;
+    if(b.ngroups>0)
+    {
+        const quote_group_t &bf=(b.ngroups==1)?b.last:b.first;
+        join=(a.ngroups>0 && a.last_open && b.first_open && a.last.ts==bf.ts);
+        if(join)
+        {
+            g[n-1].n+=bf.n;
+            g[n-1].sum+=bf.sum;
+        }
+        else
+            g[n++]=bf;
+        if(b.ngroups>1)
+            g[n++]=b.last;
+    }
+    o->inner.clear(origin);
+    o->inner.merge(a.inner);
+    o->inner.merge(b.inner);
+    for(int i=1;i<n-1;i++)
+        o->inner.add(g[i].ts,g[i].sum/g[i].n);
+    o->ngroups=a.ngroups+b.ngroups-(join?1:0);
+    if(n>0)
+    {
+        o->first=g[0];
+        o->last=g[n-1];
+    }
+    o->first_open=a.first_open;
+    o->last_open=b.last_open;
+    if(a.ngroups==0)
+        o->cs=b.cs;
+    else if(b.ngroups==0)
+        o->cs=a.cs;
+    else
+    {
+        o->cs.open=a.cs.open;
+        o->cs.close=b.cs.close;
+        o->cs.high=a.cs.high>b.cs.high?a.cs.high:b.cs.high;
+        o->cs.low=a.cs.low<b.cs.low?a.cs.low:b.cs.low;
+    }
+}
+
+/**
+ * @brief pane_combine returns the summary of the quotes of a followed by the ones of b. The operation is associative
+ * and the empty summary is its identity: the summary of a window can be obtained by combining the ones of its panes in any grouping
+ */
+inline pane_summary_t pane_combine(const pane_summary_t &a, const pane_summary_t &b)
+{
+    if(a.n==0)
+        return b;
+    if(b.n==0)
+        return a;
+    pane_summary_t o;
+    o.first_iid=a.first_iid;
+    o.n=a.n+b.n;
+    o.origin=a.origin;
+    pane_side_combine(&o.bid,a.bid,b.bid,o.origin);
+    pane_side_combine(&o.ask,a.ask,b.ask,o.origin);
+    return o;
+}
+
+/**
+ * Fitting points of consecutive summaries, appended one at a time
+ */
+typedef struct{
+    FitMoments points;
+    int npoints;
+    quote_group_t head;         //oldest point
+    quote_group_t tail;         //newest point (not yet in points, it may still grow)
+    bool tail_open;
+}pane_fit_t;
+
+inline void pane_fit_begin(pane_fit_t *f, long origin)
+{
+    f->points.clear(origin);
+    f->npoints=0;
+    f->tail.n=0;
+    f->tail_open=false;
+}
+
+inline void pane_fit_flush(pane_fit_t *f)
+{
+    if(f->tail.n==0)
+        return;
+    f->points.add(f->tail.ts,f->tail.sum/f->tail.n);
+    if(f->npoints==0)
+        f->head=f->tail;
+    f->npoints++;
+    f->tail.n=0;
+}
+
+inline void pane_fit_append(pane_fit_t *f, const pane_side_t &s)
+{
+    if(s.ngroups>0)
+    {
+        const quote_group_t &g=(s.ngroups==1)?s.last:s.first;
+        if(f->tail.n>0 && f->tail_open && s.first_open && f->tail.ts==g.ts)
+        {
+            f->tail.n+=g.n;
+            f->tail.sum+=g.sum;
+        }
+        else
+        {
+            pane_fit_flush(f);
+            f->tail=g;
+        }
+        if(s.ngroups>1)
+        {
+            pane_fit_flush(f);
+            if(s.ngroups>2)
+            {
+                f->points.merge(s.inner);
+                f->npoints+=s.ngroups-2;
+            }
+            f->tail=s.last;
+        }
+    }
+    f->tail_open=s.last_open;
+}
+
+/**
+ * As CBWindow, with less than three points the previous parameters are kept
+ */
+inline void pane_fit_solve(pane_fit_t *f, double *par)
+{
+    pane_fit_flush(f);
+    //just a guess
+    if(par[0]==0 && f->npoints>0)
+        par[0]=f->head.sum/f->head.n;
+    f->points.solve(f->points.origin,par);
+}
+
+inline void pane_ohlc_append(candlestick_t *c, bool &opened, const pane_side_t &s)
+{
+    if(s.ngroups==0)
+        return;
+    if(!opened)
+    {
+        c->open=s.cs.open;
+        opened=true;
+    }
+    c->high=s.cs.high>c->high?s.cs.high:c->high;
+    c->low=s.cs.low<c->low?s.cs.low:c->low;
+    c->close=s.cs.close;
+}
+
+/**
+ * @brief pane_compute computes the result of a window from the summaries of its quotes
+ * @param panes the summaries, ordered by internal id and without holes
+ * @param n number of summaries
+ * @param last_pane index of the first summary of the last pane: the candlesticks refer to the summaries from
+ * this one on (the last window_slide quotes)
+ * @param par_bid parameters of the previous bid fitting, updated
+ * @param par_ask parameters of the previous ask fitting, updated
+ * @param res where the parameters and the candlesticks are stored
+ */
+inline void pane_compute(const pane_summary_t *const *panes, int n, int last_pane, double *par_bid, double *par_ask, winresult_t &res)
+{
+    pane_fit_t fbid, fask;
+    pane_fit_begin(&fbid,panes[0]->origin);
+    pane_fit_begin(&fask,panes[0]->origin);
+    candlestick_t cbid, cask;
+    bool bid_opened=false, ask_opened=false;
+    ohlc_init(&cbid);
+    ohlc_init(&cask);
+    for(int i=0;i<n;i++)
+    {
+        pane_fit_append(&fbid,panes[i]->bid);
+        pane_fit_append(&fask,panes[i]->ask);
+        if(i>=last_pane)
+        {
+            pane_ohlc_append(&cbid,bid_opened,panes[i]->bid);
+            pane_ohlc_append(&cask,ask_opened,panes[i]->ask);
+        }
+    }
+    pane_fit_solve(&fbid,par_bid);
+    res.p0_bid=par_bid[0];
+    res.p1_bid=par_bid[1];
+    res.p2_bid=par_bid[2];
+    pane_fit_solve(&fask,par_ask);
+    res.p0_ask=par_ask[0];
+    res.p1_ask=par_ask[1];
+    res.p2_ask=par_ask[2];
+    res.open_bid=cbid.open;
+    res.close_bid=cbid.close;
+    res.high_bid=cbid.high;
+    res.low_bid=cbid.low;
+    res.open_ask=cask.open;
+    res.close_ask=cask.close;
+    res.high_ask=cask.high;
+    res.low_ask=cask.low;
+}
+
+/**
+ * @brief result_buffer_size returns the bytes of the result buffer of a replica. If the hot keys
+ * can be split, it is followed by the summaries referred by the results (see replica.cpp)
+ */
+inline size_t result_buffer_size(bool hot_key_split)
+{
+    return REPLICA_RES_BUFF_SIZE*(sizeof(winresult_t)+(hot_key_split?sizeof(pane_summary_t):0));
+}
+
+/**
+ * Merger side of a hot key split among the replicas (see hot_key_split in StrategyDescriptor).
+ * The replicas send the summaries of the panes (a pane can be in more fragments, if its replica has
+ * been removed while it was computing it). The previous owner of the key sends the summaries of the panes
+ * that are still in its window: their results have already been produced, but they are needed for the next windows.
+ * A result is produced as soon as all the panes of its window have been received.
+ * When the key is unsplit, its new owner sends the summaries of the panes until its window is full: the results are
+ * produced here until then, and by the owner afterwards. If the key is split again, the panes still needed may
+ * be sent twice: a pane that has already been received is ignored.
+ *
+ * As in ReorderBuffer, the pane p is kept in the slot p mod capacity of a ring, that is doubled when a pane
+ * arrives too far ahead. Each slot has room for SPLIT_MAX_FRAGMENTS fragments: contiguous fragments are
+ * combined as soon as they are received, therefore a complete pane takes a single one. The splitter bounds
+ * the fragments of a pane (see the removal of replicas in splitter.cpp), so that a slot never overflows.
+ * Slots are reused once their pane is not needed anymore, so that no memory is allocated in steady state.
+ */
+class SplitKeyMerger{
+public:
+    /**
+     * @param type the key
+     */
+    SplitKeyMerger(int type, int window_size, int window_slide)
+    {
+        this->type=type;
+        this->window_slide=window_slide;
+        window_panes=window_size/window_slide;
+        window=new const pane_summary_t*[window_panes];
+        capacity=16;
+        while(capacity<2*window_panes)
+            capacity*=2;
+        slots=newSlots(capacity);
+        lo=INT64_MAX;
+    }
+
+    ~SplitKeyMerger()
+    {
+        delete[] window;
+        delete[] slots;
+    }
+
+    /**
+     * @brief add stores a copy of the summary carried by a partial result
+     */
+    void add(const winresult_t *r)
+    {
+        const pane_summary_t *p=(const pane_summary_t *)r->pane;
+        slot_t &s=getOrCreate(p->first_iid/window_slide);
+        if(s.n==window_slide) //already received
+            return;
+        addFragment(s,*p);
+        s.n+=p->n;
+        if(p->first_iid+p->n==(p->first_iid/window_slide+1)*window_slide) //it contains the triggering quote
+        {
+            s.timestamp=r->timestamp;
+            s.original_timestamp=r->original_timestamp;
+            s.wid=r->wid;
+        }
+    }
+
+    /**
+     * @brief produce computes the result with the given id, if all its panes have been received.
+     * The panes that are not needed anymore are discarded
+     * @param id the id of the expected result
+     * @return true if the result has been produced
+     */
+    bool produce(int64_t id, winresult_t &res)
+    {
+        int64_t last=(id+1)/window_slide-1;
+        int64_t first=(last-window_panes+1>0)?last-window_panes+1:0;
+        //the previous panes are not needed anymore (the results may have been produced by the owner of the key)
+        release(first);
+        int n=0;
+        for(int64_t p=first;p<=last;p++)
+        {
+            slot_t &s=slot(p);
+            if(s.pane!=p || s.n<window_slide)
+                return false;
+            //complete: its fragments have been combined in one
+            window[n++]=&s.fragments[0];
+        }
+        pane_compute(window,n,n-1,par_bid,par_ask,res);
+        slot_t &s=slot(last);
+        res.timestamp=s.timestamp;
+        res.original_timestamp=s.original_timestamp;
+        res.wid=s.wid;
+        res.id=id;
+        res.type=type;
+        res.isEOS=false;
+        res.pane=NULL;
+        //the next window starts from the pane after first
+        release(first+1);
+        return true;
+    }
+
+private:
+    typedef struct slot_t{
+        int64_t pane=-1;                //id of the pane, -1 if the slot is free
+        int n=0;                        //quotes received
+        int nfragments=0;
+        pane_summary_t fragments[SPLIT_MAX_FRAGMENTS];  //ordered by internal id, not contiguous
+        long long timestamp=0;          //of the triggering quote
+        long original_timestamp=0;
+        worker_id_t wid=0;              //replica that has sent the triggering quote
+    }slot_t;
+
+    static slot_t *newSlots(int n)
+    {
+        return new slot_t[n];
+    }
+
+    inline slot_t &slot(int64_t p)
+    {
+        return slots[p&(capacity-1)];
+    }
+
+    /**
+     * Returns the slot of a pane, taking a free one if it is the first fragment
+     */
+    slot_t &getOrCreate(int64_t p)
+    {
+        while(slot(p).pane!=-1 && slot(p).pane!=p)
+            grow();
+        slot_t &s=slot(p);
+        if(s.pane!=p)
+        {
+            s.pane=p;
+            s.n=0;
+            s.nfragments=0;
+        }
+        if(p<lo)
+            lo=p;
+        return s;
+    }
+
+    /**
+     * Frees the slots of the panes before the given one
+     */
+    void release(int64_t p)
+    {
+        if(p<=lo)
+            return;
+        int64_t end=(p-lo<capacity)?p:lo+capacity; //each slot is visited at most once
+        for(int64_t q=lo;q<end;q++)
+            if(slot(q).pane!=-1 && slot(q).pane<p)
+                slot(q).pane=-1;
+        lo=p;
+    }
+
+    /**
+     * Doubles the capacity, moving the panes in their new slots
+     */
+    void grow()
+    {
+        slot_t *old=slots;
+        int old_capacity=capacity;
+        capacity*=2;
+        slots=newSlots(capacity);
+        for(int i=0;i<old_capacity;i++)
+            if(old[i].pane!=-1)
+                slot(old[i].pane)=old[i];
+        delete[] old;
+    }
+
+    /**
+     * Inserts a fragment, combining it with the adjacent ones
+     */
+    void addFragment(slot_t &s, const pane_summary_t &p)
+    {
+        int i=0;
+        while(i<s.nfragments && s.fragments[i].first_iid<p.first_iid)
+            i++;
+        bool after_prev=(i>0 && s.fragments[i-1].first_iid+s.fragments[i-1].n==p.first_iid);
+        bool before_next=(i<s.nfragments && p.first_iid+p.n==s.fragments[i].first_iid);
+        if(after_prev)
+        {
+            s.fragments[i-1]=pane_combine(s.fragments[i-1],p);
+            if(before_next)
+            {
+                s.fragments[i-1]=pane_combine(s.fragments[i-1],s.fragments[i]);
+                for(int j=i;j<s.nfragments-1;j++)
+                    s.fragments[j]=s.fragments[j+1];
+                s.nfragments--;
+            }
+        }
+        else if(before_next)
+            s.fragments[i]=pane_combine(p,s.fragments[i]);
+        else
+        {
+            for(int j=s.nfragments;j>i;j--)
+                s.fragments[j]=s.fragments[j-1];
+            s.fragments[i]=p;
+            s.nfragments++;
+        }
+    }
+
+    int type;
+    int window_slide;
+    int window_panes;
+    slot_t *slots;
+    int capacity;
+    int64_t lo;                         //lowest pane that may still be in the ring
+    const pane_summary_t **window;      //panes of the window being computed
+    double par_bid[3]={0,0,0};
+    double par_ask[3]={0,0,0};
+};
+
+#endif // PANE_HPP
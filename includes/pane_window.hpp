@@ -0,0 +1,282 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Pane based count window
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef PANE_WINDOW_HPP
+#define PANE_WINDOW_HPP
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include "general.h"
+#include "window.h"
+#include "pane.hpp"
+
+/**
+ * The PaneWindow class is a count based window (with the same semantics of CBWindow) that does not keep
+ * the quotes: only the summaries of its panes (see pane.hpp) are stored, and the result of a window is
+ * obtained by combining them. The combination of the panes shared by consecutive windows is reused
+ * (two stacks aggregation):
+ * - the panes are split in a front part, for which the combination of each suffix is kept, and a back part,
+ *   of which only the overall combination is kept;
+ * - a new pane is combined to the back part; the oldest one leaves the front part;
+ * - when the front part is empty, the suffixes of the back part are computed and it becomes the front part.
+ * Therefore each computation costs O(1) combinations (amortized) and each quote is added once to its pane.
+ * Differently from CBWindow, power sums are never decremented, so no rounding error accumulates.
+ *
+ * It takes 2*window_size/window_slide summaries instead of window_size quotes: it is convenient when
+ * the slide is large. The parabola is always fitted in closed form.
+ * It is used instead of CBWindow compiling with -DPANE_WINDOW (see window_directory.hpp).
+ */
+class PaneWindow : public Window<tuple_t,winresult_t>{
+public:
+
+    /**
+     * Constructor of the Pane Window
+     * @param window_size
+     * @param window_slide
+     * @param storage if not NULL, cache aligned memory (of storageSize(window_size,window_slide) bytes) in which
+     * the summaries will be kept. It is owned by the caller
+     */
+    PaneWindow(int window_size, int window_slide, void *storage=NULL)
+    {
+        this->window_size=window_size;
+        this->window_slide=window_slide;
+        window_panes=window_size/window_slide;
+        elements=NULL;
+        external_storage=(storage!=NULL);
+        if(!external_storage && posix_memalign(&storage,CACHE_LINE_SIZE,storageSize(window_size,window_slide))!=0)
+        {
+            fprintf(stderr,"Error in allocating window\n");
+            exit(-1);
+        }
+        panes=new (storage) pane_summary_t[window_panes];
+        suffix=new ((char *)storage+alignedSize(window_panes*sizeof(pane_summary_t))) pane_summary_t[window_panes];
+        reset();
+    }
+
+    ~PaneWindow()
+    {
+        if(!external_storage)
+            free(panes);
+    }
+
+    /**
+     * @brief storageSize returns the memory needed for the summaries of a window of the given size
+     */
+    static size_t storageSize(int window_size, int window_slide)
+    {
+        return 2*alignedSize((window_size/window_slide)*sizeof(pane_summary_t));
+    }
+
+    int getSize()
+    {
+        return window_size;
+    }
+
+    int64_t getTotalElements()
+    {
+        return total_elements;
+    }
+
+    /**
+     * @brief setFirstId the window (that must be empty) receives the quotes of its class starting from the
+     * one with the given internal id, instead of the first one
+     */
+    void setFirstId(int64_t iid)
+    {
+        first_iid=iid;
+        pane_init(&cur,iid);
+        pane_init(&back,iid);
+    }
+
+    int64_t getFirstId()
+    {
+        return first_iid;
+    }
+
+    /**
+     * Insert the tuple passed as argument into the current pane
+     * @param t tuple to insert
+     */
+    void insert(const tuple_t& t)
+    {
+        pane_add(&cur,t.original_timestamp,(t.bid_size>0)?t.bid_price:NAN,(t.ask_size>0)?t.ask_price:NAN);
+        total_elements++;
+        eflc++;
+        if(cur.n==window_slide) //the pane is complete
+        {
+            push(cur);
+            pane_init(&cur,first_iid+total_elements);
+        }
+    }
+
+    /**
+     * isComputable return a boolean indicating if the computation can be triggered
+     * i.e. window_slide tuples have been inserted since the last computation
+     */
+    bool isComputable()
+    {
+        return (eflc==window_slide);
+    }
+
+    /**
+     * Compute on the last window_size received elements
+     * @param res the reference in which save the result
+     */
+    void compute(winresult_t &res)
+    {
+        if(eflc!=window_slide)
+            return;
+        eflc=0;
+        if(front==split)
+            flip();
+        pane_summary_t w=pane_combine(suffix[front%window_panes],back);
+        pane_fit_t fbid, fask;
+        pane_fit_begin(&fbid,w.origin);
+        pane_fit_begin(&fask,w.origin);
+        pane_fit_append(&fbid,w.bid);
+        pane_fit_append(&fask,w.ask);
+        pane_fit_solve(&fbid,par_bid);
+        res.p0_bid=par_bid[0];
+        res.p1_bid=par_bid[1];
+        res.p2_bid=par_bid[2];
+        pane_fit_solve(&fask,par_ask);
+        res.p0_ask=par_ask[0];
+        res.p1_ask=par_ask[1];
+        res.p2_ask=par_ask[2];
+        //the candlesticks refer to the last pane
+        const pane_summary_t &last=pane(next-1);
+        candlestick_t cbid, cask;
+        bool bid_opened=false, ask_opened=false;
+        ohlc_init(&cbid);
+        ohlc_init(&cask);
+        pane_ohlc_append(&cbid,bid_opened,last.bid);
+        pane_ohlc_append(&cask,ask_opened,last.ask);
+        res.open_bid=cbid.open;
+        res.close_bid=cbid.close;
+        res.high_bid=cbid.high;
+        res.low_bid=cbid.low;
+        res.open_ask=cask.open;
+        res.close_ask=cask.close;
+        res.high_ask=cask.high;
+        res.low_ask=cask.low;
+    }
+
+    /**
+     * Reset the window content
+     */
+    void reset()
+    {
+        total_elements=0;
+        first_iid=0;
+        eflc=0;
+        front=split=next=0;
+        pane_init(&cur,0);
+        pane_init(&back,0);
+    }
+
+    /**
+     * @brief summarize calls f(pane_summary_t *) on the summaries of the panes in window, starting from the
+     * one with internal id from_iid (that must be the first of a pane). The last one is the current pane, if
+     * it is not empty
+     */
+    template <typename F>
+    void summarize(int64_t from_iid, F f)
+    {
+        for(int64_t p=front;p<next;p++)
+        {
+            if(first_iid+p*window_slide<from_iid)
+                continue;
+            pane_summary_t s=pane(p);
+            f(&s);
+        }
+        if(cur.n>0)
+        {
+            pane_summary_t s=cur;
+            f(&s);
+        }
+    }
+
+private:
+
+    inline pane_summary_t &pane(int64_t p)
+    {
+        return panes[p%window_panes];
+    }
+
+    /**
+     * Add a complete pane, evicting the oldest one if the window is full
+     */
+    void push(const pane_summary_t &p)
+    {
+        if(next-front==window_panes)
+        {
+            if(front==split) //the front part is empty (the window has not been computed since the last flip)
+                flip();
+            front++;
+        }
+        pane(next)=p;
+        next++;
+        back=pane_combine(back,p);
+    }
+
+    /**
+     * The back part becomes the front part: the combinations of its suffixes are computed
+     */
+    void flip()
+    {
+        for(int64_t p=next-1;p>=front;p--)
+            suffix[p%window_panes]=(p==next-1)?pane(p):pane_combine(pane(p),suffix[(p+1)%window_panes]);
+        split=next;
+        pane_init(&back,first_iid+next*window_slide);
+    }
+
+    static size_t alignedSize(size_t size)
+    {
+        return (size+CACHE_LINE_SIZE-1)/CACHE_LINE_SIZE*CACHE_LINE_SIZE;
+    }
+
+    bool external_storage;      //true if the memory has not been allocated by the window
+    pane_summary_t *panes;      //the last window_panes complete panes (circular buffer indexed by pane id)
+    pane_summary_t *suffix;     //combination of each pane of the front part with the following ones of that part
+    pane_summary_t cur;         //pane that is being filled
+    pane_summary_t back;        //combination of the panes of the back part
+    int64_t front;              //id of the oldest pane in window
+    int64_t split;              //id of the first pane of the back part
+    int64_t next;               //id of the next complete pane
+    int window_size;
+    int window_slide;
+    int window_panes;
+    int64_t total_elements;
+    int64_t first_iid;          //internal id of the first element
+    int eflc;                   //elements received from the last computation
+    //starting parameter for the fitting
+    double par_bid[3]={0,0,0};
+    double par_ask[3]={0,0,0};
+};
+
+#endif // PANE_WINDOW_HPP
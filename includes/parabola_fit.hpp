@@ -0,0 +1,198 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Closed form least squares fitting of the parabola p0+p1*x+p2*x^2.
+
+    The fitting is performed by solving the 3x3 normal equations built from
+    the power sums of the points (sum x^k, k=0..4, and sum y*x^k, k=0..2).
+    Since these sums can be updated by adding and removing single points,
+    they can be maintained incrementally while the window slides.
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef PARABOLA_FIT_HPP
+#define PARABOLA_FIT_HPP
+#include <math.h>
+
+/**
+ * Power sums of a set of points (x,y), where x is expressed relatively
+ * to an origin (a timestamp). They are the sufficient statistics for fitting a parabola.
+ */
+class FitMoments{
+public:
+
+    FitMoments()
+    {
+        clear(0);
+    }
+
+    /**
+     * @brief clear remove all the points and set a new origin
+     */
+    void clear(double origin)
+    {
+        this->origin=origin;
+        for(int k=0;k<5;k++)
+            s[k]=0;
+        for(int k=0;k<3;k++)
+            t[k]=0;
+    }
+
+    /**
+     * @brief add adds (sign=1) or removes (sign=-1) a point
+     * @param ts timestamp of the point
+     * @param y its y-value
+     */
+    void add(double ts, double y, double sign=1)
+    {
+        double x=ts-origin;
+        double xk=sign;
+        for(int k=0;k<3;k++)
+        {
+            s[k]+=xk;
+            t[k]+=xk*y;
+            xk*=x;
+        }
+        s[3]+=xk;
+        s[4]+=xk*x;
+    }
+
+    /**
+     * @brief merge adds all the points of another set (that can refer to a different origin)
+     */
+    void merge(const FitMoments &other)
+    {
+        double ss[5], tt[3];
+        other.shifted(origin,ss,tt);
+        for(int k=0;k<5;k++)
+            s[k]+=ss[k];
+        for(int k=0;k<3;k++)
+            t[k]+=tt[k];
+    }
+
+    /**
+     * @brief npoints returns the number of points in the set
+     */
+    int npoints() const
+    {
+        return (int)round(s[0]);
+    }
+
+    /**
+     * @brief solve computes the least squares parabola through the points
+     * @param new_origin the origin of the x-axis for the returned coefficients
+     * @param par where to store the three coefficients
+     * @return false if the system is underdetermined (less than three points or all the points
+     * with the same x). In this case par is left untouched
+     */
+    bool solve(double new_origin, double *par) const
+    {
+        double ss[5], tt[3];
+        if(npoints()<3)
+            return false;
+        shifted(new_origin,ss,tt);
+
+        //the x are rescaled to have unitary mean square, to keep the system well conditioned
+        double scale=sqrt(ss[2]/ss[0]);
+        if(!(scale>0))
+            return false;
+        double a[3][4];
+        double sk[5], sc=1;
+        for(int k=0;k<5;k++)
+        {
+            sk[k]=ss[k]/sc;
+            sc*=scale;
+        }
+        sc=1;
+        for(int i=0;i<3;i++)
+        {
+            for(int j=0;j<3;j++)
+                a[i][j]=sk[i+j];
+            a[i][3]=tt[i]/sc;
+            sc*=scale;
+        }
+
+        //gaussian elimination with partial pivoting
+        for(int c=0;c<3;c++)
+        {
+            int p=c;
+            for(int r=c+1;r<3;r++)
+                if(fabs(a[r][c])>fabs(a[p][c]))
+                    p=r;
+            if(fabs(a[p][c])<=1e-12*sk[0])
+                return false;
+            if(p!=c)
+                for(int j=c;j<4;j++)
+                {
+                    double tmp=a[c][j];
+                    a[c][j]=a[p][j];
+                    a[p][j]=tmp;
+                }
+            for(int r=c+1;r<3;r++)
+            {
+                double f=a[r][c]/a[c][c];
+                for(int j=c;j<4;j++)
+                    a[r][j]-=f*a[c][j];
+            }
+        }
+        double sol[3];
+        for(int r=2;r>=0;r--)
+        {
+            double v=a[r][3];
+            for(int j=r+1;j<3;j++)
+                v-=a[r][j]*sol[j];
+            sol[r]=v/a[r][r];
+        }
+        par[0]=sol[0];
+        par[1]=sol[1]/scale;
+        par[2]=sol[2]/(scale*scale);
+        return true;
+    }
+
+    double origin;  //timestamp that corresponds to x=0
+    double s[5];    //sum of x^k
+    double t[3];    //sum of y*x^k
+
+private:
+
+    /**
+     * Power sums expressed with respect to a different origin (binomial expansion)
+     */
+    void shifted(double new_origin, double *ss, double *tt) const
+    {
+        //x'=x+d
+        double d=origin-new_origin;
+        double d2=d*d, d3=d2*d, d4=d3*d;
+        ss[0]=s[0];
+        ss[1]=s[1]+d*s[0];
+        ss[2]=s[2]+2*d*s[1]+d2*s[0];
+        ss[3]=s[3]+3*d*s[2]+3*d2*s[1]+d3*s[0];
+        ss[4]=s[4]+4*d*s[3]+6*d2*s[2]+4*d3*s[1]+d4*s[0];
+        tt[0]=t[0];
+        tt[1]=t[1]+d*t[0];
+        tt[2]=t[2]+2*d*t[1]+d2*t[0];
+    }
+};
+
+#endif // PARABOLA_FIT_HPP
@@ -0,0 +1,117 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Bitmap of the replicas that have pushed something toward the merger
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef READY_MASK_HPP
+#define READY_MASK_HPP
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <atomic>
+#include <new>
+#include "general.h"
+
+/**
+ * Each replica sets its bit after having pushed into its queue toward the merger.
+ * The merger takes (and clears) the whole bitmap and drains only the queues of the
+ * signalled replicas: it does not need to poll the empty ones.
+ *
+ * A producer sets its bit only if it is not already set, therefore under load the cache line
+ * of the bitmap moves once per merger round rather than once per result.
+ * The check of the bit must not be reordered before the push (that on x86 is a plain store): otherwise
+ * the producer could see the bit still set while the merger clears it and finds the queue empty, and the
+ * element would remain in the queue without its bit. Therefore set() is preceded by a full fence, and take()
+ * is a sequentially consistent exchange. Since the bit is set after the push, at worst the merger visits a
+ * queue that it has already drained. Anyway the merger also checks all the queues before parking (see merger.cpp).
+ */
+class ReadyMask{
+public:
+    /**
+     * @param nbits maximum number of replicas
+     */
+    ReadyMask(int nbits)
+    {
+        nwords=(nbits+63)/64;
+        if(posix_memalign((void **)&words,CACHE_LINE_SIZE,nwords*sizeof(std::atomic<uint64_t>))!=0)
+        {
+            fprintf(stderr,"Error in allocating the ready mask\n");
+            exit(-1);
+        }
+        for(int i=0;i<nwords;i++)
+            new (&words[i]) std::atomic<uint64_t>(0);
+    }
+
+    ~ReadyMask()
+    {
+        free(words);
+    }
+
+    /**
+     * @brief set signals that replica bit has pushed something
+     */
+    inline void set(int bit)
+    {
+        std::atomic<uint64_t> &w=words[bit>>6];
+        uint64_t m=1ULL<<(bit&63);
+        //orders the previous push before the check of the bit (store-load)
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(!(w.load(std::memory_order_relaxed)&m))
+            w.fetch_or(m,std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief take returns and clears a word of the bitmap
+     */
+    inline uint64_t take(int word)
+    {
+        if(words[word].load(std::memory_order_relaxed)==0)
+            return 0;
+        return words[word].exchange(0,std::memory_order_seq_cst);
+    }
+
+    /**
+     * @brief any returns true if some bit is set
+     */
+    inline bool any() const
+    {
+        for(int i=0;i<nwords;i++)
+            if(words[i].load(std::memory_order_relaxed)!=0)
+                return true;
+        return false;
+    }
+
+    inline int getNumWords() const
+    {
+        return nwords;
+    }
+
+private:
+    std::atomic<uint64_t> *words;
+    int nwords;
+};
+
+#endif // READY_MASK_HPP
@@ -0,0 +1,211 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    In-order reassembly of the results of a key in the merger
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef REORDER_BUFFER_HPP
+#define REORDER_BUFFER_HPP
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "general.h"
+
+#define REORDER_INITIAL_CAPACITY 16         //slots allocated at the first result received out of order
+#define REORDER_MAX_CAPACITY 4096           //maximum number of windows that a key can have in advance
+
+/*
+ * After a state migration the results of a key can arrive out of order: the new replica
+ * may start producing while the old one is still computing the previous windows.
+ * The results of a key have consecutive ids (they differ by window_slide), therefore the one
+ * with id i is kept in the slot (i/window_slide) mod capacity of a ring. Insertion and release
+ * of each result cost O(1).
+ *
+ * The ring is allocated at the first out-of-order result of the key and it is doubled when a
+ * result is too far ahead, up to REORDER_MAX_CAPACITY slots. Beyond that, the results still
+ * missing are given up: the buffered ones are released (in order) until the new one fits.
+ */
+class ReorderBuffer{
+public:
+    ReorderBuffer()
+    {
+        slots=NULL;
+        used=NULL;
+        capacity=0;
+        window_slide=1;
+        buffered=0;
+        max_depth=0;
+        reordered=0;
+        skipped=0;
+    }
+
+    ~ReorderBuffer()
+    {
+        free(slots);
+        free(used);
+    }
+
+    void setWindowSlide(int window_slide)
+    {
+        this->window_slide=window_slide;
+    }
+
+    /**
+     * @brief insert buffers a result arrived ahead of the expected one
+     * @param r the result (r->id>expected)
+     * @param expected id of the next result to deliver. It is advanced if some results
+     * have to be given up for making room
+     * @param deliver invoked on the results released for making room
+     */
+    template <typename Deliver>
+    void insert(const winresult_t *r, int64_t &expected, Deliver deliver)
+    {
+        int64_t depth=(r->id-expected)/window_slide;
+        if(depth>max_depth)
+            max_depth=depth;
+        reordered++;
+        while(depth>=capacity && capacity<REORDER_MAX_CAPACITY)
+            grow();
+        while(depth>=capacity)
+        {
+            //too far ahead: stop waiting for the expected one
+            int s=slot(expected);
+            if(used[s])
+            {
+                used[s]=0;
+                buffered--;
+                deliver(&slots[s]);
+            }
+            else
+                skipped++;
+            expected+=window_slide;
+            depth--;
+        }
+        int s=slot(r->id);
+        slots[s]=*r;
+        used[s]=1;
+        buffered++;
+    }
+
+    /**
+     * @brief release delivers the buffered results that follow (without holes) the expected one
+     * @return the number of results released
+     */
+    template <typename Deliver>
+    int release(int64_t &expected, Deliver deliver)
+    {
+        int n=0;
+        while(buffered>0)
+        {
+            int s=slot(expected);
+            if(!used[s])
+                break;
+            used[s]=0;
+            buffered--;
+            deliver(&slots[s]);
+            expected+=window_slide;
+            n++;
+        }
+        return n;
+    }
+
+    /**
+     * @brief getBuffered returns the number of results currently waiting
+     */
+    inline int getBuffered() const
+    {
+        return buffered;
+    }
+
+    /**
+     * @brief getMaxDepth returns the maximum distance (in windows) of a result from the expected one
+     */
+    inline int64_t getMaxDepth() const
+    {
+        return max_depth;
+    }
+
+    /**
+     * @brief getReordered returns the number of results that have been buffered
+     */
+    inline int64_t getReordered() const
+    {
+        return reordered;
+    }
+
+    /**
+     * @brief getSkipped returns the number of results given up for lack of room
+     */
+    inline int64_t getSkipped() const
+    {
+        return skipped;
+    }
+
+private:
+
+    inline int slot(int64_t id) const
+    {
+        return (int)((id/window_slide)&(capacity-1));
+    }
+
+    /**
+     * Doubles the capacity, moving the buffered results in their new slots
+     */
+    void grow()
+    {
+        int new_capacity=(capacity==0)?REORDER_INITIAL_CAPACITY:capacity*2;
+        winresult_t *new_slots=(winresult_t *)malloc(new_capacity*sizeof(winresult_t));
+        char *new_used=(char *)calloc(new_capacity,sizeof(char));
+        if(new_slots==NULL || new_used==NULL)
+        {
+            fprintf(stderr,"Error in allocating the reorder buffer\n");
+            exit(-1);
+        }
+        for(int i=0;i<capacity;i++)
+            if(used[i])
+            {
+                int s=(int)((slots[i].id/window_slide)&(new_capacity-1));
+                new_slots[s]=slots[i];
+                new_used[s]=1;
+            }
+        free(slots);
+        free(used);
+        slots=new_slots;
+        used=new_used;
+        capacity=new_capacity;
+    }
+
+    winresult_t *slots;
+    char *used;                     //used[i] is 1 if slots[i] contains a result
+    int capacity;                   //always a power of two
+    int window_slide;
+    int buffered;
+    int64_t max_depth;
+    int64_t reordered;
+    int64_t skipped;
+};
+
+#endif // REORDER_BUFFER_HPP
@@ -0,0 +1,223 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Pool of pre-spawned replicas
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef REPLICA_POOL_HPP
+#define REPLICA_POOL_HPP
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <iostream>
+#include <ff/buffer.hpp>
+#include "general.h"
+#include "messages.hpp"
+#include "pane.hpp"
+#include "wait_policy.hpp"
+#include "elastic-hft.h"
+
+/*
+ * Spawning a replica during a reconfiguration (thread creation, affinity, allocation of queues
+ * and result buffer) takes milliseconds. The pool creates at startup one thread for each of the
+ * max_workers replicas, already pinned on its core: a thread is parked (on a futex) until its
+ * replica is activated. Each slot of the pool has its queues and result buffer ready, therefore
+ * scaling up only requires to publish the queues to splitter and merger and to unpark the threads.
+ *
+ * When a replica is removed, its thread goes back to the parked state. Its queues are given
+ * up (the one toward the merger is destroyed by the merger) and the slot is prepared again by
+ * the controller, once the reconfiguration has finished.
+ */
+
+class ReplicaPool{
+public:
+    /**
+     * @param max_workers number of slots (replicas)
+     * @param qsize size of the data queues
+     * @param templ data shared by all the replicas (window size, strategy descriptor, ...)
+     * @param affinities core of each replica
+     */
+    ReplicaPool(int max_workers, int qsize, const worker_data_t &templ, int *affinities)
+    {
+        this->max_workers=max_workers;
+        this->qsize=qsize;
+        shutting_down.store(false);
+        slots=new Slot[max_workers];
+        for(int i=0;i<max_workers;i++)
+        {
+            slots[i].data=templ;
+            slots[i].data.workerId=i;
+            slots[i].data.barrier=NULL;
+            slots[i].data.inqueue=NULL;
+            slots[i].data.outqueue=NULL;
+            slots[i].data.cn_outqueue=NULL;
+            slots[i].data.res_buff=NULL;
+            //the windows of all the activations of the replica are taken from the same arena
+            slots[i].data.arena=new WindowArena();
+            #if defined(MONITORING)
+            slots[i].data.mon_ring=new msg::MonitoringRing<msg::WorkerMonitoring>(templ.num_classes);
+            #endif
+            slots[i].state.store(PARKED);
+            slots[i].pool=this;
+            prepare(i);
+        }
+        for(int i=0;i<max_workers;i++)
+        {
+            pthread_create(&slots[i].tid,NULL,run,&slots[i]);
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(affinities[i], &cpuset);
+            if (pthread_setaffinity_np(slots[i].tid, sizeof(cpu_set_t), &cpuset)) {
+                std::cerr << "Cannot set thread to CPU " << affinities[i] << std::endl;
+            }
+        }
+    }
+
+    /**
+     * @brief prepare allocates the queues and the result buffer of a slot, discarding the previous ones.
+     * It has to be called when the replica is not active (it waits for the termination of the previous one)
+     */
+    void prepare(int id)
+    {
+        Slot &s=slots[id];
+        while(s.state.load()==RUNNING)
+            sched_yield();
+        //the queue from the splitter is no more used by anyone (the one toward the merger is deleted by the merger).
+        //The doorbell on which the replica waited for it (if any) is moved to the new queue, so that registry
+        //slots and doorbells are not consumed at each reconfiguration
+        Doorbell *bell=NULL;
+        if(s.data.inqueue)
+        {
+            bell=doorbells().lookup(s.data.inqueue);
+            doorbells().detach(s.data.inqueue);
+            delete s.data.inqueue;
+        }
+        s.data.inqueue=new ff::SWSR_Ptr_Buffer(qsize);
+        s.data.inqueue->init();
+        if(bell && !doorbells().attach(s.data.inqueue,bell))
+            std::cerr << ANSI_COLOR_RED "Doorbell registry full: replica "<<id<<" will wait without parking" ANSI_COLOR_RESET<<std::endl;
+        s.data.outqueue=new ff::SWSR_Ptr_Buffer(qsize);
+        s.data.outqueue->init();
+        #if defined(MONITORING)
+        //the controller gives up the monitoring queue of a removed replica
+        if(s.data.cn_outqueue)
+        {
+            doorbells().detach(s.data.cn_outqueue);
+            delete s.data.cn_outqueue;
+        }
+        s.data.cn_outqueue=new ff::SWSR_Ptr_Buffer(QUEUE_SIZE_MON);
+        s.data.cn_outqueue->init();
+        #endif
+        //freed by the merger when it receives the EOS of the replica
+        if(posix_memalign((void **)&s.data.res_buff,CACHE_LINE_SIZE,result_buffer_size(s.data.sd->hot_key_split))!=0)
+        {
+            std::cerr << ANSI_COLOR_RED "Error in allocating the result buffer of replica "<<id<< ANSI_COLOR_RESET<<std::endl;
+            exit(-1);
+        }
+    }
+
+    inline ff::SWSR_Ptr_Buffer *getInQueue(int id)
+    {
+        return slots[id].data.inqueue;
+    }
+
+    inline ff::SWSR_Ptr_Buffer *getOutQueue(int id)
+    {
+        return slots[id].data.outqueue;
+    }
+
+    inline ff::SWSR_Ptr_Buffer *getMonitoringQueue(int id)
+    {
+        return slots[id].data.cn_outqueue;
+    }
+
+    /**
+     * @brief activate unparks a replica
+     * @param barrier initial synchronization barrier (only for the replicas started with the program)
+     */
+    void activate(int id, pthread_barrier_t *barrier=NULL)
+    {
+        Slot &s=slots[id];
+        //the previous replica of this slot may still be returning
+        while(s.state.load()==RUNNING)
+            sched_yield();
+        s.data.barrier=barrier;
+        s.state.store(ACTIVATED);
+        s.bell.ring();
+    }
+
+    /**
+     * @brief shutdown waits for the termination of the active replicas and terminates the threads
+     */
+    void shutdown()
+    {
+        shutting_down.store(true);
+        for(int i=0;i<max_workers;i++)
+            slots[i].bell.ring();
+        for(int i=0;i<max_workers;i++)
+            pthread_join(slots[i].tid,NULL);
+    }
+
+private:
+    enum{
+        PARKED,
+        ACTIVATED,
+        RUNNING
+    };
+
+    typedef struct{
+        worker_data_t data;
+        std::atomic<int> state;
+        Doorbell bell;
+        pthread_t tid;
+        ReplicaPool *pool;
+    }Slot;
+
+    static void *run(void *arg)
+    {
+        Slot *s=(Slot *)arg;
+        for(;;)
+        {
+            //parked until activation (or termination of the program)
+            auto ready=[&]()->bool{return s->state.load()==ACTIVATED || s->pool->shutting_down.load();};
+            while(!ready())
+                s->bell.park(ready,WAIT_PARK_USECS*100);
+            int expected=ACTIVATED;
+            if(!s->state.compare_exchange_strong(expected,RUNNING))
+                return NULL; //shutdown
+            worker(&s->data);
+            //the result buffer has been handed to the merger
+            s->data.res_buff=NULL;
+            s->state.store(PARKED);
+        }
+    }
+
+    Slot *slots;
+    int max_workers;
+    int qsize;
+    std::atomic<bool> shutting_down;
+};
+
+#endif // REPLICA_POOL_HPP
@@ -39,7 +39,7 @@
 */
 #ifndef REPOSITORY_HPP
 #define REPOSITORY_HPP
-#include "cbwindow.hpp"
+#include "window_directory.hpp"
 class Repository{
 public:
     /**
@@ -52,7 +52,7 @@ public:
     {
         max_workers=max_entities;
         nc=num_classes;
-        moving_windows=new CBWindow*[num_classes]();
+        moving_windows=new window_t*[num_classes]();
         reconfiguration_finished=new bool[max_entities]();
         has_to_move_out=new bool[max_entities]();
         //set all window entries to nullptr
@@ -89,11 +89,11 @@ public:
      * @param class_id id of the class that we are looking for
      * @return the Window if present into the repository, nullptr otherwise
      */
-    CBWindow* getAndRemoveWindow(int class_id)
+    window_t* getAndRemoveWindow(int class_id)
     {
         if(moving_windows[class_id])
         {
-            CBWindow * ret=moving_windows[class_id];
+            window_t * ret=moving_windows[class_id];
             moving_windows[class_id]=nullptr;
             return ret;
         }
@@ -106,7 +106,7 @@ public:
      * @param class_id class type of the window that we want to move through the repository
      * @param window reference to the window that we want to move
      */
-    void setWindow(int class_id, CBWindow *window)
+    void setWindow(int class_id, window_t *window)
     {
         moving_windows[class_id]=window;
     }
@@ -179,7 +179,7 @@ public:
 private:
     int max_workers;
     int nc;
-    CBWindow **moving_windows;
+    window_t **moving_windows;
     //ticks moving_time[3000]; //just for testing
 //    unordered_map<int,CBWindow*> *moving_windows; //map that contains the various windows that have to be moved
     bool *reconfiguration_finished; //prima era un atomic int....non ricordo perche' (era anche allineato)
@@ -21,6 +21,7 @@
     ---------------------------------------------------------------------
  * Contains various heuristic for computing a scheduling table
  */
+#include "consistent_hash.hpp"
 //Utility function and definition that will be used in constructing the scheduling table
 
 typedef struct{
@@ -44,7 +45,7 @@ static int cmppair(const void *p1, const void *p2)
     @param wtcalc_per_class: it contains for each class the product  class_frequency*tcalc_class, computed using the monitored data
     @param scheduling_table: the past scheduling table that will be modified
 */
-void compute_fb_st(int num_workers, int num_classes,double* wtcalc_per_class, char *scheduling_table)
+void compute_fb_st(int num_workers, int num_classes,double* wtcalc_per_class, worker_id_t *scheduling_table)
 {
     double *load_w=new double[num_workers]();
     pair_t *v=new pair_t[num_classes]();
@@ -82,7 +83,7 @@ void compute_fb_st(int num_workers, int num_classes,double* wtcalc_per_class, ch
     }*/
 }
 
-void compute_st_flux(int num_workers, int prev_workers, int num_classes,double* wtcalc_per_class, char *scheduling_table)
+void compute_st_flux(int num_workers, int prev_workers, int num_classes,double* wtcalc_per_class, worker_id_t *scheduling_table)
 {
     const double imb_thr=1.1; //imbalance of 10%
     pair_t *v=new pair_t[num_classes]();
@@ -204,3 +205,175 @@ void compute_st_flux(int num_workers, int prev_workers, int num_classes,double*
 
 
 }
+
+/**
+    Incrementally rebalance the current scheduling table, moving as few classes as possible.
+    Classes assigned to workers that no longer exist are moved first (heavier ones first, each one to
+    the currently less loaded worker). Then, while the most loaded worker exceeds the average load by more
+    than max_imbalance, one of its classes is moved to the less loaded worker: the heaviest one that does not bring the
+    receiver over the bound or, if there is none, the one that best halves the gap between the two. The rebalancing
+    stops if no class can reduce the imbalance.
+    Since every key with a full window holds the same amount of state, the number of moved classes is
+    also proportional to the bytes of window state that have to be migrated.
+    Split classes (SPLIT_CLASS) are not moved: their load is spread evenly on all the workers
+    @param num_workers the number of workers to which tuples have to be routed
+    @param num_classes
+    @param wtcalc_per_class: it contains for each class the product  class_frequency*tcalc_class, computed using the monitored data
+    @param scheduling_table: the current scheduling table that will be modified
+    @param max_imbalance: maximum load of a worker with respect to the average one (e.g. 0.1 means 10% above the average)
+    @return the number of classes that have been moved to a different worker
+*/
+int compute_st_incremental(int num_workers, int num_classes,double* wtcalc_per_class, worker_id_t *scheduling_table, double max_imbalance)
+{
+    double *load_w=new double[num_workers]();
+    pair_t *v=new pair_t[num_classes]();
+    double tot_load=0;
+    int moved=0;
+    for(int i=0;i<num_classes;i++)
+    {
+        v[i].l=wtcalc_per_class[i];
+        v[i].idx=i;
+        tot_load+=wtcalc_per_class[i];
+        if(scheduling_table[i]==SPLIT_CLASS)
+        {
+            for(int j=0;j<num_workers;j++)
+                load_w[j]+=wtcalc_per_class[i]/num_workers;
+        }
+        else if(scheduling_table[i]>0 && scheduling_table[i]-1<num_workers)
+            load_w[scheduling_table[i]-1]+=wtcalc_per_class[i];
+    }
+    //order classes by weight
+    qsort(v, num_classes, sizeof(pair_t), cmppair);
+
+    //classes of the removed workers (starting from the heavier one) go to the less loaded worker
+    for(int i=num_classes-1;i>=0;i--)
+    {
+        if(scheduling_table[v[i].idx]==SPLIT_CLASS || (scheduling_table[v[i].idx]>0 && scheduling_table[v[i].idx]-1<num_workers))
+            continue;
+        int min_w=0;
+        for(int j=1;j<num_workers;j++)
+            if(load_w[j]<load_w[min_w])
+                min_w=j;
+        if(scheduling_table[v[i].idx]>0) //a class never assigned has no state to move
+            moved++;
+        scheduling_table[v[i].idx]=min_w+1;
+        load_w[min_w]+=v[i].l;
+    }
+
+    //move classes from the donor (the most loaded) to the receiver (the less loaded) until the bound is respected.
+    //Each move reduces the sum of the squared loads, therefore this terminates
+    double bound=(1+max_imbalance)*tot_load/num_workers;
+    for(;;)
+    {
+        int max_w=0, min_w=0;
+        for(int j=1;j<num_workers;j++)
+        {
+            if(load_w[j]>load_w[max_w])
+                max_w=j;
+            if(load_w[j]<load_w[min_w])
+                min_w=j;
+        }
+        if(load_w[max_w]<=bound)
+            break;
+        double gap=load_w[max_w]-load_w[min_w];
+        int fit=-1, best=-1;
+        double best_gain=0;
+        //classes are ordered by weight: the first one that fits is the heaviest
+        for(int i=num_classes-1;i>=0;i--)
+        {
+            if(scheduling_table[v[i].idx]-1!=max_w || v[i].l<=0 || v[i].l>=gap)
+                continue;
+            if(fit<0 && load_w[min_w]+v[i].l<=bound)
+                fit=i;
+            //the maximum between the two new loads is reduced by min(l,gap-l)
+            double gain=(v[i].l<gap-v[i].l)?v[i].l:gap-v[i].l;
+            if(gain>best_gain)
+            {
+                best_gain=gain;
+                best=i;
+            }
+        }
+        if(fit>=0)
+            best=fit;
+        if(best<0)
+            break; //no class can reduce the imbalance
+        scheduling_table[v[best].idx]=min_w+1;
+        load_w[max_w]-=v[best].l;
+        load_w[min_w]+=v[best].l;
+        moved++;
+    }
+    delete[] load_w;
+    delete[] v;
+    return moved;
+}
+
+/**
+    Scheduling table for the consistent hashing routing (see consistent_hash.hpp): classes follow the hash
+    of their id, apart from the ones that the rebalancing (compute_st_incremental) had to move for keeping the
+    load within the imbalance bound. These become the new overrides, together with the previous ones
+    that are still valid.
+    @param num_workers the number of workers to which tuples have to be routed
+    @param num_classes
+    @param wtcalc_per_class: it contains for each class the product  class_frequency*tcalc_class, computed using the monitored data
+    @param overrides: for each class, the worker+1 to which it is explicitly assigned (0 if it follows the hash). It is updated
+    @param scheduling_table: the current scheduling table that will be modified
+    @param max_imbalance: maximum load of a worker with respect to the average one
+    @return the number of classes that have been moved to a different worker
+*/
+int compute_st_consistent(int num_workers, int num_classes,double* wtcalc_per_class, worker_id_t *overrides, worker_id_t *scheduling_table, double max_imbalance)
+{
+    worker_id_t *prev=new worker_id_t[num_classes];
+    memcpy(prev,scheduling_table,num_classes*sizeof(worker_id_t));
+    compute_st_hash(num_workers,num_classes,overrides,scheduling_table);
+    compute_st_incremental(num_workers,num_classes,wtcalc_per_class,scheduling_table,max_imbalance);
+    int moved=0;
+    for(int i=0;i<num_classes;i++)
+    {
+        //the classes that do not follow the hash (previous overrides or moved by the rebalancing)
+        overrides[i]=(scheduling_table[i]!=jump_consistent_hash(i,num_workers)+1)?scheduling_table[i]:0;
+        if(prev[i]>0 && scheduling_table[i]!=prev[i]) //a class never assigned (or just unsplit) has no state to move
+            moved++;
+    }
+    delete[] prev;
+    return moved;
+}
+
+/**
+    Split the classes whose load alone exceeds the bound of a worker (hot keys): moving them can not balance the load.
+    The panes of a split class are spread on all the workers (see pane.hpp).
+    A split class whose load has become not greater than the average one of a worker (or all of them, if there is only
+    one worker) is unsplit: it becomes unassigned, and it will be given to a worker by the rebalancing. The gap between
+    the two thresholds prevents a class from being continuously split and unsplit
+    @param num_workers the number of workers to which tuples have to be routed
+    @param num_classes
+    @param wtcalc_per_class: it contains for each class the product  class_frequency*tcalc_class, computed using the monitored data
+    @param scheduling_table: the current scheduling table that will be modified
+    @param max_imbalance: maximum load of a worker with respect to the average one
+    @return the number of classes that have been split or unsplit
+*/
+int split_hot_classes(int num_workers, int num_classes,double* wtcalc_per_class, worker_id_t *scheduling_table, double max_imbalance)
+{
+    double tot_load=0;
+    for(int i=0;i<num_classes;i++)
+        tot_load+=wtcalc_per_class[i];
+    double avg_load=tot_load/num_workers;
+    double bound=(1+max_imbalance)*avg_load;
+    int changed=0;
+    for(int i=0;i<num_classes;i++)
+    {
+        if(scheduling_table[i]==SPLIT_CLASS)
+        {
+            if(num_workers<2 || wtcalc_per_class[i]<=avg_load)
+            {
+                scheduling_table[i]=0;
+                changed++;
+            }
+        }
+        else if(num_workers>=2 && scheduling_table[i]>0 && wtcalc_per_class[i]>bound)
+        {
+            scheduling_table[i]=SPLIT_CLASS;
+            changed++;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,153 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Batched reception of fixed size records from a (TCP) socket
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef SOCKET_READER_HPP
+#define SOCKET_READER_HPP
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "general.h"
+
+#define SOCKET_READER_SIZE (1<<20)      //size (in bytes) of the reception buffer
+
+/**
+ * Records are received in bulk into a user space buffer: each recv takes all the data
+ * currently available in the socket (up to the free space in the buffer), therefore
+ * under load a single system call returns thousands of records. Records are then
+ * consumed one by one, directly from the buffer.
+ */
+class SocketReader{
+public:
+    /**
+     * @param socket the socket from which receive
+     * @param capacity size of the buffer (in bytes)
+     */
+    SocketReader(int socket, size_t capacity=SOCKET_READER_SIZE)
+    {
+        this->socket=socket;
+        this->capacity=capacity;
+        if(posix_memalign((void **)&buffer,CACHE_LINE_SIZE,capacity)!=0)
+        {
+            fprintf(stderr,"Error in allocating the reception buffer\n");
+            exit(-1);
+        }
+        head=0;
+        tail=0;
+    }
+
+    ~SocketReader()
+    {
+        free(buffer);
+    }
+
+    /**
+     * @brief next returns the next record
+     * @param len length of the record
+     * @return a pointer to the record (valid until the next call) or NULL in case of error or closed connection
+     */
+    inline const void *next(size_t len)
+    {
+        if(tail-head<len && !fill(len))
+            return NULL;
+        const void *ret=buffer+head;
+        head+=len;
+        return ret;
+    }
+
+    /**
+     * @brief receive copies the next record
+     * @return false in case of error or closed connection
+     */
+    inline bool receive(void *dst, size_t len)
+    {
+        const void *rec=next(len);
+        if(rec==NULL)
+            return false;
+        memcpy(dst,rec,len);
+        return true;
+    }
+
+    /**
+     * @brief peek returns a record already received, without consuming anything
+     * @param len length of the record
+     * @param ahead position of the record, starting from the next one (0)
+     * @return a pointer to the record or NULL if it has not been received yet
+     */
+    inline const void *peek(size_t len, int ahead) const
+    {
+        size_t off=head+ahead*len;
+        if(off+len>tail)
+            return NULL;
+        return buffer+off;
+    }
+
+    /**
+     * @brief buffered returns the number of bytes that have been received from the socket but not yet consumed
+     */
+    inline size_t buffered() const
+    {
+        return tail-head;
+    }
+
+private:
+
+    /**
+     * Receive from the socket until at least len bytes are available
+     */
+    bool fill(size_t len)
+    {
+        //move the residual (partial record) at the beginning of the buffer
+        if(head>0)
+        {
+            memmove(buffer,buffer+head,tail-head);
+            tail-=head;
+            head=0;
+        }
+        while(tail<len)
+        {
+            ssize_t received=recv(socket,buffer+tail,capacity-tail,0);
+            if(received<=0)
+            {
+                if(received<0)
+                    perror("Error recv() call");
+                return false;
+            }
+            tail+=received;
+        }
+        return true;
+    }
+
+    int socket;
+    char *buffer;
+    size_t capacity;
+    size_t head;        //next byte to consume
+    size_t tail;        //next byte to receive
+};
+
+#endif // SOCKET_READER_HPP
@@ -27,6 +27,8 @@
 #define STATISTICS_HPP
 
 #include <vector>
+#include <stdint.h>
+#include <string.h>
 #include <mammut/cpufreq/cpufreq.hpp>
 #include <mammut/energy/energy.hpp>
 #include "general.h"
@@ -44,16 +46,21 @@ public:
     ReconfigurationStatistics()
     {
         _times=new vector<double>();
-        _par_degrees=new vector<char>();
+        _par_degrees=new vector<int>();
         _frequencies=new vector<mammut::cpufreq::Frequency>();
         _joules_core=new vector<double>();
         _joules_cpu=new vector<double>();
+        _solve_usecs=new vector<double>();
+        _forecast_ape=new vector<double>();
+        _moved_classes=new vector<int>();
         _tot_reconf=0;
         _reconf_par_degree=0;
         _reconf_freq=0;
         _tot_joules_core=0;
         _tot_joules_cpu=0;
         _num_class_rebalancing=0;
+        _solve_over_budget=0;
+        _tot_moved_classes=0;
 
         //reserve some space
         _times->reserve(_reserved_space);
@@ -61,14 +68,20 @@ public:
         _frequencies->reserve(_reserved_space);
         _joules_core->reserve(_reserved_space);
         _joules_cpu->reserve(_reserved_space);
+        _solve_usecs->reserve(_reserved_space);
+        _forecast_ape->reserve(_reserved_space);
+        _moved_classes->reserve(_reserved_space);
 
     }
 
-    void addStats(double time, char par_degree,mammut::cpufreq::Frequency freq)
+    void addStats(double time, int par_degree,mammut::cpufreq::Frequency freq)
     {
         _times->push_back(time);
         _par_degrees->push_back(par_degree);
         _frequencies->push_back(freq);
+        _solve_usecs->push_back(0);
+        _forecast_ape->push_back(-1);
+        _moved_classes->push_back(0);
 
         if(_times->size()>1)
         {
@@ -107,6 +120,37 @@ public:
         _tot_joules_cpu+=joule_cpu;
     }
 
+    /**
+     * @brief addSolveStats takes note of the time spent in the strategy resolution (to be called after addStats)
+     * @param usecs resolution time
+     * @param completed false if the time budget expired before finding the optimal solution
+     */
+    void addSolveStats(double usecs, bool completed)
+    {
+        _solve_usecs->back()=usecs;
+        if(!completed)
+            _solve_over_budget++;
+    }
+
+    /**
+     * @brief addForecastStats takes note of the error of the arrival rate forecasted for the current step (to be called after addStats)
+     * @param ape absolute percentage error
+     */
+    void addForecastStats(double ape)
+    {
+        _forecast_ape->back()=ape;
+    }
+
+    /**
+     * @brief addMigrationStats takes note of the classes (keys) moved to a different replica in the current step (to be called after addStats)
+     * @param moved number of moved classes
+     */
+    void addMigrationStats(int moved)
+    {
+        _moved_classes->back()+=moved;
+        _tot_moved_classes+=moved;
+    }
+
     void writeToFile(char *name)
     {
         FILE *fpar=fopen(name,"w");
@@ -130,7 +174,7 @@ public:
         return _times->at(i);
     }
 
-    char getParDegree(int i)
+    int getParDegree(int i)
     {
         return _par_degrees->at(i);
     }
@@ -155,6 +199,24 @@ public:
         return _joules_cpu->at(i);
     }
 
+    double getSolveTime(int i)
+    {
+        return _solve_usecs->at(i);
+    }
+
+    /**
+     * @brief getForecastError returns the absolute percentage error of the forecast for step i (-1 if not available)
+     */
+    double getForecastError(int i)
+    {
+        return _forecast_ape->at(i);
+    }
+
+    int getMovedClasses(int i)
+    {
+        return _moved_classes->at(i);
+    }
+
     //get total counts
 
     int getTotReconf()
@@ -182,26 +244,77 @@ public:
         return _tot_joules_cpu;
     }
 
+    long getTotMovedClasses()
+    {
+        return _tot_moved_classes;
+    }
+
+    double getAvgSolveTime()
+    {
+        double sum=0;
+        for(double t:*_solve_usecs)
+            sum+=t;
+        return _solve_usecs->empty()?0:sum/_solve_usecs->size();
+    }
+
+    double getMaxSolveTime()
+    {
+        double max=0;
+        for(double t:*_solve_usecs)
+            if(t>max)
+                max=t;
+        return max;
+    }
+
+    int getSolveOverBudget()
+    {
+        return _solve_over_budget;
+    }
+
+    /**
+     * @brief getMAPE returns the mean absolute percentage error of the forecasts
+     */
+    double getMAPE()
+    {
+        double sum=0;
+        int n=0;
+        for(double e:*_forecast_ape)
+            if(e>=0)
+            {
+                sum+=e;
+                n++;
+            }
+        return (n>0)?sum/n:0;
+    }
+
     ~ReconfigurationStatistics()
     {
         delete _times;
         delete _par_degrees;
         delete _frequencies;
+        delete _solve_usecs;
+        delete _forecast_ape;
+        delete _moved_classes;
     }
 
 private:
     const int _reserved_space=300;
     vector<double> *_times;                                 //the time (in ticks) to which the statiscs refer
-    vector<char> *_par_degrees;                             //for each time (in _times) it contains the par degree
+    vector<int> *_par_degrees;                              //for each time (in _times) it contains the par degree
     vector<mammut::cpufreq::Frequency> *_frequencies;       //the frequencies
     vector<double> *_joules_core;                           //the joules consumed by incore components
     vector<double> *_joules_cpu;                            //the joules consumed by the whole cpu
+    vector<double> *_solve_usecs;                           //time spent in the strategy resolution (usecs)
+    vector<double> *_forecast_ape;                          //absolute percentage error of the forecasted arrival rate
+    vector<int> *_moved_classes;                            //classes moved to a different replica in each step
     int _tot_reconf;                                        //total number of reconfiguration
     int _reconf_par_degree;                                 //number of reconfiguration that regards the par degree
     int _reconf_freq;                                       //number of reconfiguration that regads the frequency only
     double _tot_joules_cpu;                                 //the sum for each step
     double _tot_joules_core;                                //the sum for each step
     int _num_class_rebalancing;                             //the number of control step that require a class rebalancing (i.e. the configuration is the same but we rebalance between workers)
+    int _solve_over_budget;                                 //number of resolutions interrupted by the time budget
+    long _tot_moved_classes;                                //total number of classes moved (i.e. state migrations)
 };
 
 
@@ -410,6 +523,147 @@ private:
 };
 
 
+#define LATHIST_SUB_BITS 8                  //the relative error on percentiles is at most 2^-LATHIST_SUB_BITS (0.4%)
+#define LATHIST_MAX_BITS 40                 //latencies up to 2^LATHIST_MAX_BITS usecs are distinguished
+
+/**
+ * @brief The LatencyHistogram class keeps the distribution of latencies (usecs) in a fixed
+ * amount of memory, with log-linear buckets (as in HdrHistogram).
+ * Values below 2^LATHIST_SUB_BITS have a bucket each; above, each power of two is divided
+ * into 2^(LATHIST_SUB_BITS-1) buckets. Recording costs O(1), a percentile O(number of buckets)
+ * regardless of the number of recorded values.
+ * Histograms can be merged, e.g. to obtain the distribution of the whole run from the per-second ones.
+ */
+class LatencyHistogram{
+public:
+    LatencyHistogram()
+    {
+        _counts=new uint64_t[NUM_BUCKETS]();
+        _count=0;
+        _max=0;
+    }
+
+    LatencyHistogram(const LatencyHistogram &o)
+    {
+        _counts=new uint64_t[NUM_BUCKETS];
+        memcpy(_counts,o._counts,NUM_BUCKETS*sizeof(uint64_t));
+        _count=o._count;
+        _max=o._max;
+    }
+
+    LatencyHistogram &operator=(const LatencyHistogram &o)
+    {
+        memcpy(_counts,o._counts,NUM_BUCKETS*sizeof(uint64_t));
+        _count=o._count;
+        _max=o._max;
+        return *this;
+    }
+
+    ~LatencyHistogram()
+    {
+        delete[] _counts;
+    }
+
+    /**
+     * @brief record records a latency (negative values are recorded as zero)
+     */
+    inline void record(double lat)
+    {
+        uint64_t v=(lat>0)?(uint64_t)lat:0;
+        _counts[bucket(v)]++;
+        _count++;
+        if(lat>_max)
+            _max=lat;
+    }
+
+    /**
+     * @brief merge adds the values recorded by another histogram
+     */
+    void merge(const LatencyHistogram &o)
+    {
+        for(int i=0;i<NUM_BUCKETS;i++)
+            _counts[i]+=o._counts[i];
+        _count+=o._count;
+        if(o._max>_max)
+            _max=o._max;
+    }
+
+    void clear()
+    {
+        memset(_counts,0,NUM_BUCKETS*sizeof(uint64_t));
+        _count=0;
+        _max=0;
+    }
+
+    /**
+     * @brief percentile returns the value below which there is (at least) the given fraction of the recorded values
+     * @param p fraction, in [0,1]
+     */
+    double percentile(double p) const
+    {
+        if(_count==0)
+            return 0;
+        //as taking the element p*count of the sorted values
+        uint64_t rank=(uint64_t)(p*_count)+1;
+        if(rank>_count)
+            rank=_count;
+        uint64_t seen=0;
+        for(int i=0;i<NUM_BUCKETS;i++)
+        {
+            seen+=_counts[i];
+            if(seen>=rank)
+            {
+                double v=middle(i);
+                return (v<_max)?v:_max;
+            }
+        }
+        return _max;
+    }
+
+    /**
+     * @brief max returns the highest recorded value (exact)
+     */
+    inline double max() const
+    {
+        return _max;
+    }
+
+    inline uint64_t count() const
+    {
+        return _count;
+    }
+
+private:
+    static const int SUB_BUCKETS=1<<LATHIST_SUB_BITS;
+    static const int HALF_BUCKETS=SUB_BUCKETS/2;
+    static const int NUM_BUCKETS=(LATHIST_MAX_BITS-LATHIST_SUB_BITS+2)*HALF_BUCKETS;
+
+    static inline int bucket(uint64_t v)
+    {
+        if(v<(uint64_t)SUB_BUCKETS)
+            return (int)v;
+        int shift=63-__builtin_clzll(v)-(LATHIST_SUB_BITS-1);
+        int b=shift*HALF_BUCKETS+(int)(v>>shift);
+        return (b<NUM_BUCKETS)?b:NUM_BUCKETS-1;
+    }
+
+    /**
+     * Value in the middle of a bucket
+     */
+    static inline double middle(int b)
+    {
+        if(b<SUB_BUCKETS)
+            return b;
+        int shift=b/HALF_BUCKETS-1;
+        uint64_t low=((uint64_t)(b-shift*HALF_BUCKETS))<<shift;
+        return low+((1ULL<<shift)-1)/2.0;
+    }
+
+    uint64_t *_counts;
+    uint64_t _count;
+    double _max;
+};
+
 /**
     The copyright of the code of RunningStat is due to John D. Cook
     source http://www.johndcook.com/blog/standard_deviation/
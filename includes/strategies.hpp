@@ -30,6 +30,7 @@
 #include <mammut/cpufreq/cpufreq.hpp>
 #include <limits>
 #include "strategy_descriptor.hpp"
+#include "general.h"
 #include <climits>
 
 #define MAX_RHO_MODULE 0.95 //the maximum rho that the module can have before being considered bottleneck
@@ -47,8 +48,12 @@ typedef struct{
 	The predict_* functions are simpler wrapper to them.
 */
 void resolve_strategy_rt(int h, int step, int max_par_degree, int *reconf_vector, double* forecasted, double tcalc,double rt_threshold, double c_arr, double c_serv, double ksf,double alpha, double beta,double gamma, int curr_par_degree,int *result, double *min,double *exp_rt, double *kingman);
+bool resolve_strategy_rt_dp(int h, int max_par_degree, double* forecasted, double tcalc,double rt_threshold, double c_arr, double c_serv, double ksf,double alpha, double beta,double gamma, int curr_par_degree,int *result, double *min,double *exp_rt, double *kingman, long deadline_nsecs=0);
+double evaluate_trajectory_rt(int h, const int *trajectory, double* forecasted, double tcalc,double rt_threshold, double c_arr, double c_serv, double ksf,double alpha, double beta,double gamma, int curr_par_degree,double *exp_rt, double *kingman);
 void resolve_strategy_energy_rt(int h, int step, int max_par_degree, vector<mammut::cpufreq::Frequency> available_frequencies, map<pair<int,int>,double> *voltages, reconf_choice_energy_t *reconf_vector, double* forecasted, double tcalc,double rt_threshold, double c_arr, double c_serv, double ksf,double alpha, double beta,double gamma, int curr_par_degree,mammut::cpufreq::Frequency curr_frequency,reconf_choice_energy_t *result, double *min,double *exp_rt, double *kingman);
 void resolve_strategy_energy_rt_bb(int h, int step, double part_obj_funct, double first_rt, double first_king, int max_par_degree, vector<mammut::cpufreq::Frequency> available_frequencies, map<pair<int,int>,double> *voltages, reconf_choice_energy_t *reconf_vector, double* forecasted, double tcalc, double rt_threshold, double c_arr, double c_serv, double ksf, double alpha, double beta, double gamma, int curr_par_degree, mammut::cpufreq::Frequency curr_frequency, reconf_choice_energy_t *result, double *min, double *exp_rt, double *kingman/*, int &solutions_explored*/);
+bool resolve_strategy_energy_rt_dp(int h, int max_par_degree, const vector<mammut::cpufreq::Frequency> &available_frequencies, map<pair<int,int>,double> *voltages, double* forecasted, double tcalc, double rt_threshold, double c_arr, double c_serv, double ksf, double alpha, double beta, double gamma, int curr_par_degree, mammut::cpufreq::Frequency curr_frequency, reconf_choice_energy_t *result, double *min, double *exp_rt, double *kingman, long deadline_nsecs=0);
+double evaluate_trajectory_energy_rt(int h, const reconf_choice_energy_t *trajectory, const vector<mammut::cpufreq::Frequency> &available_frequencies, map<pair<int,int>,double> *voltages, double* forecasted, double tcalc, double rt_threshold, double c_arr, double c_serv, double ksf, double alpha, double beta, double gamma, int curr_par_degree, mammut::cpufreq::Frequency curr_frequency, double *exp_rt, double *kingman);
 
 // TODO: sistemare qua dentro prima di fare i test definitivi(credo si tratti semplicemente di commentare per bene, il core è identico)
 
@@ -83,27 +88,61 @@ void resolve_strategy_energy_rt_bb(int h, int step, double part_obj_funct, doubl
 	@param result pointer to a vector in which will be stored the h reconfiguration choices computed (i.e. the following par degree and frequencies)
 	@param exp_rt pointer to a double in which will be stored the expected response time for the next step (after reconfigurations have been applied)
 	@param kingman pointer to a double in which will be stored the response time forecasted with kingman (therefore not scaled)
+    @return true if the optimal trajectory has been found within the time budget (sd->solve_budget_usecs). Otherwise
+        result contains the best one among the trajectory of the previous control step (shifted by one step), keeping the current
+        configuration and using all the resources
 
 */
 
-void predict_reconf_energy_rt(StrategyDescriptor *sd, int max_par_degree,vector<mammut::cpufreq::Frequency> available_frequencies,map<pair<int,int>,double> *voltages,int curr_par_degree,mammut::cpufreq::Frequency curr_frequency, double *forecasted,double tcalc, double c_arr, double c_serv, double ksf, reconf_choice_energy_t *result, double *exp_rt, double *kingman)
+bool predict_reconf_energy_rt(StrategyDescriptor *sd, int max_par_degree,vector<mammut::cpufreq::Frequency> available_frequencies,map<pair<int,int>,double> *voltages,int curr_par_degree,mammut::cpufreq::Frequency curr_frequency, double *forecasted,double tcalc, double c_arr, double c_serv, double ksf, reconf_choice_energy_t *result, double *exp_rt, double *kingman)
 {
 
 	double min=INT_MAX;
-	//needed for calculation purposes (it describes the various combination of the reconfiguration vector)
-    reconf_choice_energy_t *reconf_vector=new reconf_choice_energy_t[sd->horizon]();
     //This was used for testing the space of solution exploration
     //int solutions_explored=0;
     // resolve_strategy_energy_rt(h,0,max_par_degree,available_frequencies,voltages, reconf_vector,forecasted,tcalc, rt_threshold, c_arr, c_serv, ksf, alpha,beta,gamma,curr_par_degree,curr_frequency,result,&min,exp_rt,kingman);
-    resolve_strategy_energy_rt_bb(sd->horizon,0,0,0,0,max_par_degree,available_frequencies,voltages, reconf_vector,forecasted,tcalc, sd->threshold, c_arr, c_serv, ksf, sd->alpha,sd->beta,sd->gamma,curr_par_degree,curr_frequency,result,&min,exp_rt,kingman/*,solutions_explored*/);
+    //the branch and bound (resolve_strategy_energy_rt_bb) finds the same trajectory, but its cost depends on the pruning
+    long deadline=(sd->solve_budget_usecs>0)?current_time_nsecs()+sd->solve_budget_usecs*1000L:0;
+    if(resolve_strategy_energy_rt_dp(sd->horizon,max_par_degree,available_frequencies,voltages,forecasted,tcalc, sd->threshold, c_arr, c_serv, ksf, sd->alpha,sd->beta,sd->gamma,curr_par_degree,curr_frequency,result,&min,exp_rt,kingman,deadline))
+        return true;
+    //time budget expired: result still contains the trajectory of the previous step
+    int h=sd->horizon;
+    reconf_choice_energy_t *candidates=new reconf_choice_energy_t[3*h];
+    for(int j=0;j<h;j++)
+    {
+        candidates[j]=result[MIN(j+1,h-1)];
+        candidates[h+j].nw=curr_par_degree;
+        candidates[h+j].freq=curr_frequency;
+        candidates[2*h+j].nw=max_par_degree;
+        candidates[2*h+j].freq=available_frequencies.back();
+    }
+    //at the first step there is not a previous trajectory
+    int first=(result[0].nw>=1 && result[0].nw<=max_par_degree)?0:1;
+    int best=2;
+    for(int c=first;c<3;c++)
+    {
+        double rt, king;
+        double obj=evaluate_trajectory_energy_rt(h,&candidates[c*h],available_frequencies,voltages,forecasted,tcalc,sd->threshold,c_arr,c_serv,ksf,sd->alpha,sd->beta,sd->gamma,curr_par_degree,curr_frequency,&rt,&king);
+        if(obj<min)
+        {
+            min=obj;
+            best=c;
+            *exp_rt=rt;
+            *kingman=king;
+        }
+    }
+    if(min==INT_MAX)
+        evaluate_trajectory_energy_rt(h,&candidates[2*h],available_frequencies,voltages,forecasted,tcalc,sd->threshold,c_arr,c_serv,ksf,sd->alpha,sd->beta,sd->gamma,curr_par_degree,curr_frequency,exp_rt,kingman);
+    for(int j=0;j<h;j++)
+        result[j]=candidates[best*h+j];
+    delete[] candidates;
 	//printf("Current Frequency: %d Minimum of the objective function: %f\n",curr_frequency,min);
     /*printf("RT-EN: Punto di partenza [%d,%d]. Parameters: %.2f, %.2f, %.2f. Reconf_vector: ", curr_par_degree, (int)curr_frequency,sd->alpha,sd->beta,sd->gamma);
     for(int j=0;j<sd->horizon;j++)
 		printf("[%d %d]",result[j].nw,(int)result[j].freq);
     printf("\n");*/
    // fprintf(stderr,"%d\n",solutions_explored);
-    delete[] reconf_vector;
-
+    return false;
 }
 
 
@@ -237,6 +276,235 @@ void resolve_strategy_energy_rt_bb(int h, int step, double part_obj_funct, doubl
 
 
 
+/**
+    Strategy resolution for response time and power with dynamic programming over the lattice
+    of the states (par. degree, frequency).
+    The cost of a state in a step (expected response time and power) does not depend on the other steps,
+    while the switching cost depends only on two consecutive states. Therefore the cost of every state
+    is computed once per step (the voltages are taken from the map once per call) and the optimal
+    trajectory is found backward: value[j][s] is the minimum cost of the steps j,...,h-1 given that
+    at step j the state is s. With S=max_par_degree*#frequencies states, the resolution always
+    costs O(h*S^2), independently of the data (the branch and bound may explore up to S^h trajectories).
+
+    The returned trajectory is the same of resolve_strategy_energy_rt_bb: the states with rho>=1 are
+    not admitted and among the optimal trajectories it is returned the first one explored by the
+    branch and bound (increasing par. degree, decreasing frequency). The value stored in min
+    is computed with the same operations of the branch and bound: it may still differ in the last bits,
+    if the compiler contracts them differently (e.g. with FMA).
+    Parameters are the same of resolve_strategy_energy_rt_bb (min must be initialized by the caller)
+    @param deadline_nsecs if not zero, the resolution is abandoned when current_time_nsecs() exceeds it
+    @return false if the resolution has been abandoned (nothing is modified)
+*/
+bool resolve_strategy_energy_rt_dp(int h, int max_par_degree, const vector<mammut::cpufreq::Frequency> &available_frequencies, map<pair<int,int>,double> *voltages, double* forecasted, double tcalc, double rt_threshold, double c_arr, double c_serv, double ksf, double alpha, double beta, double gamma, int curr_par_degree, mammut::cpufreq::Frequency curr_frequency, reconf_choice_energy_t *result, double *min, double *exp_rt, double *kingman, long deadline_nsecs)
+{
+    const int num_freq=available_frequencies.size();
+    const int num_states=max_par_degree*num_freq;
+    if(num_states==0)
+        return true;
+    const double inf=std::numeric_limits<double>::infinity();
+    double minFreqGHZ=available_frequencies.front()/1000000.0;
+    //states are enumerated as in the branch and bound: state s has par. degree s/num_freq+1
+    //and frequency available_frequencies[num_freq-1-s%num_freq]
+    int *state_nw=new int[num_states];
+    double *state_nw_d=new double[num_states];
+    mammut::cpufreq::Frequency *state_freq=new mammut::cpufreq::Frequency[num_states];
+    double *state_freq_scaled=new double[num_states];    //as used in the switching cost
+    double *state_power=new double[num_states];          //beta factor, without beta
+    for(int s=0;s<num_states;s++)
+    {
+        state_nw[s]=s/num_freq+1;
+        state_nw_d[s]=state_nw[s];
+        state_freq[s]=available_frequencies[num_freq-1-s%num_freq];
+        state_freq_scaled[s]=(state_freq[s]/1000000.0-minFreqGHZ)*10;
+        //+4 since there are 4 additional thread but the enumeration start from zero
+        map<pair<int,int>,double>::iterator it=voltages->find(make_pair(state_nw[s]+4,(int)state_freq[s]));
+        double voltage=(it!=voltages->end())?it->second:0;
+        state_power[s]=voltage*voltage*state_freq[s]/1000000.0*(state_nw[s]+3);
+    }
+
+    //cost of each state in each step (infinity if it is not admitted) and its response time part
+    double *step_cost=new double[h*num_states];
+    double *rt_cost=new double[h*num_states];
+    double *rt_first=new double[num_states];
+    double *king_first=new double[num_states];
+    for(int j=0;j<h;j++)
+    {
+        for(int s=0;s<num_states;s++)
+        {
+            double rho=((tcalc*curr_frequency/(double)state_freq[s])/(double)state_nw[s])/(MAX_RHO_MODULE/(double)forecasted[j]);
+            if(rho>=1)
+            {
+                step_cost[j*num_states+s]=inf;
+                rt_cost[j*num_states+s]=inf;
+                continue;
+            }
+            double kingman_prev=((rho/(1-rho))*((c_arr*c_arr+c_serv*c_serv)/2)*(tcalc*curr_frequency/(double)state_freq[s])/(double)state_nw[s]);
+            double resp_time=(tcalc*curr_frequency)/(double)state_freq[s]+kingman_prev*ksf;
+            double ratio=((double)resp_time)/rt_threshold;
+            rt_cost[j*num_states+s]=(ratio>100)?INT_MAX:alpha*exp(ratio);
+            step_cost[j*num_states+s]=rt_cost[j*num_states+s]+beta*state_power[s];
+            if(j==0)
+            {
+                rt_first[s]=resp_time;
+                king_first[s]=kingman_prev;
+            }
+        }
+    }
+
+    //value[j*num_states+s]: minimum cost of steps j,...,h-1 with state s at step j
+    //next[j*num_states+s]: the state at step j+1 that achieves it
+    double *value=new double[h*num_states];
+    int *next=new int[h*num_states];
+    //cost of the transitions toward the next step (computed apart, so that the loop is vectorized)
+    double *cand=new double[num_states];
+    bool expired=false;
+    for(int s=0;s<num_states;s++)
+        value[(h-1)*num_states+s]=step_cost[(h-1)*num_states+s];
+    for(int j=h-2;j>=0 && !expired;j--)
+    {
+        const double *value_next=&value[(j+1)*num_states];
+        for(int s=0;s<num_states && !expired;s++)
+        {
+            double best=inf;
+            int best_t=-1;
+            if(step_cost[j*num_states+s]<inf)
+            {
+                const double nw_s=state_nw_d[s], f_s=state_freq_scaled[s];
+                for(int t=0;t<num_states;t++)
+                {
+                    double dn=state_nw_d[t]-nw_s;
+                    double df=state_freq_scaled[t]-f_s;
+                    cand[t]=gamma*(dn*dn+df*df)+value_next[t];
+                }
+                for(int t=0;t<num_states;t++)
+                {
+                    if(cand[t]<best) //ties: the first one explored
+                    {
+                        best=cand[t];
+                        best_t=t;
+                    }
+                }
+            }
+            value[j*num_states+s]=step_cost[j*num_states+s]+best;
+            next[j*num_states+s]=best_t;
+            //a row costs O(S): check the budget every few ones
+            if((s&7)==7)
+                expired=deadline_nsecs>0 && current_time_nsecs()>deadline_nsecs;
+        }
+    }
+    delete[] cand;
+
+    //first step: switching cost from the current configuration
+    double curr_f=(curr_frequency/1000000.0-minFreqGHZ)*10;
+    double best=inf;
+    int first=-1;
+    for(int s=0;s<num_states && !expired;s++)
+    {
+        double dn=curr_par_degree-state_nw[s];
+        double df=curr_f-state_freq_scaled[s];
+        double v=gamma*(dn*dn+df*df)+value[s];
+        if(v<best)
+        {
+            best=v;
+            first=s;
+        }
+    }
+
+    if(first>=0)
+    {
+        //evaluate the objective function of the trajectory with the same operations of the branch and bound
+        double obj_funct=0;
+        int prev=-1;
+        for(int j=0,s=first;j<h;j++)
+        {
+            obj_funct+=rt_cost[j*num_states+s];
+            obj_funct+=beta*state_power[s];
+            double norm2;
+            if(j==0)
+            {
+                norm2=(curr_par_degree-state_nw[s])*(curr_par_degree-state_nw[s]);
+                norm2+=(curr_f-state_freq_scaled[s])*(curr_f-state_freq_scaled[s]);
+            }
+            else
+            {
+                norm2=(state_nw[s]-state_nw[prev])*(state_nw[s]-state_nw[prev]);
+                norm2+=(state_freq_scaled[s]-state_freq_scaled[prev])*(state_freq_scaled[s]-state_freq_scaled[prev]);
+            }
+            obj_funct+=gamma*(norm2);
+            prev=s;
+            s=(j<h-1)?next[j*num_states+s]:s;
+        }
+        if(obj_funct<*min)
+        {
+            *min=obj_funct;
+            for(int j=0,s=first;j<h;j++)
+            {
+                result[j].nw=state_nw[s];
+                result[j].freq=state_freq[s];
+                if(j<h-1)
+                    s=next[j*num_states+s];
+            }
+            *exp_rt=rt_first[first];
+            *kingman=king_first[first];
+        }
+    }
+    delete[] state_nw;
+    delete[] state_nw_d;
+    delete[] state_freq;
+    delete[] state_freq_scaled;
+    delete[] state_power;
+    delete[] step_cost;
+    delete[] rt_cost;
+    delete[] rt_first;
+    delete[] king_first;
+    delete[] value;
+    delete[] next;
+    return !expired;
+}
+
+/**
+    Evaluates the objective function of resolve_strategy_energy_rt_bb for a given trajectory (e.g. the one
+    used if the resolution does not complete within the time budget)
+    @param trajectory the h reconfiguration choices
+    @param exp_rt, kingman the expected response time and waiting time for the first step
+    @return the value of the objective function (infinity if some choice has rho>=1)
+*/
+double evaluate_trajectory_energy_rt(int h, const reconf_choice_energy_t *trajectory, const vector<mammut::cpufreq::Frequency> &available_frequencies, map<pair<int,int>,double> *voltages, double* forecasted, double tcalc, double rt_threshold, double c_arr, double c_serv, double ksf, double alpha, double beta, double gamma, int curr_par_degree, mammut::cpufreq::Frequency curr_frequency, double *exp_rt, double *kingman)
+{
+    double minFreqGHZ=available_frequencies.front()/1000000.0;
+    double obj_funct=0;
+    for(int j=0;j<h;j++)
+    {
+        double rho=((tcalc*curr_frequency/(double)trajectory[j].freq)/(double)trajectory[j].nw)/(MAX_RHO_MODULE/(double)forecasted[j]);
+        if(rho>=1)
+            return std::numeric_limits<double>::infinity();
+        double kingman_prev=((rho/(1-rho))*((c_arr*c_arr+c_serv*c_serv)/2)*(tcalc*curr_frequency/(double)trajectory[j].freq)/(double)trajectory[j].nw);
+        double resp_time=(tcalc*curr_frequency)/(double)trajectory[j].freq+kingman_prev*ksf;
+        double ratio=((double)resp_time)/rt_threshold;
+        if(ratio>100)
+            obj_funct+=INT_MAX;
+        else
+            obj_funct+=alpha*exp(ratio);
+        map<pair<int,int>,double>::iterator it=voltages->find(make_pair(trajectory[j].nw+4,(int)trajectory[j].freq));
+        double voltage=(it!=voltages->end())?it->second:0;
+        obj_funct+=beta*(voltage*voltage*trajectory[j].freq/1000000.0*(trajectory[j].nw+3));
+        int prev_nw=(j==0)?curr_par_degree:trajectory[j-1].nw;
+        double prev_f=(j==0)?curr_frequency:trajectory[j-1].freq;
+        double norm2=(prev_nw-trajectory[j].nw)*(prev_nw-trajectory[j].nw);
+        double f_prev=(prev_f/1000000.0-minFreqGHZ)*10;
+        double f_curr=(trajectory[j].freq/1000000.0-minFreqGHZ)*10;
+        norm2+=(f_prev-f_curr)*(f_prev-f_curr);
+        obj_funct+=gamma*(norm2);
+        if(j==0)
+        {
+            *exp_rt=resp_time;
+            *kingman=kingman_prev;
+        }
+    }
+    return obj_funct;
+}
+
+
 /**
 	Strategy prediction  that take into account the average response time. This has to be kept
 	below a given threshold. 
@@ -256,23 +524,53 @@ void resolve_strategy_energy_rt_bb(int h, int step, double part_obj_funct, doubl
 	@param result pointer to a vector in which will be stored the h reconfiguration choices computed (i.e. the following par degree)
 	@param exp_rt pointer to a double in which will be stored the expected response time for the next step (after reconfigurations have been applied)
 	@param kingam pointer to a double in which will be stored the response time forecasted with kingman (therefore not scaled)
+    @return true if the optimal trajectory has been found within the time budget (as for predict_reconf_energy_rt)
 
 */
 //consider also the expect response time computed considering the first step of reconfiguration
-void predict_reconf_rt(StrategyDescriptor *sd, int max_par_degree,int curr_par_degree,double *forecasted,double tcalc, double c_arr, double c_serv, double ksf, int *result, double *exp_rt, double *kingman)
+bool predict_reconf_rt(StrategyDescriptor *sd, int max_par_degree,int curr_par_degree,double *forecasted,double tcalc, double c_arr, double c_serv, double ksf, int *result, double *exp_rt, double *kingman)
 {
 
     double min=INT_MAX;
-    //needed for calculation purposes (it describes the various combination of the reconfiguration vector)
-    int *reconf_vector=new int[sd->horizon]();
 	//eventualmente lo si pesa
-    resolve_strategy_rt(sd->horizon,0,max_par_degree,reconf_vector,forecasted,tcalc, sd->threshold, c_arr, c_serv, ksf, sd->alpha,sd->beta,sd->gamma,curr_par_degree,result,&min,exp_rt,kingman);
+    //(resolve_strategy_rt finds the same trajectory by enumerating all of them)
+    long deadline=(sd->solve_budget_usecs>0)?current_time_nsecs()+sd->solve_budget_usecs*1000L:0;
+    if(resolve_strategy_rt_dp(sd->horizon,max_par_degree,forecasted,tcalc, sd->threshold, c_arr, c_serv, ksf, sd->alpha,sd->beta,sd->gamma,curr_par_degree,result,&min,exp_rt,kingman,deadline))
+        return true;
+    //time budget expired: previous trajectory shifted by one step, current par degree or maximum one
+    int h=sd->horizon;
+    int *candidates=new int[3*h];
+    for(int j=0;j<h;j++)
+    {
+        candidates[j]=result[MIN(j+1,h-1)];
+        candidates[h+j]=curr_par_degree;
+        candidates[2*h+j]=max_par_degree;
+    }
+    int first=(result[0]>=1 && result[0]<=max_par_degree)?0:1;
+    int best=2;
+    for(int c=first;c<3;c++)
+    {
+        double rt, king;
+        double obj=evaluate_trajectory_rt(h,&candidates[c*h],forecasted,tcalc,sd->threshold,c_arr,c_serv,ksf,sd->alpha,sd->beta,sd->gamma,curr_par_degree,&rt,&king);
+        if(obj<min)
+        {
+            min=obj;
+            best=c;
+            *exp_rt=rt;
+            *kingman=king;
+        }
+    }
+    if(min==INT_MAX)
+        evaluate_trajectory_rt(h,&candidates[2*h],forecasted,tcalc,sd->threshold,c_arr,c_serv,ksf,sd->alpha,sd->beta,sd->gamma,curr_par_degree,exp_rt,kingman);
+    for(int j=0;j<h;j++)
+        result[j]=candidates[best*h+j];
+    delete[] candidates;
     /*printf("RT threshold=%.1f: Parameters: %.2f, %.2f, %.2f. Minimum of the objective function: %f Forecasted resp_time: %f (Expected according kingman %.3f)\n",sd->threshold,sd->alpha,sd->beta,sd->gamma,min,*exp_rt,*kingman);
 	printf("reconf_vector: ");
     for(int j=0;j<sd->horizon;j++)
 		printf("%d ",result[j]);
     printf("\n");*/
-    delete[] reconf_vector;
+    return false;
 }
 
 
@@ -399,6 +697,179 @@ void resolve_strategy_rt(int h, int step, int max_par_degree, int *reconf_vector
 }
 
 
+/**
+    Strategy resolution for response time with dynamic programming.
+    The objective function evaluated by resolve_strategy_rt is the sum of a cost for each step
+    of the horizon, that depends only on the parallelism degree of that step (expected response time
+    and resources), and of a switching cost between consecutive steps (gamma factor).
+    Therefore, going backward from the last step, value[j][n] is the minimum cost of steps j,...,h-1
+    given that at step j the parallelism degree is n: it costs O(h*max_par_degree^2) instead of
+    O(h*max_par_degree^h) of the exhaustive search.
+
+    The returned trajectory is the same of resolve_strategy_rt: among the optimal trajectories,
+    the one that comes last in the enumeration order (at each step the greatest parallelism degree).
+    Parameters are the same of resolve_strategy_rt, min must be initialized by the caller (the result
+    is not modified if no trajectory costs less than or equal to it)
+    @param deadline_nsecs if not zero, the resolution is abandoned when current_time_nsecs() exceeds it
+    @return false if the resolution has been abandoned (nothing is modified)
+*/
+bool resolve_strategy_rt_dp(int h, int max_par_degree, double* forecasted, double tcalc,double rt_threshold, double c_arr, double c_serv, double ksf,double alpha, double beta,double gamma, int curr_par_degree,int *result, double *min,double *exp_rt, double *kingman, long deadline_nsecs)
+{
+    const int n_max=max_par_degree;
+    //cost of each step for each parallelism degree (index n-1)
+    double *step_cost=new double[h*n_max];
+    //expected response time and waiting time (kingman) for the first step
+    double *rt_first=new double[n_max];
+    double *king_first=new double[n_max];
+    for(int j=0;j<h;j++)
+    {
+        for(int n=1;n<=n_max;n++)
+        {
+            //same computation of resolve_strategy_rt
+            double resp_time, kingman_prev=INT_MAX;
+            double cost=0;
+            double rho=(tcalc/(double)n)/(MAX_RHO_MODULE/forecasted[j]);
+            if(rho<1)
+            {
+                kingman_prev=((rho/(1-rho))*((c_arr*c_arr+c_serv*c_serv)/2)*(tcalc/n));
+                resp_time=tcalc+kingman_prev*ksf;
+            }
+            else
+            {
+                resp_time=INT_MAX;
+                cost+=resp_time;
+            }
+            double ratio=((double)resp_time)/rt_threshold;
+            if(ratio>100)
+                cost+=INT_MAX;
+            else
+                cost+=alpha*exp(ratio);
+            cost+=beta*n;
+            step_cost[j*n_max+n-1]=cost;
+            if(j==0)
+            {
+                rt_first[n-1]=resp_time;
+                king_first[n-1]=kingman_prev;
+            }
+        }
+    }
+
+    //value[j*n_max+n-1]: minimum cost of the steps j,...,h-1 if at step j we use n replicas
+    //next[j*n_max+n-1]: the parallelism degree of step j+1 that achieves it
+    double *value=new double[h*n_max];
+    int *next=new int[h*n_max];
+    //cost of the transitions toward the next step (computed apart, so that the loop is vectorized)
+    double *cand=new double[n_max];
+    bool expired=false;
+    for(int n=1;n<=n_max;n++)
+        value[(h-1)*n_max+n-1]=step_cost[(h-1)*n_max+n-1];
+    for(int j=h-2;j>=0 && !expired;j--)
+    {
+        const double *value_next=&value[(j+1)*n_max];
+        for(int n=1;n<=n_max;n++)
+        {
+            for(int m=0;m<n_max;m++)
+            {
+                double d=m+1-n;
+                cand[m]=gamma*d*d+value_next[m];
+            }
+            double best=std::numeric_limits<double>::infinity();
+            int best_m=1;
+            for(int m=0;m<n_max;m++)
+            {
+                if(cand[m]<=best) //ties: the greatest one
+                {
+                    best=cand[m];
+                    best_m=m+1;
+                }
+            }
+            value[j*n_max+n-1]=step_cost[j*n_max+n-1]+best;
+            next[j*n_max+n-1]=best_m;
+        }
+        expired=deadline_nsecs>0 && current_time_nsecs()>deadline_nsecs;
+    }
+    delete[] cand;
+    if(expired)
+    {
+        delete[] step_cost;
+        delete[] rt_first;
+        delete[] king_first;
+        delete[] value;
+        delete[] next;
+        return false;
+    }
+
+    //first step: switching cost from the current configuration
+    double best=std::numeric_limits<double>::infinity();
+    int first=1;
+    for(int n=1;n<=n_max;n++)
+    {
+        double v=gamma*(n-curr_par_degree)*(n-curr_par_degree)+value[n-1];
+        if(v<=best)
+        {
+            best=v;
+            first=n;
+        }
+    }
+    if(best<=*min)
+    {
+        *min=best;
+        result[0]=first;
+        for(int j=1;j<h;j++)
+            result[j]=next[(j-1)*n_max+result[j-1]-1];
+        *exp_rt=rt_first[first-1];
+        *kingman=king_first[first-1];
+    }
+    delete[] step_cost;
+    delete[] rt_first;
+    delete[] king_first;
+    delete[] value;
+    delete[] next;
+    return true;
+}
+
+/**
+    Evaluates the objective function of resolve_strategy_rt for a given trajectory (e.g. the one
+    used if the resolution does not complete within the time budget)
+    @param trajectory the h parallelism degrees
+    @param exp_rt, kingman the expected response time and waiting time for the first step
+    @return the value of the objective function
+*/
+double evaluate_trajectory_rt(int h, const int *trajectory, double* forecasted, double tcalc,double rt_threshold, double c_arr, double c_serv, double ksf,double alpha, double beta,double gamma, int curr_par_degree,double *exp_rt, double *kingman)
+{
+    double obj_funct=gamma*(trajectory[0]-curr_par_degree)*(trajectory[0]-curr_par_degree);
+    for(int j=0;j<h;j++)
+    {
+        double resp_time, kingman_prev=INT_MAX;
+        double rho=(tcalc/(double)trajectory[j])/(MAX_RHO_MODULE/forecasted[j]);
+        if(rho<1)
+        {
+            kingman_prev=((rho/(1-rho))*((c_arr*c_arr+c_serv*c_serv)/2)*(tcalc/trajectory[j]));
+            resp_time=tcalc+kingman_prev*ksf;
+        }
+        else
+        {
+            resp_time=INT_MAX;
+            obj_funct+=resp_time;
+        }
+        double ratio=((double)resp_time)/rt_threshold;
+        if(ratio>100)
+            obj_funct+=INT_MAX;
+        else
+            obj_funct+=alpha*exp(ratio);
+        obj_funct+=beta*trajectory[j];
+        if(j>0)
+            obj_funct+=gamma*(trajectory[j]-trajectory[j-1])*(trajectory[j]-trajectory[j-1]);
+        else
+        {
+            *exp_rt=resp_time;
+            *kingman=kingman_prev;
+        }
+    }
+    return obj_funct;
+}
+
+
 /**
   TPDS functions
   - SPL in the paper
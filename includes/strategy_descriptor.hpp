@@ -24,6 +24,7 @@
 #ifndef STRATEGY_HPP
 #define STRATEGY_HPP
 #include "config.hpp"
+#include "general.h"
 enum class StrategyType{
     NONE,
     LATENCY,
@@ -32,6 +33,18 @@ enum class StrategyType{
     TPDS
 };
 
+enum class RoutingType{
+    TABLE,
+    CONSISTENT_HASH
+};
+
+enum class ForecasterType{
+    SMA,
+    HOLT_WINTERS,
+    EWMA,
+    AR
+};
+
 /**
  * @brief The StrategyDescriptor class it is a descriptor for an adaptation strategy,
  * whose detail are read from file. The configuration file has to respect a proper sintax:
@@ -49,11 +62,44 @@ enum class StrategyType{
  * - depending from the strategy type other parameters are required
  *      - alpha=<value>, beta=<value>, gamma=<value>: are the parameters for the MPC-Based strategies as described in the paper.
  *                   They are positive float numbers. They are required for latency, latency_energy
+ *      - solve_budget=<value>: optional for latency, latency_energy. Maximum time (in microseconds) spent in the
+ *                  strategy resolution at each control step (default 10% of the control step, 0 means unbounded).
+ *                  If it expires the best among the previous trajectory, the current configuration and the maximum one is used
+ *      - forecaster=<value>: optional for latency, latency_energy. Model used for forecasting the arrival rate (see forecaster.hpp):
+ *              - sma: simple moving average (default) over the last forecaster_order=<value> steps (default 3, or
+ *                  the horizon if larger). It must be at least equal to the horizon
+ *              - holt_winters: double exponential smoothing with parameters forecaster_alpha=<value> (default 0.67)
+ *                  and forecaster_beta=<value> (default 0.26)
+ *              - ewma: exponentially weighted moving average with parameter forecaster_alpha=<value> (default 0.5)
+ *              - ar: autoregressive model of order forecaster_order=<value> (default 3), estimated online
  *      - threshold=<value>: required for latency, latency_energy and latency_rule. Describe the desired
  *                  latency threshold in millisecond (positive float number).
  *      - max_level=<value>, change_sensitivity=<value>, cong_threshold=<value> are required
  *                  by the tpds strategy
     - control_step parameter: express the length (in milliseconds) of the control step
+ * - optional parameters for the data channels (see channel.hpp), valid for every strategy:
+ *      - channel_batch=<value>: maximum number of tuples/results moved at once between splitter, replicas
+ *                  and merger (between 1 and CHANNEL_MAX_BATCH, default 1 i.e. no batching)
+ *      - channel_flush=<value>: maximum time (in microseconds) that a tuple/result can wait in a
+ *                  batch before being sent (default 50). Latency constrained strategies should
+ *                  keep it well below the latency threshold
+ * - trace_file=<value>: optional, valid for every strategy. The controller records each control step (metrics and decision)
+ *      in this file, that can be replayed with strategy-sim (see strategy_trace.hpp)
+ * - rebalance_imbalance=<value>: optional, valid for every strategy. When the number of replicas changes or their load is
+ *      unbalanced, the controller moves the minimum number of keys needed for keeping the load of each replica within this
+ *      percentage above the average one (default 10, see compute_st_incremental)
+ * - routing=<value>: optional, valid for every strategy. How classes are assigned to the replicas:
+ *      - table: the scheduling table is computed by the controller from the current one, moving the minimum number of classes (default)
+ *      - consistent_hash: classes follow the jump consistent hash of their id, the controller overrides it only for the classes
+ *              needed to respect rebalance_imbalance (see consistent_hash.hpp)
+ * - hot_key_split=<value>: optional, valid for every strategy except none. If 1, a class whose load alone exceeds the bound given by
+ *      rebalance_imbalance is split: its panes (window_slide tuples) are spread on all the replicas, that send their summaries
+ *      to the merger where the results are computed (see pane.hpp). A split class whose load falls to the average one of a
+ *      replica is assigned again to a single replica. Default 0
+ * - wait_policy=<value>: how threads wait on empty queues (see wait_policy.hpp). Optional, valid for every strategy:
+ *      - spin: they keep polling the queue (default)
+ *      - yield: they spin for a while, then they yield the core between two polls
+ *      - futex: they spin for a while, then they park until something is pushed
  *
  *
  * Please note that for this testing version, we require in any case to insert the control_step parameter, in order
@@ -71,6 +117,12 @@ public:
     double threshold;
     int horizon;
     bool predictive=false; //states if the required strategy is predictive or not
+    long solve_budget_usecs=0; //time budget for the resolution of the MPC-based strategies
+
+    //forecasting of the arrival rate for the MPC-based strategies
+    ForecasterType forecaster=ForecasterType::SMA;
+    int forecaster_order=3;     //window length for SMA, order for AR
+    double forecaster_alpha, forecaster_beta;
 
     //parameters for TPDS
     int max_level; //that is referred as L* in the article (max_workers-1 in pianosau)
@@ -82,10 +134,28 @@ public:
 
     //Control step: interval between two strategy evaluations (in milliseconds)
     int control_step;
+
+    //parameters for the data channels
+    int channel_batch=1;
+    int channel_flush_usecs=50;
+
+    //how threads wait on empty queues
+    WaitPolicy wait_policy=WaitPolicy::SPIN;
+
+    //maximum load of a replica above the average one, after a rebalancing of the keys (fraction)
+    double rebalance_imbalance=0.1;
+    RoutingType routing=RoutingType::TABLE;
+    //the hot keys can be split among the replicas
+    bool hot_key_split=false;
+
+    //file in which the control steps are recorded (empty if not required)
+    std::string trace_file;
+
     StrategyDescriptor(std::string const& configFile)
     {
         //Read the configuration file
         Configuration c(configFile);
+        getRuntimeParameters(c);
         //get the type of strategy and the various parameters
         std::string strategy_type=c.getValue("strategy");
         if(strategy_type.empty())
@@ -222,6 +292,36 @@ public:
         }
 
         std::cout<<"]"<<std::endl;
+        if(wait_policy!=WaitPolicy::SPIN)
+            std::cout<<"[Wait policy: "<<(wait_policy==WaitPolicy::SPIN_YIELD?wait_yield:wait_futex)<<"]"<<std::endl;
+        if(predictive)
+        {
+            std::cout<<"[Forecaster: ";
+            switch(forecaster)
+            {
+                case ForecasterType::SMA:
+                    std::cout<<forecaster_sma<<", window="<<forecaster_order;
+                break;
+                case ForecasterType::HOLT_WINTERS:
+                    std::cout<<forecaster_holt_winters<<", alpha="<<forecaster_alpha<<", beta="<<forecaster_beta;
+                break;
+                case ForecasterType::EWMA:
+                    std::cout<<forecaster_ewma<<", alpha="<<forecaster_alpha;
+                break;
+                case ForecasterType::AR:
+                    std::cout<<forecaster_ar<<", order="<<forecaster_order;
+                break;
+            }
+            std::cout<<"]"<<std::endl;
+        }
+        if(predictive)
+            std::cout<<"[Solve budget (usecs): "<<(solve_budget_usecs>0?std::to_string(solve_budget_usecs):"unbounded")<<"]"<<std::endl;
+        if(routing==RoutingType::CONSISTENT_HASH)
+            std::cout<<"[Routing: "<<routing_consistent_hash<<"]"<<std::endl;
+        if(hot_key_split)
+            std::cout<<"[Hot keys split among the replicas]"<<std::endl;
+        if(channel_batch>1)
+            std::cout<<"[Data channels: batch="<<channel_batch<<", flush bound (usecs)="<<channel_flush_usecs<<"]"<<std::endl;
     }
 
 private:
@@ -231,6 +331,69 @@ private:
     const std::string strategy_tpds="spl";
     const std::string strategy_rule="rule_based";
     const std::string strategy_latency_rule="latency_rule";
+    const std::string wait_spin="spin";
+    const std::string wait_yield="yield";
+    const std::string wait_futex="futex";
+    const std::string routing_table="table";
+    const std::string routing_consistent_hash="consistent_hash";
+    const std::string forecaster_sma="sma";
+    const std::string forecaster_holt_winters="holt_winters";
+    const std::string forecaster_ewma="ewma";
+    const std::string forecaster_ar="ar";
+
+    /*
+     * Support method, reads the (optional) parameters of the data channels, the routing and the wait policy
+     */
+    void getRuntimeParameters(Configuration c)
+    {
+        std::string par=c.getValue("channel_batch");
+        if(!par.empty())
+        {
+            channel_batch=std::stoi(par);
+            if(channel_batch<1 || channel_batch>CHANNEL_MAX_BATCH)
+                throw std::runtime_error("Bad configuration file: channel_batch must be between 1 and "+std::to_string(CHANNEL_MAX_BATCH));
+        }
+        par=c.getValue("channel_flush");
+        if(!par.empty())
+        {
+            channel_flush_usecs=std::stoi(par);
+            if(channel_flush_usecs<0)
+                throw std::runtime_error("Bad configuration file: channel_flush must be positive");
+        }
+        trace_file=c.getValue("trace_file");
+        par=c.getValue("rebalance_imbalance");
+        if(!par.empty())
+        {
+            rebalance_imbalance=std::stod(par)/100.0;
+            if(rebalance_imbalance<0)
+                throw std::runtime_error("Bad configuration file: rebalance_imbalance must be positive");
+        }
+        par=c.getValue("routing");
+        if(!par.empty())
+        {
+            if(par.compare(routing_table)==0)
+                routing=RoutingType::TABLE;
+            else if(par.compare(routing_consistent_hash)==0)
+                routing=RoutingType::CONSISTENT_HASH;
+            else
+                throw std::runtime_error("Bad configuration file: routing must be one of table, consistent_hash");
+        }
+        par=c.getValue("hot_key_split");
+        if(!par.empty())
+            hot_key_split=(std::stoi(par)!=0);
+        par=c.getValue("wait_policy");
+        if(!par.empty())
+        {
+            if(par.compare(wait_spin)==0)
+                wait_policy=WaitPolicy::SPIN;
+            else if(par.compare(wait_yield)==0)
+                wait_policy=WaitPolicy::SPIN_YIELD;
+            else if(par.compare(wait_futex)==0)
+                wait_policy=WaitPolicy::SPIN_FUTEX;
+            else
+                throw std::runtime_error("Bad configuration file: wait_policy must be one of spin, yield, futex");
+        }
+    }
 
     /*
      * Support method, called for various type of strategies
@@ -255,6 +418,70 @@ private:
         horizon=std::stoi(par);
         if(horizon<1)
             throw std::runtime_error("Bad configuration file: horizon must be at least equal to one");
+        par=c.getValue("solve_budget");
+        if(!par.empty())
+        {
+            solve_budget_usecs=std::stol(par);
+            if(solve_budget_usecs<0)
+                throw std::runtime_error("Bad configuration file: solve_budget must be positive");
+        }
+        else
+            solve_budget_usecs=control_step*100L; //10% of the control step
+        getForecasterParameters(c);
+    }
+
+    /*
+     * Support method, reads the (optional) parameters of the forecaster
+     */
+    void getForecasterParameters(Configuration c)
+    {
+        std::string par=c.getValue("forecaster");
+        forecaster_alpha=0.5;
+        forecaster_beta=0;
+        if(!par.empty())
+        {
+            if(par.compare(forecaster_sma)==0)
+                forecaster=ForecasterType::SMA;
+            else if(par.compare(forecaster_holt_winters)==0)
+            {
+                forecaster=ForecasterType::HOLT_WINTERS;
+                //values used for the real dataset
+                forecaster_alpha=0.67;
+                forecaster_beta=0.26;
+            }
+            else if(par.compare(forecaster_ewma)==0)
+                forecaster=ForecasterType::EWMA;
+            else if(par.compare(forecaster_ar)==0)
+                forecaster=ForecasterType::AR;
+            else
+                throw std::runtime_error("Bad configuration file: forecaster must be one of sma, holt_winters, ewma, ar");
+        }
+        par=c.getValue("forecaster_order");
+        if(!par.empty())
+        {
+            forecaster_order=std::stoi(par);
+            if(forecaster_order<1)
+                throw std::runtime_error("Bad configuration file: forecaster_order must be at least equal to one");
+            //otherwise the last steps would be forecasted only from the previous forecasts
+            if(forecaster==ForecasterType::SMA && forecaster_order<horizon)
+                throw std::runtime_error("Bad configuration file: with sma, forecaster_order must be at least equal to the horizon");
+        }
+        else if(forecaster==ForecasterType::SMA && forecaster_order<horizon)
+            forecaster_order=horizon;
+        par=c.getValue("forecaster_alpha");
+        if(!par.empty())
+        {
+            forecaster_alpha=std::stod(par);
+            if(forecaster_alpha<0 || forecaster_alpha>1)
+                throw std::runtime_error("Bad configuration file: forecaster_alpha must be between 0 and 1");
+        }
+        par=c.getValue("forecaster_beta");
+        if(!par.empty())
+        {
+            forecaster_beta=std::stod(par);
+            if(forecaster_beta<0 || forecaster_beta>1)
+                throw std::runtime_error("Bad configuration file: forecaster_beta must be between 0 and 1");
+        }
     }
 
 
@@ -0,0 +1,148 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Trace of the control steps, recorded by the controller and replayed by strategy-sim
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef STRATEGY_TRACE_HPP
+#define STRATEGY_TRACE_HPP
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+
+#define TRACE_MAGIC "EHFTRC01"
+
+/*
+ * The trace is a binary file made of:
+ * - an header (trace_header_t) followed by the list of the available frequencies (uint32_t, KHz);
+ * - a record (trace_step_t) for each control step, with the metrics derived by the controller
+ *   in that step and the decision taken.
+ * Records are written in the byte order of the machine.
+ */
+
+typedef struct{
+    char magic[8];
+    int32_t max_workers;
+    int32_t control_step;           //msec
+    int32_t num_frequencies;
+    int32_t padding;
+}trace_header_t;
+
+typedef struct{
+    double time;                    //seconds from the beginning
+    int32_t num_workers;            //configuration during the step
+    uint32_t frequency;             //KHz
+    //metrics (see DerivedMetrics)
+    double trigger_per_second;
+    double tta_msec;
+    double module_tcalc;            //msec
+    double module_rho;
+    double c_arr;
+    double c_serv;
+    //from the merger
+    double avg_lat;                 //usecs
+    int64_t results;
+    //from the splitter
+    int32_t congestion;
+    //decision for the next step
+    int32_t n_opt;
+    uint32_t freq_opt;
+    int32_t padding;
+}trace_step_t;
+
+/**
+ * Records the control steps on file
+ */
+class TraceWriter{
+public:
+    /**
+     * @param file_name the trace file
+     * @param frequencies the available frequencies (empty if not used)
+     */
+    TraceWriter(const char *file_name, int max_workers, int control_step, const std::vector<uint32_t> &frequencies)
+    {
+        fout=fopen(file_name,"wb");
+        if(fout==NULL)
+        {
+            fprintf(stderr,"Error in opening the trace file %s\n",file_name);
+            return;
+        }
+        trace_header_t h;
+        memset(&h,0,sizeof(h));
+        memcpy(h.magic,TRACE_MAGIC,sizeof(h.magic));
+        h.max_workers=max_workers;
+        h.control_step=control_step;
+        h.num_frequencies=frequencies.size();
+        fwrite(&h,sizeof(h),1,fout);
+        if(!frequencies.empty())
+            fwrite(frequencies.data(),sizeof(uint32_t),frequencies.size(),fout);
+    }
+
+    ~TraceWriter()
+    {
+        if(fout)
+            fclose(fout);
+    }
+
+    inline void write(const trace_step_t &step)
+    {
+        if(fout)
+            fwrite(&step,sizeof(step),1,fout);
+    }
+
+private:
+    FILE *fout;
+};
+
+/**
+ * Reads a whole trace
+ * @return false if the file does not exist or it is not a trace
+ */
+inline bool readTrace(const char *file_name, trace_header_t *header, std::vector<uint32_t> &frequencies, std::vector<trace_step_t> &steps)
+{
+    FILE *fin=fopen(file_name,"rb");
+    if(fin==NULL)
+        return false;
+    if(fread(header,sizeof(trace_header_t),1,fin)!=1 || memcmp(header->magic,TRACE_MAGIC,sizeof(header->magic))!=0)
+    {
+        fclose(fin);
+        return false;
+    }
+    frequencies.resize(header->num_frequencies);
+    if(header->num_frequencies>0 && fread(frequencies.data(),sizeof(uint32_t),header->num_frequencies,fin)!=(size_t)header->num_frequencies)
+    {
+        fclose(fin);
+        return false;
+    }
+    trace_step_t step;
+    while(fread(&step,sizeof(step),1,fin)==1)
+        steps.push_back(step);
+    fclose(fin);
+    return true;
+}
+
+#endif // STRATEGY_TRACE_HPP
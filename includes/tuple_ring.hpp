@@ -0,0 +1,86 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Preallocated tuples for the dispatching from the splitter to a replica (TASK_BUFF mode)
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef TUPLE_RING_HPP
+#define TUPLE_RING_HPP
+#include <stdlib.h>
+#include <stdio.h>
+#include "general.h"
+
+/*
+ * A replica processes its tuples in FIFO order and does not keep references to them once
+ * it has popped the next one (tuples that have to wait for a moving in class are copied).
+ * Therefore, if its input queue can contain at most QUEUE_SIZE elements, when the splitter
+ * fills a new tuple at most QUEUE_SIZE+1 of the previous ones can still be in use
+ * (the ones in queue and the one under processing), plus the ones staged by the splitter
+ * and the ones already popped by the replica when the channel is batched (see channel.hpp).
+ * A ring of QUEUE_SIZE+2*CHANNEL_MAX_BATCH+2 tuples can be safely recycled: the backpressure
+ * is given by the queue itself.
+ */
+#define TUPLE_RING_SIZE (QUEUE_SIZE+2*CHANNEL_MAX_BATCH+2)
+
+/**
+ * Ring of preallocated tuples used by the splitter for sending tasks to a given replica.
+ * It is used only by the splitter: no synchronization is needed.
+ */
+class TupleRing{
+public:
+    TupleRing(int size=TUPLE_RING_SIZE)
+    {
+        this->size=size;
+        if(posix_memalign((void **)&tuples,CACHE_LINE_SIZE,size*sizeof(tuple_t))!=0)
+        {
+            fprintf(stderr,"Error in allocating tuple ring\n");
+            exit(-1);
+        }
+        index=0;
+    }
+
+    ~TupleRing()
+    {
+        free(tuples);
+    }
+
+    /**
+     * @brief next returns the tuple to be filled and sent
+     */
+    inline tuple_t *next()
+    {
+        tuple_t *t=&tuples[index];
+        if(++index==size)
+            index=0;
+        return t;
+    }
+
+private:
+    tuple_t *tuples;
+    int size;
+    int index;
+};
+
+#endif // TUPLE_RING_HPP
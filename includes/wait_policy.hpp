@@ -0,0 +1,326 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    How threads wait on empty (or full) queues.
+
+    With the default policy (spin) a thread that finds its queue empty keeps
+    polling it, burning the core. The other policies spin for a while and then:
+    - yield: release the core to the OS (sched_yield) between two polls;
+    - futex: park the thread on the doorbell of the queue. Producers ring the doorbell
+      after each push; the doorbell costs them a fence and a load as long as nobody is parked.
+    A thread waiting for room in a full queue (backpressure) never parks, it yields instead.
+
+    The policy is global (see set_wait_policy) and it is read from the strategy configuration file.
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef WAIT_POLICY_HPP
+#define WAIT_POLICY_HPP
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define WAIT_SPIN_ROUNDS 100                //polls (each one followed by 25 PAUSE) before yielding or parking
+#define WAIT_PARK_USECS 1000                //maximum time parked before polling again
+#define WAIT_REGISTRY_SIZE 4096             //maximum number of queues with a doorbell
+
+enum class WaitPolicy{
+    SPIN,
+    SPIN_YIELD,
+    SPIN_FUTEX
+};
+
+inline WaitPolicy &wait_policy()
+{
+    static WaitPolicy policy=WaitPolicy::SPIN;
+    return policy;
+}
+
+inline void set_wait_policy(WaitPolicy policy)
+{
+    wait_policy()=policy;
+}
+
+/**
+ * Doorbell on which the consumer(s) of one or more queues park
+ */
+class Doorbell{
+public:
+    Doorbell()
+    {
+        seq.store(0);
+        waiters.store(0);
+    }
+
+    /**
+     * @brief ring wakes up the parked threads (if any). To be called after having pushed
+     */
+    inline void ring()
+    {
+        //pairs with the one in park: either the consumer sees the pushed element or we see it parked
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(waiters.load(std::memory_order_relaxed)>0)
+        {
+            seq.fetch_add(1);
+            syscall(SYS_futex,(int *)&seq,FUTEX_WAKE_PRIVATE,INT_MAX,NULL,NULL,0);
+        }
+    }
+
+    /**
+     * @brief park parks the calling thread until the doorbell is rung or the timeout expires
+     * @param ready it is evaluated after having announced the parking: if true the thread does not park
+     * @return the value of ready() before parking
+     */
+    template <typename Ready>
+    inline bool park(Ready ready, long usecs=WAIT_PARK_USECS)
+    {
+        waiters.fetch_add(1);
+        int s=seq.load();
+        if(ready())
+        {
+            waiters.fetch_sub(1);
+            return true;
+        }
+        struct timespec timeout;
+        timeout.tv_sec=usecs/1000000;
+        timeout.tv_nsec=(usecs%1000000)*1000;
+        syscall(SYS_futex,(int *)&seq,FUTEX_WAIT_PRIVATE,s,&timeout,NULL,0);
+        waiters.fetch_sub(1);
+        return false;
+    }
+
+private:
+    std::atomic<int> seq;
+    std::atomic<int> waiters;
+    char padding[64-2*sizeof(std::atomic<int>)];
+};
+
+/**
+ * Association between queues and doorbells. Lookups are lock free, while
+ * (rare) modifications are serialized. Doorbells are never deallocated: a producer
+ * may ring one after that its consumer has terminated.
+ */
+class DoorbellRegistry{
+public:
+    DoorbellRegistry()
+    {
+        for(int i=0;i<WAIT_REGISTRY_SIZE;i++)
+        {
+            table[i].key.store(NULL);
+            table[i].bell.store(NULL);
+        }
+    }
+
+    /**
+     * @brief lookup returns the doorbell of a queue, NULL if it has not one
+     */
+    inline Doorbell *lookup(const void *queue)
+    {
+        for(int i=0,h=hash(queue);i<WAIT_REGISTRY_SIZE;i++,h=(h+1)&(WAIT_REGISTRY_SIZE-1))
+        {
+            const void *k=table[h].key.load(std::memory_order_acquire);
+            if(k==queue)
+                return table[h].bell.load(std::memory_order_relaxed);
+            if(k==NULL)
+                return NULL;
+        }
+        return NULL;
+    }
+
+    /**
+     * @brief attach associates a doorbell to a queue (e.g. a single doorbell for all the queues of a consumer)
+     * @return false if there is no more room in the registry
+     */
+    bool attach(const void *queue, Doorbell *bell)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int free_slot=-1;
+        for(int i=0,h=hash(queue);i<WAIT_REGISTRY_SIZE;i++,h=(h+1)&(WAIT_REGISTRY_SIZE-1))
+        {
+            const void *k=table[h].key.load();
+            if(k==queue)
+            {
+                table[h].bell.store(bell);
+                return true;
+            }
+            if(free_slot<0 && table[h].bell.load()==NULL)
+                free_slot=h;
+            if(k==NULL)
+                break;
+        }
+        if(free_slot<0)
+            return false;
+        table[free_slot].bell.store(bell);
+        table[free_slot].key.store(queue,std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief detach removes the doorbell of a queue (e.g. because it is going to be destroyed)
+     */
+    void detach(const void *queue)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(int i=0,h=hash(queue);i<WAIT_REGISTRY_SIZE;i++,h=(h+1)&(WAIT_REGISTRY_SIZE-1))
+        {
+            const void *k=table[h].key.load();
+            if(k==queue)
+            {
+                //the key is kept, so that the other ones remain reachable
+                table[h].bell.store(NULL);
+                return;
+            }
+            if(k==NULL)
+                return;
+        }
+    }
+
+    /**
+     * @brief get returns the doorbell of a queue, creating it if needed (NULL if the registry is full)
+     */
+    Doorbell *get(const void *queue)
+    {
+        Doorbell *bell=lookup(queue);
+        if(bell==NULL)
+        {
+            bell=create();
+            if(!attach(queue,bell))
+            {
+                //nobody else knows it
+                free(bell);
+                return NULL;
+            }
+        }
+        return bell;
+    }
+
+    /**
+     * @brief create allocates a new doorbell
+     */
+    static Doorbell *create()
+    {
+        void *mem;
+        if(posix_memalign(&mem,64,sizeof(Doorbell))!=0)
+        {
+            fprintf(stderr,"Error in allocating a doorbell\n");
+            exit(-1);
+        }
+        return new (mem) Doorbell();
+    }
+
+private:
+    static inline int hash(const void *queue)
+    {
+        return (int)((((uintptr_t)queue>>4)*0x9E3779B97F4A7C15ULL)>>52)&(WAIT_REGISTRY_SIZE-1);
+    }
+
+    struct{
+        std::atomic<const void *> key;
+        std::atomic<Doorbell *> bell;
+    }table[WAIT_REGISTRY_SIZE];
+    std::mutex mutex;
+};
+
+inline DoorbellRegistry &doorbells()
+{
+    static DoorbellRegistry registry;
+    return registry;
+}
+
+/**
+ * @brief wait_notify signals to the consumer of a queue that something has been pushed
+ */
+inline void wait_notify(const void *queue)
+{
+    if(wait_policy()!=WaitPolicy::SPIN_FUTEX)
+        return;
+    Doorbell *bell=doorbells().lookup(queue);
+    if(bell)
+        bell->ring();
+}
+
+/**
+ * Polls ready() (forever, if endless is true), returns true if it became true
+ */
+template <typename Ready>
+inline bool wait_spin(Ready ready, bool endless)
+{
+    for(int i=0;i<WAIT_SPIN_ROUNDS || endless;i=(i<WAIT_SPIN_ROUNDS)?i+1:i)
+    {
+        for(int j=0;j<25;j++)
+            asm volatile("PAUSE" ::: "memory");
+        if(ready())
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief wait_for waits until ready() becomes true according to the current wait policy
+ * @param queue the queue for which the caller is waiting (it identifies the doorbell)
+ * @param ready it is evaluated at each poll (e.g. it tries to pop from the queue)
+ */
+template <typename Ready>
+inline void wait_for(const void *queue, Ready ready)
+{
+    if(wait_spin(ready,wait_policy()==WaitPolicy::SPIN))
+        return;
+    if(wait_policy()==WaitPolicy::SPIN_FUTEX)
+    {
+        Doorbell *bell=doorbells().get(queue);
+        if(bell)
+        {
+            while(!bell->park(ready))
+                if(ready())
+                    return;
+            return;
+        }
+    }
+    //yield (also used if the queue has not a doorbell)
+    while(!ready())
+        sched_yield();
+}
+
+/**
+ * @brief wait_room waits until ready() becomes true, without parking (the consumer does not ring on pop)
+ */
+template <typename Ready>
+inline void wait_room(Ready ready)
+{
+    if(wait_spin(ready,wait_policy()==WaitPolicy::SPIN))
+        return;
+    while(!ready())
+        sched_yield();
+}
+
+#endif // WAIT_POLICY_HPP
@@ -0,0 +1,176 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Association between classes (keys) and windows held by a replica
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef WINDOW_DIRECTORY_HPP
+#define WINDOW_DIRECTORY_HPP
+#include <stdlib.h>
+#include <stdio.h>
+#include <new>
+#include "general.h"
+#if defined(PANE_WINDOW)
+#include "pane_window.hpp"
+typedef PaneWindow window_t;
+#else
+#include "cbwindow.hpp"
+typedef CBWindow window_t;
+#endif
+
+#define ARENA_CHUNK_SIZE (4*1024*1024)     //minimum size of the memory chunks of a window arena
+
+/**
+ * Memory from which a replica allocates its windows. Memory is taken from the system in
+ * large chunks and assigned with a bump pointer: windows are never deallocated
+ * one by one.
+ *
+ * NOTE: the windows may migrate to other replicas (see Repository), therefore the arena
+ * must outlive the replica that created it. For this reason its memory is never released.
+ * The replica pool keeps an arena for each slot, used by all the activations of that replica.
+ */
+class WindowArena{
+public:
+    WindowArena()
+    {
+        chunk=NULL;
+        available=0;
+    }
+
+    /**
+     * @brief allocate returns size bytes of cache aligned memory
+     */
+    void *allocate(size_t size)
+    {
+        size=(size+CACHE_LINE_SIZE-1)/CACHE_LINE_SIZE*CACHE_LINE_SIZE;
+        if(size>available)
+        {
+            size_t chunk_size=(size>ARENA_CHUNK_SIZE)?size:ARENA_CHUNK_SIZE;
+            if(posix_memalign((void **)&chunk,CACHE_LINE_SIZE,chunk_size)!=0)
+            {
+                fprintf(stderr,"Error in allocating window arena\n");
+                exit(-1);
+            }
+            available=chunk_size;
+        }
+        void *ret=chunk;
+        chunk+=size;
+        available-=size;
+        return ret;
+    }
+
+private:
+    char *chunk;        //free part of the current chunk
+    size_t available;   //its size
+};
+
+/**
+ * The windows held by a replica. Classes are dense integers in [0,num_classes),
+ * therefore the directory is an array directly indexed by the class.
+ * Windows are created lazily, the first time that a class is seen, in the arena of the replica.
+ */
+class WindowDirectory{
+public:
+    /**
+     * @param num_classes number of classes
+     * @param window_size
+     * @param window_slide
+     * @param arena where the windows are allocated. If NULL a new one is created
+     */
+    WindowDirectory(int num_classes, int window_size, int window_slide, WindowArena *arena=NULL)
+    {
+        this->num_classes=num_classes;
+        this->window_size=window_size;
+        this->window_slide=window_slide;
+        windows=new window_t*[num_classes]();
+        //not deleted: see WindowArena
+        this->arena=(arena!=NULL)?arena:new WindowArena();
+    }
+
+    ~WindowDirectory()
+    {
+        delete[] windows;
+    }
+
+    /**
+     * @brief get returns the window of a class, or NULL if the replica does not hold it
+     */
+    inline window_t *get(int class_id)
+    {
+        return windows[class_id];
+    }
+
+    /**
+     * @brief getOrCreate returns the window of a class, creating it if this is a new logical stream
+     */
+    inline window_t *getOrCreate(int class_id)
+    {
+        window_t *w=windows[class_id];
+        if(w==NULL)
+        {
+            w=create();
+            windows[class_id]=w;
+        }
+        return w;
+    }
+
+    /**
+     * @brief create allocates a new (empty) window, not associated to any class
+     */
+    window_t *create()
+    {
+        void *mem=arena->allocate(sizeof(window_t));
+        void *storage=arena->allocate(window_t::storageSize(window_size,window_slide));
+        return new (mem) window_t(window_size,window_slide,storage);
+    }
+
+    /**
+     * @brief set associates a window (e.g. one that has been moved from another replica) to a class
+     */
+    inline void set(int class_id, window_t *w)
+    {
+        windows[class_id]=w;
+    }
+
+    /**
+     * @brief remove removes the association for a class
+     * @return the window of the class (NULL if the replica did not hold it)
+     */
+    inline window_t *remove(int class_id)
+    {
+        window_t *w=windows[class_id];
+        windows[class_id]=NULL;
+        return w;
+    }
+
+private:
+    int num_classes;
+    int window_size;
+    int window_slide;
+    window_t **windows;
+    WindowArena *arena;
+};
+
+#endif // WINDOW_DIRECTORY_HPP
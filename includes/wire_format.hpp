@@ -0,0 +1,121 @@
+/*
+    ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+
+    Format of the quotes exchanged between the generators and the splitter.
+
+    The external format is decoupled from the internal one (tuple_t): only the
+    informations about the quote travel on the socket (32 bytes per quote instead of
+    the 64 of the padded tuple). The splitter expands each record into the internal tuple.
+
+    A connection starts with a wire_header_t, followed by the records. Generator and splitter
+    are assumed to run on the same kind of machine: fields are in host byte order.
+
+    Author: Tiziano De Matteis <dematteis <at> di.unipi.it>
+
+*/
+
+#ifndef WIRE_FORMAT_HPP
+#define WIRE_FORMAT_HPP
+#include <stdint.h>
+#include "general.h"
+
+#define WIRE_MAGIC 0x5446482d45505351ULL    //identifies the stream of quotes
+#define WIRE_VERSION 1                      //to be incremented at each change of wire_quote_t
+
+/**
+ * Sent once, at the beginning of the connection
+ */
+typedef struct{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t record_size;       //size (in bytes) of a record
+}wire_header_t;
+
+/**
+ * A quote, as sent by the generator. The special records (start of stream, EOS) are
+ * identified by the type as in tuple_t (respectively -10 and -1)
+ */
+typedef struct{
+    int32_t type;               //class (symbol)
+    float bid_price;
+    int32_t bid_size;
+    float ask_price;
+    int32_t ask_size;
+    int32_t ts_delta;           //original_timestamp - timestamp (usecs)
+    int64_t timestamp;          //sending time from the generator side (usecs)
+}wire_quote_t;
+
+static_assert(sizeof(wire_quote_t)==32,"wire_quote_t must be 32 bytes");
+
+/**
+ * @brief wire_header fills the header of the current version
+ */
+static inline void wire_header(wire_header_t *h)
+{
+    h->magic=WIRE_MAGIC;
+    h->version=WIRE_VERSION;
+    h->record_size=sizeof(wire_quote_t);
+}
+
+/**
+ * @brief wire_check_header checks that the received header is compatible with this version
+ */
+static inline bool wire_check_header(const wire_header_t *h)
+{
+    return h->magic==WIRE_MAGIC && h->version==WIRE_VERSION && h->record_size==sizeof(wire_quote_t);
+}
+
+static inline long wire_original_timestamp(const wire_quote_t *q)
+{
+    return q->timestamp+q->ts_delta;
+}
+
+/**
+ * @brief wire_from_tuple builds the record of a quote
+ */
+static inline void wire_from_tuple(const tuple_t *t, wire_quote_t *q)
+{
+    q->type=t->type;
+    q->bid_price=t->bid_price;
+    q->bid_size=t->bid_size;
+    q->ask_price=t->ask_price;
+    q->ask_size=t->ask_size;
+    q->ts_delta=(int32_t)(t->original_timestamp-t->timestamp);
+    q->timestamp=t->timestamp;
+}
+
+/**
+ * @brief wire_to_tuple expands a record into the internal tuple. Internal fields
+ * (internal_id, punctuation, ...) are left to the caller
+ */
+static inline void wire_to_tuple(const wire_quote_t *q, tuple_t *t)
+{
+    t->type=q->type;
+    t->bid_price=q->bid_price;
+    t->bid_size=q->bid_size;
+    t->ask_price=q->ask_price;
+    t->ask_size=q->ask_size;
+    t->original_timestamp=wire_original_timestamp(q);
+    t->timestamp=q->timestamp;
+}
+
+#endif // WIRE_FORMAT_HPP
@@ -45,13 +45,15 @@
 #include "../includes/general.h"
 #include "../includes/elastic-hft.h"
 #include "../includes/messages.hpp"
-#include "../includes/HoltWinters.h"
+#include "../includes/forecaster.hpp"
 #include "../includes/strategies.hpp"
 #include "../includes/sched_tables.hpp"
 #include "../includes/utils.h"
 #include "../includes/repository.hpp"
 #include "../includes/derived_metrics.hpp"
 #include "../includes/statistics.hpp"
+#include "../includes/replica_pool.hpp"
+#include "../includes/strategy_trace.hpp"
 #include <ff/buffer.hpp>
 #include <ff/allocator.hpp>
 #include <mammut/cpufreq/cpufreq.hpp>
@@ -62,16 +64,6 @@ using namespace ff;
 using namespace std;
 
 
-/**
-	Forecast the next h step of the interarrival rate. 
-    Results are stored in the forecast array
-
-	We can choose between two prediction model:
-	- Simple Moving Average: will consider a window of lenght specified
-    - HoltWinter:
-*/
-inline void forecast(vector<double> obs_v,int h, double *forecasted) __attribute__((always_inline));
-
 /**
  Main function executed by the control thread
 */
@@ -83,7 +75,6 @@ void *controller (void *args)
 	*/
 	controller_data_t *data = (controller_data_t *) args;
 	int num_workers=data->num_workers;
-	int *affinities=data->affinities;
 	int num_classes=data->num_classes;
 	SWSR_Ptr_Buffer *e_inqueue=data->e_inqueue;
 	SWSR_Ptr_Buffer **w_inqueue=data->w_inqueue;
@@ -92,8 +83,6 @@ void *controller (void *args)
 	SWSR_Ptr_Buffer *c_outqueue=data->c_outqueue;
 	char *suffix=data->suffix;
 	long int freq=data->freq;
-	int window_size=data->window_size;
-	int window_slide=data->window_slide;
     int max_workers=data->max_workers;
 	ticks *start_global_ticks=data->start_global_ticks;
     StrategyDescriptor *sd=data->sd;
@@ -101,23 +90,21 @@ void *controller (void *args)
     #if defined(USE_FFALLOC)
 		ff_allocator *ffalloc=data->ffalloc;
 	#endif
-	cpu_set_t cpuset;
 
     //Monitoring messages
     msg::EmitterMonitoring *em=nullptr;
     msg::EmitterMonitoring *top_em=nullptr; //this is used to check wether the Emitter send an EOS just before the Controllore spawn something
 
-    msg::WorkerMonitoring **wm=new msg::WorkerMonitoring*[max_workers];
-    msg::CollectorMonitoring *cm;
+    //(they are not deleted but released: see MonitoringRing)
+    msg::WorkerMonitoring **wm=new msg::WorkerMonitoring*[max_workers]();
+    msg::CollectorMonitoring *cm=nullptr;
 	int64_t monitoring_step=0;
 
 	//The controller will be stopped by the emitter
 	bool stop=false;
 
     // Data about spawned workers
-    worker_data_t *worker_data; //for thread spawning
-    pthread_t *wtids=new pthread_t[max_workers]();
-	char tid_idx=0;
+    ReplicaPool *pool=data->pool; //for activating replicas
 	int threads_spawned=0; //number of thread spawned (that have to be checked on)
 
 
@@ -137,6 +124,7 @@ void *controller (void *args)
     vector<double> rate_per_msecond; //history of the rates per msecond seen so far
     vector<double> forecasts;
 
+    Forecaster *forecaster;                         //model used for forecasting the arrival rate (see forecaster.hpp)
     double *forecasted;                             //forecasted values of the interarrival time
     int *pred_trajectory;                           // trajectory of reconfiguration variable for the case in which energy is not involved (they are essentially the par degree)
     reconf_choice_energy_t *pred_trajectory_energy;  //trajectory for the case in which we have energy (they are a vector [par_degree freq])
@@ -156,6 +144,7 @@ void *controller (void *args)
     if(sd->predictive)
     {
         forecasts.push_back(0);
+        forecaster=createForecaster(sd);
         forecasted=new double[sd->horizon]();
         if( sd->type==StrategyType::LATENCY)
             pred_trajectory=new int[sd->horizon]();
@@ -227,10 +216,43 @@ void *controller (void *args)
     map<pair<int,int>,double> *voltages=loadVoltageTable("./voltages.txt");
 
 
+    //if required, every control step is recorded for strategy-sim
+    TraceWriter *trace=nullptr;
+    trace_step_t trace_step;
+    bool trace_step_valid=false;
+    if(!sd->trace_file.empty())
+    {
+        vector<uint32_t> trace_freqs(available_frequencies.begin(),available_frequencies.end());
+        trace=new TraceWriter(sd->trace_file.c_str(),max_workers,sd->control_step,trace_freqs);
+    }
+
     double ksf_samples[5]={1,1,1,1,1};
     char ksf_samples_idx=0;
     int num_rebalancing=0;
 
+    //classes explicitly assigned by the controller, with the consistent hashing routing (see consistent_hash.hpp)
+    worker_id_t *overrides=nullptr;
+    if(sd->routing==RoutingType::CONSISTENT_HASH)
+        overrides=alloc_scheduling_table(num_classes);
+    //compute the new scheduling table for the current number of workers. It returns the number of classes that are moved
+    //(or split and unsplit, if the hot keys can be split)
+    auto compute_st=[&](worker_id_t *scheduling_table)->int{
+        int split=0;
+        if(sd->hot_key_split)
+        {
+            split=split_hot_classes(num_workers, num_classes,metrics.weighted_tcalc_per_class,scheduling_table,sd->rebalance_imbalance);
+            //the unsplit classes follow again the hash
+            for(int i=0;overrides && i<num_classes;i++)
+                if(scheduling_table[i]==SPLIT_CLASS)
+                    overrides[i]=SPLIT_CLASS;
+                else if(overrides[i]==SPLIT_CLASS)
+                    overrides[i]=0;
+        }
+        if(sd->routing==RoutingType::CONSISTENT_HASH)
+            return split+compute_st_consistent(num_workers, num_classes,metrics.weighted_tcalc_per_class,overrides,scheduling_table,sd->rebalance_imbalance);
+        return split+compute_st_incremental(num_workers, num_classes,metrics.weighted_tcalc_per_class,scheduling_table,sd->rebalance_imbalance);
+    };
+
     //wait the begining of the program and reset counters
 
     while(*start_global_ticks==0)
@@ -247,7 +269,9 @@ void *controller (void *args)
 			one
 		*/
 
-		receiveLast((void **)&em,e_inqueue);
+		if(em!=nullptr) //release the message of the previous step
+			em->release();
+		msg::receiveLast(&em,e_inqueue);
 
 		if(em->stop) //EOS
 			stop=true;
@@ -256,7 +280,9 @@ void *controller (void *args)
 			//receive from workers
 			for(int i=0;i<num_workers;i++)
 			{
-				receiveLast((void **)&wm[i],w_inqueue[i]);	
+				if(wm[i]!=nullptr)
+					wm[i]->release();
+				msg::receiveLast(&wm[i],w_inqueue[i]);
 				// check if  we are exiting from the program
 				//this is the only occasion in which this event can occur
                 if(wm[i]->tag==msg::MonitoringTag::EOS_TAG)//EOS ARRIVED
@@ -271,7 +297,9 @@ void *controller (void *args)
 				break; //come back to emitter data reading (we are exiting...)
 			}
 			
-			receiveLast((void **)&cm,c_inqueue);
+			if(cm!=nullptr)
+				cm->release();
+			msg::receiveLast(&cm,c_inqueue);
 
             /******************************************
                 COMPUTATION OF METRICS
@@ -280,6 +308,26 @@ void *controller (void *args)
 
             //Energy: get current frequency (BY ASSUMPTION all the domains have the same frequency)
             current_frequency=domains.at(0)->getCurrentFrequencyUserspace();
+            if(trace)
+            {
+                memset(&trace_step,0,sizeof(trace_step));
+                trace_step.time=(double)(getticks()-*start_global_ticks)/(freq*1000000);
+                trace_step.num_workers=num_workers;
+                trace_step.frequency=current_frequency;
+                trace_step.trigger_per_second=metrics.trigger_per_second;
+                trace_step.tta_msec=metrics.tta_msec;
+                trace_step.module_tcalc=metrics.module_tcalc;
+                trace_step.module_rho=metrics.module_rho;
+                trace_step.c_arr=metrics.c_arr;
+                trace_step.c_serv=metrics.c_serv;
+                trace_step.avg_lat=cm->avg_lat;
+                trace_step.results=cm->results;
+                trace_step.congestion=em->congestion;
+                //by default the configuration is kept
+                trace_step.n_opt=num_workers;
+                trace_step.freq_opt=current_frequency;
+                trace_step_valid=true;
+            }
             CONTROL_PRINT(cout<< fixed << std::setprecision(3) << ANSI_COLOR_BLUE "[CONTROLLER] Module's rho: "<<metrics.module_rho<<" ,Ta (msec): "<< metrics.tta_msec << ", Rate (TT/s): "<<1000/metrics.tta_msec<< ", Tcalc (msec): "<< metrics.module_tcalc << ", c_arr: "<<metrics.c_arr<<", c_serv: "<<metrics.c_serv<<", Frequency (KHz): "<<current_frequency<<ANSI_COLOR_RESET""<<endl;)
             if(sd->type!=StrategyType::NONE)
             {
@@ -313,12 +361,19 @@ void *controller (void *args)
                 {
                     //rate forecasting, will be conducted reasoning on a msec basis
                     //save the actual rate per second
-                    rate_per_msecond.push_back(metrics.trigger_per_second/1000.0);
-                    //lets compute the error  with the previously predicted rate (TMP)
-                    mape.push_back(100*fabs(metrics.trigger_per_second/1000.0-forecasted[0])/(metrics.trigger_per_second/1000.0));
+                    double rate=metrics.trigger_per_second/1000.0;
+                    rate_per_msecond.push_back(rate);
+                    //lets compute the error  with the previously predicted rate
+                    if(rate_per_msecond.size()>1 && rate>0)
+                    {
+                        mape.push_back(100*fabs(rate-forecasted[0])/rate);
+                        rec_stats->addForecastStats(mape.back());
+                        CONTROL_PRINT(cout <<ANSI_COLOR_BLUE<< "[CONTROLLER] Forecasted rate (TT/ms): "<<forecasted[0]<<", measured: "<<rate<<", APE: "<<mape.back()<<"%"<<ANSI_COLOR_RESET<<endl;)
+                    }
 
                     //Predict the next rate
-                    forecast(rate_per_msecond,sd->horizon,forecasted); //NOTE: We are working on a millisecond base
+                    forecaster->update(rate);
+                    forecaster->forecast(sd->horizon,forecasted); //NOTE: We are working on a millisecond base
 
                     forecasts.push_back(forecasted[0]);
                     //compute the kingman scaling function (ksf)
@@ -332,11 +387,12 @@ void *controller (void *args)
                     }
 
                     long start_pred=current_time_usecs();
+                    bool solve_completed=true;
 
                     //resp time
                     if(sd->type==StrategyType::LATENCY)
                     {
-                        predict_reconf_rt(sd,max_workers,num_workers,forecasted,metrics.module_tcalc,metrics.c_arr,metrics.c_serv,ksf,pred_trajectory,&exp_rt, &kingman_prev);
+                        solve_completed=predict_reconf_rt(sd,max_workers,num_workers,forecasted,metrics.module_tcalc,metrics.c_arr,metrics.c_serv,ksf,pred_trajectory,&exp_rt, &kingman_prev);
                         //TMP just for statics and check the kingman evaluation
 
                         //ATTENTION: The actual service time is given by the average tcalc/N
@@ -347,7 +403,7 @@ void *controller (void *args)
 
                     if(sd->type==StrategyType::LATENCY_ENERGY)
                     {
-                        predict_reconf_energy_rt(sd,max_workers,available_frequencies,voltages, num_workers,current_frequency,forecasted,metrics.module_tcalc,metrics.c_arr,metrics.c_serv,ksf,pred_trajectory_energy,&exp_rt, &kingman_prev);
+                        solve_completed=predict_reconf_energy_rt(sd,max_workers,available_frequencies,voltages, num_workers,current_frequency,forecasted,metrics.module_tcalc,metrics.c_arr,metrics.c_serv,ksf,pred_trajectory_energy,&exp_rt, &kingman_prev);
                         king_values.push_back(kingman_prev+metrics.module_tcalc);
                         exp_resp_times.push_back(exp_rt);
                     }
@@ -355,7 +411,9 @@ void *controller (void *args)
                     // predict_reconf_nc(PRED_HORIZON, max_workers,num_workers,forecasted,module_tcalc, max_tcalc_sum,  rt_max_threshold,  nc_sf, pred_trajectory, &exp_max_rt, &nc_prev);
                     // printf("According to the strategy the next par degree should be: %d, Expected max rt: %f NC:%f\n",pred_trajectory[0],exp_max_rt,nc_prev);
 
-                    CONTROL_PRINT(cout <<ANSI_COLOR_BLUE<< "[CONTROLLER] Strategy resolution time (usec): "<<(current_time_usecs()-start_pred)<<ANSI_COLOR_RESET<<endl;)
+                    long solve_usecs=current_time_usecs()-start_pred;
+                    rec_stats->addSolveStats(solve_usecs,solve_completed);
+                    CONTROL_PRINT(cout <<ANSI_COLOR_BLUE<< "[CONTROLLER] Strategy resolution time (usec): "<<solve_usecs<<(solve_completed?"":" (budget expired)")<<ANSI_COLOR_RESET<<endl;)
 
                     //w/o energy
                     if( sd->type==StrategyType::LATENCY)
@@ -405,6 +463,12 @@ void *controller (void *args)
                 }
                 if(n_opt>max_workers) //we have not sufficient resource
                     n_opt=max_workers;
+                if(trace)
+                {
+                    trace_step.n_opt=n_opt;
+                    if(freq_opt!=0)
+                        trace_step.freq_opt=freq_opt;
+                }
 
                 /*
                     Take note of the energy consumed (just before applying some reconfiguration)
@@ -454,9 +518,12 @@ void *controller (void *args)
                     }
 
 
-                    //cleanup: delete old monitoring message
+                    //cleanup: release old monitoring message
                     for(int i=0;i<num_workers;i++)
-                        delete(wm[i]);
+                    {
+                        wm[i]->release();
+                        wm[i]=nullptr;
+                    }
 
                     int changes=n_opt-num_workers;
                     threads_spawned+=changes;
@@ -493,24 +560,33 @@ void *controller (void *args)
                         if(rho_max>MAX_RHO_WORKER || rho_max/rho_min>1+((double)MAX_RHO_UNBALANCE_PERCENTAGE)/100.0)
                             reconfigure=true;
 
+                        msg::ReconfEmitter *reconf_data_em=nullptr;
+                        int moved=0;
                         if(reconfigure && sd->type!=StrategyType::TPDS) //do no take it into account for the tpds strategy
+                        {
+                            //create the message: scheduling table is copied since still used by the emitter
+                            reconf_data_em=new msg::ReconfEmitter(0,num_classes,em-> scheduling_table);
+                            moved=compute_st(reconf_data_em->scheduling_table);
+                            if(moved==0) //the imbalance can not be reduced by moving classes
+                            {
+                                delete reconf_data_em;
+                                reconfigure=false;
+                            }
+                        }
+                        if(reconfigure && sd->type!=StrategyType::TPDS)
                         {
                                 num_rebalancing++;
+                                rec_stats->addMigrationStats(moved);
                                 reconf_at_step[monitoring_step]=true;
                                 reconf_start_t=current_time_usecs();
-                                //create the message: scheduling table is copied since still used by the emitter
-
-                                msg::ReconfEmitter *reconf_data_em=new msg::ReconfEmitter(0,num_classes,em-> scheduling_table);
-                                CONTROL_PRINT(cout<< ANSI_COLOR_BLUE_REVERSE "[CONTROLLER] Rebalancing classes... " ANSI_COLOR_RESET<<endl;)
-                                compute_fb_st(num_workers, num_classes,metrics.weighted_tcalc_per_class,reconf_data_em->scheduling_table);
-//                                 compute_st_flux(num_workers, num_workers, num_classes,metrics.weighted_tcalc_per_class,reconf_data_em->scheduling_table);
+                                CONTROL_PRINT(cout<< ANSI_COLOR_BLUE_REVERSE "[CONTROLLER] Rebalancing classes ("<<moved<<" moved)... " ANSI_COLOR_RESET<<endl;)
 
                                 bsend(reconf_data_em,e_outqueue);
 
                                 //wait for the reply from the emitter
                                 do
                                 {
-                                    delete(em);
+                                    em->release();
                                     receive((void **)&em,e_inqueue);
                                 }while((em->tag!=msg::MonitoringTag::RECONF_FINISHED_TAG));
                                 //QUI DOVREMMO GARANTIRE CHE UNA NUOVA RICONFIGURAZIONI NON INIZI PRIMA CHE LA PRECEDENTE TERMINI
@@ -518,8 +594,11 @@ void *controller (void *args)
                                 repository->waitReconfFinished();
                                 CONTROL_PRINT(cout << ANSI_COLOR_CYAN << "[CONTROLLER] Reconfiguration finished in "<< current_time_usecs()-reconf_start_t<<" usecs"<<endl;)
 
-                                delete(em);
-                                delete(cm);
+                                em->release();
+
+                                em=nullptr;
+                                cm->release();
+                                cm=nullptr;
                         }
                         else
                             reconf_at_step[monitoring_step]=false;
@@ -546,60 +625,20 @@ void *controller (void *args)
                             //create the message for emitter:
                             msg::ReconfEmitter *reconf_data_em=new msg::ReconfEmitter(changes,num_classes,em-> scheduling_table);
                             msg::ReconfCollector *reconf_data_c=new msg::ReconfCollector(changes);
-                            worker_data=(worker_data_t *)malloc(sizeof(worker_data_t)*changes);
-
 
+                            //the replicas are already spawned and their queues allocated: publish the queues and unpark them
                             for(int i=0;i<changes;i++)
                             {
-                                reconf_data_em->wqueues[i]=new SWSR_Ptr_Buffer(QUEUE_SIZE);
-                                reconf_data_em->wqueues[i]->init();
-                                reconf_data_c->wqueues[i]=new SWSR_Ptr_Buffer(QUEUE_SIZE);
-                                reconf_data_c->wqueues[i]->init();
-                                //assuming that there is enough space, define queue worker->controller
-                                w_inqueue[num_workers+i]=new SWSR_Ptr_Buffer(QUEUE_SIZE_MON);
-                                w_inqueue[num_workers+i]->init();
-                            }
-
-                            //thread spawning
-                            for(int i=0;i<changes;i++)
-                            {
-                                pthread_t tid;
-                                worker_data[i].workerId = i+num_workers;
-                                worker_data[i].inqueue = reconf_data_em->wqueues[i];
-                                worker_data[i].outqueue = reconf_data_c->wqueues[i];
-                                worker_data[i].barrier=NULL; //in this way, newly spawned threads will not perform wait on barrier
-                                worker_data[i].window_size=window_size;
-                                worker_data[i].window_slide=window_slide;
-                                worker_data[i].freq=freq;
-                                worker_data[i].num_classes=num_classes;
-                                worker_data[i].start_global_ticks=start_global_ticks;
-                                worker_data[i].sd=sd;
-                                #if defined(USE_FFALLOC)
-                                    worker_data[i].ffalloc=ffalloc;
-                                #endif
-
-                                worker_data[i].cn_outqueue=w_inqueue[num_workers+i];
-                                worker_data[i].repository=repository;
-                                pthread_create(&tid, NULL, worker, &(worker_data[i]));
-                                //set CPU affinity of worker threads
-                                CPU_ZERO(&cpuset);
-                                CPU_SET(affinities[i+num_workers], &cpuset);
-
-                                if (pthread_setaffinity_np(tid, sizeof(cpu_set_t), &cpuset)) {
-                                    cerr << "Cannot set thread to CPU " << i << endl;
-                                }
-                                //worker_data[i].num_workers = num_workers;
-                                wtids[tid_idx] = tid;
-                                tid_idx++;
+                                reconf_data_em->wqueues[i]=pool->getInQueue(num_workers+i);
+                                reconf_data_c->wqueues[i]=pool->getOutQueue(num_workers+i);
+                                w_inqueue[num_workers+i]=pool->getMonitoringQueue(num_workers+i);
+                                pool->activate(num_workers+i);
                             }
 
                             num_workers+=changes;
 
-                            //compute the optimal scheduling table and the expected load (load_w will containt the expected wtcalc_per_worker)
-
-                            compute_fb_st(num_workers, num_classes,metrics.weighted_tcalc_per_class,reconf_data_em->scheduling_table);
-
-                            //compute_st_flux(num_workers, num_workers-changes,num_classes,metrics.weighted_tcalc_per_class,reconf_data_em->scheduling_table);
+                            //move to the new replicas only the classes needed for balancing the load
+                            rec_stats->addMigrationStats(compute_st(reconf_data_em->scheduling_table));
 
 
                             //send the data toward the emitter
@@ -610,7 +649,7 @@ void *controller (void *args)
                             //delete the previous message received from the emitter
                             do
                             {
-                                delete(em); //delete previous uneeded message
+                                em->release(); //release previous uneeded message
                                 receive((void **)&em,e_inqueue);
                                 //fprintf(stderr,"Reconfiguration error\n");
                                 //exit(RECONF_ERR);
@@ -622,7 +661,7 @@ void *controller (void *args)
                             }
                             do
                             {
-                                delete(cm); //delete previous uneeded message
+                                cm->release(); //release previous uneeded message
                                 receive((void **)&cm,c_inqueue);
                             }while((cm->tag!=msg::MonitoringTag::RECONF_FINISHED_TAG && cm->tag!=msg::MonitoringTag::EOS_TAG));
                             if(cm->tag==msg::MonitoringTag::EOS_TAG)
@@ -639,8 +678,10 @@ void *controller (void *args)
                             CONTROL_PRINT(cout << ANSI_COLOR_YELLOW "[CONTROLLER] increased par degree in " << current_time_usecs()-reconf_start_t<<" usecs" ANSI_COLOR_RESET<<endl;)
 
                             //message cleenup
-                            delete(em);
-                            delete(cm);
+                            em->release();
+                            em=nullptr;
+                            cm->release();
+                            cm=nullptr;
                         }
                         //else an EOS has arrived, don't do anything
                     }
@@ -660,10 +701,8 @@ void *controller (void *args)
 
                             num_workers+=changes;
 
-                            //compute the new scheduling table
-                            compute_fb_st(num_workers, num_classes,metrics.weighted_tcalc_per_class,reconf_data_em->scheduling_table);
-    //                         compute_st_flux(num_workers,num_workers-changes, num_classes,metrics.weighted_tcalc_per_class,reconf_data_em->scheduling_table);
-                             //
+                            //compute the new scheduling table: the classes of the removed replicas are moved, the others only if needed for balancing the load
+                            rec_stats->addMigrationStats(compute_st(reconf_data_em->scheduling_table));
                             //send the data toward the emitter
                             bsend(reconf_data_em,e_outqueue);
 
@@ -674,7 +713,7 @@ void *controller (void *args)
                             //wait for the reply from the emitter
                             do
                             {
-                                delete(em);
+                                em->release();
                                 receive((void **)&em,e_inqueue);
                                 //fprintf(stderr,"Reconfiguration error\n");
                                 //exit(RECONF_ERR);
@@ -687,7 +726,7 @@ void *controller (void *args)
                             //printf("Controller: emitter ha finito\n");
                             do
                             {
-                                delete(cm);
+                                cm->release();
                                 receive((void **)&cm,c_inqueue);
                             }while((cm->tag!=msg::MonitoringTag::RECONF_FINISHED_TAG && cm->tag!=msg::MonitoringTag::EOS_TAG));
                             if(cm->tag==msg::MonitoringTag::EOS_TAG)
@@ -704,37 +743,43 @@ void *controller (void *args)
                                 //receive the last message (while exiting) by the workers that have been removed
                                 do
                                 {
-
-                                    receiveLast((void **)&wm[i],w_inqueue[i]);
+                                    if(wm[i]!=nullptr)
+                                        wm[i]->release();
+                                    msg::receiveLast(&wm[i],w_inqueue[i]);
         //                            std::cout << "tag: "<<(wm[i]->tag==msg::MonitoringTag::EOS_TAG?0:-1)<<std::endl;
                                 }while(wm[i]->tag!=msg::MonitoringTag::EOS_TAG);
-                                //free queue from workers
-                                delete(w_inqueue[i]);
-                                delete(wm[i]);
+                                wm[i]->release();
+                                wm[i]=nullptr;
 
                                 w_inqueue[i]=NULL;
-                                if(tid_idx>0)
-                                    tid_idx--;
+                                //new queues (and result buffer) for the next activation of this replica
+                                pool->prepare(i);
                             }
 
                             CONTROL_PRINT(cout<<ANSI_COLOR_YELLOW<< "[CONTROLLER] decreased par degree in "<<current_time_usecs()-reconf_start_t<<" usecs"<< ANSI_COLOR_RESET<<endl;)
                             //message cleenup
-                            delete(em);
-                            delete(cm);
+                            em->release();
+                            em=nullptr;
+                            cm->release();
+                            cm=nullptr;
                         }
                     }
                 }
             }
 		}
+        if(trace_step_valid)
+        {
+            trace->write(trace_step);
+            trace_step_valid=false;
+        }
 		monitoring_step++;		
 	}
+    if(trace)
+        delete trace;
+    if(overrides)
+        free(overrides);
 
-	//wait for the threads that have been spawned
-	// Wait for the completion of the threads
-    void *retval ;
-    for (int i = 0; i < tid_idx; i++) {
-        pthread_join(wtids[i], &retval);
-    }
+	//the replicas are joined by the main (see ReplicaPool::shutdown)
 
 	//print to file classes statistics
     /*char out_file[100];
@@ -756,62 +801,11 @@ void *controller (void *args)
         }
 
     }
+    */
     //save the numb of class rebalancing
-    rec_stats->setNumClassRebalancing(num_rebalancing);*/
+    rec_stats->setNumClassRebalancing(num_rebalancing);
+    if(sd->predictive)
+        delete forecaster;
 
     return rec_stats;
 }
-
-//HWFilter filter;
-//for the real dataset alpha=0.67, beta=0.26
-
-//const double holt_winter_alpha=1;             //alpha parameter of the HoltWinter filter
-//const double holt_winter_beta=0.015;              //beta parameter 0.015 for rw, 0.9 for sin
-inline void forecast(vector<double> obs_v,int h, double *forecasted)
-{
-
-    /*
-        Simple Moving Average (SMA) VERSION
-    */
-     int length=3;
-
-    if(obs_v.size()<length)
-    {
-        forecasted[0]=obs_v[obs_v.size()-1];
-        return;
-    }
-    for(int i=0;i<h;i++)
-    {
-        forecasted[i]=0;
-        //add the obs value
-        for(int j=0;j<length-i;j++)
-        {
-            //printf("Step: %d, i: %d, aggiungo l'elemento: %d\n",i,obs_v.size(),obs_v.size()-length+j+i);
-            forecasted[i]+=obs_v[obs_v.size()-length+j+i];
-        }
-        //add the already forecasted values (they are h+1)
-        for(int j=0;j<i;j++)
-        {
-            forecasted[i]+=forecasted[j];
-        }
-        forecasted[i]/=length;
-    }
-
-    /*
-        Holt Winter version
-    */
-
-   /* if(obs_v.size()<2) //not enough data
-    {
-        forecasted[0]=obs_v[obs_v.size()-1];
-        return;
-    }
-    if(obs_v.size()==2)		//we can initialize the filter
-        filter.initialize(holt_winter_alpha,holt_winter_beta,obs_v[0],obs_v[1]-obs_v[0]);
-    else
-        filter.updateSample(obs_v[obs_v.size()-1]);
-
-    filter.forecast(forecasted,h);*/
-
-}
-
@@ -46,6 +46,7 @@
 #include "../includes/strategy_descriptor.hpp"
 #include "../includes/statistics.hpp"
 #include "../includes/utils.h"
+#include "../includes/replica_pool.hpp"
 
 using namespace ff;
 using namespace std;
@@ -74,13 +75,11 @@ int main(int argc, char *argv[])
         Repository *repository; //repository that will contain all the structures needed for reconfigurations
 	#endif
 	//arguments for threads
-	worker_data_t *worker_data;
 	emitter_data_t emitter_data;
 	collector_data_t collector_data;
 	controller_data_t controller_data;
 
 	//threads ids
-	pthread_t *wtids;
 	pthread_t ctid,cntid;
 
     //stats returned by controller and collector
@@ -101,6 +100,7 @@ int main(int argc, char *argv[])
     window_slide=atoi(argv[5]);
     //read strategy config file
     StrategyDescriptor *sd=new StrategyDescriptor(argv[6]);
+    set_wait_policy(sd->wait_policy);
 
 	assert(window_size%window_slide==0);
     #ifndef MONITORING
@@ -115,6 +115,9 @@ int main(int argc, char *argv[])
     int max_workers=core_ids->size()-4;
     int emitter_affinity=core_ids->at(1);
 #endif
+    //the scheduling table can not address more replicas
+    if(max_workers>MAX_REPLICAS)
+        max_workers=MAX_REPLICAS;
 
     //da gestire il caso generatore sulla stessa macchina
     int collector_affinity=core_ids->at(core_ids->size()-2);
@@ -173,6 +176,9 @@ int main(int argc, char *argv[])
 		quCNC=new SWSR_Ptr_Buffer(QUEUE_SIZE_MON);
 		quCNC->init();
        repository=new Repository(max_workers,num_classes);
+       //preallocated monitoring messages: they outlive the entities since the controller releases them
+       msg::MonitoringRing<msg::EmitterMonitoring> *e_mon_ring=new msg::MonitoringRing<msg::EmitterMonitoring>(num_classes);
+       msg::MonitoringRing<msg::CollectorMonitoring> *c_mon_ring=new msg::MonitoringRing<msg::CollectorMonitoring>(num_classes);
     #endif
 
 	#ifdef QSPLITTED
@@ -180,18 +186,8 @@ int main(int argc, char *argv[])
 	#else
 	int qsize=QUEUE_SIZE;
 	#endif	
-	//We initialize up to the actual par degree (not the maximum one)
-	for (i = 0; i < num_workers; i++) {
-		quEW[i] = new SWSR_Ptr_Buffer(qsize);
-		quEW[i]->init();
-		quWC[i] = new SWSR_Ptr_Buffer(qsize); //technically we could reduce this
-		quWC[i]->init();
-		#if defined(MONITORING)
-			quWCN[i]=new SWSR_Ptr_Buffer(QUEUE_SIZE_MON);
-			quWCN[i]->init();
-		#endif
-	}
-	
+	//the workers signal to the collector which of them have pushed results
+	ReadyMask *ready_mask=new ReadyMask(max_workers);
 
 	ticks *start_global_ticks=(ticks*)calloc(1,sizeof(ticks));
     long *first_tuple_timestamp=(long *)calloc(1,sizeof(long));
@@ -217,40 +213,32 @@ int main(int argc, char *argv[])
 	/**
 		Threads creations
 	*/
-	//Workers creation
-	wtids = (pthread_t*) malloc(num_workers * sizeof(pthread_t));
-	worker_data =(worker_data_t*) malloc(num_workers * sizeof(worker_data_t));
-	for (i = 0; i < num_workers; i++) {		
-		pthread_t tid;
-		worker_data[i].workerId = i;
-		worker_data[i].inqueue = quEW[i];
-		worker_data[i].outqueue = quWC[i];
-
-		worker_data[i].barrier=&barrier;
-		worker_data[i].window_size=window_size;
-		worker_data[i].window_slide=window_slide;
-		worker_data[i].start_global_ticks=start_global_ticks;
-		//worker_data[i].comp_time=comp_time;
-        worker_data[i].freq=freq;
-		worker_data[i].num_classes=num_classes;
-        worker_data[i].sd=sd;
-        #if defined(USE_FFALLOC)
-			worker_data[i].ffalloc=ffalloc;
-		#endif
+	//Workers: all the max_workers replicas are spawned (and pinned) now, the ones
+	//that are not initially used are parked (see replica_pool.hpp)
+	worker_data_t worker_templ;
+	memset(&worker_templ,0,sizeof(worker_data_t));
+	worker_templ.window_size=window_size;
+	worker_templ.window_slide=window_slide;
+	worker_templ.start_global_ticks=start_global_ticks;
+	worker_templ.freq=freq;
+	worker_templ.num_classes=num_classes;
+	worker_templ.sd=sd;
+	worker_templ.ready_mask=ready_mask;
+	#if defined(USE_FFALLOC)
+		worker_templ.ffalloc=ffalloc;
+	#endif
+	#if defined(MONITORING)
+		worker_templ.repository=repository;
+	#endif
+	ReplicaPool *pool=new ReplicaPool(max_workers,qsize,worker_templ,affinities);
+	//We initialize up to the actual par degree (not the maximum one)
+	for (i = 0; i < num_workers; i++) {
+		quEW[i]=pool->getInQueue(i);
+		quWC[i]=pool->getOutQueue(i);
 		#if defined(MONITORING)
-			worker_data[i].cn_outqueue=quWCN[i];
-            worker_data[i].repository=repository;
+			quWCN[i]=pool->getMonitoringQueue(i);
 		#endif
-		pthread_create(&tid, NULL, worker, &(worker_data[i]));
-		//set CPU affinity of worker threads
-		CPU_ZERO(&cpuset);
-		CPU_SET(affinities[i], &cpuset);
-
-		if (pthread_setaffinity_np(tid, sizeof(cpu_set_t), &cpuset)) {
-			cerr << "Cannot set thread to CPU " << i << endl;
-		}
-		//worker_data[i].num_workers = num_workers;
-		wtids[i] = tid;
+		pool->activate(i,&barrier);
 	}
 
 	//collector creation
@@ -264,12 +252,15 @@ int main(int argc, char *argv[])
     collector_data.start_global_usecs=start_global_usecs;
     collector_data.first_tuple_timestamp=first_tuple_timestamp;
 	collector_data.suffix=suffix;
+	collector_data.window_size=window_size;
 	collector_data.window_slide=window_slide;
 	collector_data.max_workers=max_workers;
     collector_data.sd=sd;
+    collector_data.ready_mask=ready_mask;
 	#if defined(MONITORING)
 		collector_data.cn_outqueue=quCCN;
 		collector_data.cn_inqueue=quCNC;
+        collector_data.mon_ring=c_mon_ring;
 	#endif
 	pthread_create(&ctid, NULL, collector, &collector_data);
 	//set CPU affinity of collector thread
@@ -299,6 +290,7 @@ int main(int argc, char *argv[])
 	controller_data.start_global_ticks=start_global_ticks;
     controller_data.start_global_usecs=start_global_usecs;
     controller_data.sd=sd;
+    controller_data.pool=pool;
     #if defined(USE_FFALLOC)
 		controller_data.ffalloc=ffalloc;
 	#endif
@@ -314,6 +306,7 @@ int main(int argc, char *argv[])
 	#endif
 	// Start working as emitter
 	emitter_data.num_workers=num_workers;
+	emitter_data.max_workers=max_workers;
 	emitter_data.num_classes=num_classes;
 	emitter_data.port=port;
 	emitter_data.outqueue=quEW;
@@ -333,6 +326,7 @@ int main(int argc, char *argv[])
 		emitter_data.cn_outqueue=quECN;
 		emitter_data.cn_inqueue=quCNE;
         emitter_data.repository=repository;
+        emitter_data.mon_ring=e_mon_ring;
 	#endif
 	// Set my affinity
 	CPU_ZERO(&cpuset);
@@ -346,9 +340,6 @@ int main(int argc, char *argv[])
 
 	// Wait for the completion of the threads
 	void *retval ;
-	for (i = 0; i < num_workers; i++) {
-		pthread_join(wtids[i], &retval);
-	}
 
     //wait for controller
 
@@ -360,6 +351,8 @@ int main(int argc, char *argv[])
     rec_stat=(stats::ReconfigurationStatistics *)retval;
 
 	#endif
+	//no more replicas can be activated: wait for the active ones and terminate the parked ones
+	pool->shutdown();
     char out_file[100];
     //sprintf(out_file,"stats_%s.dat",suffix);
     sprintf(out_file,"stats.dat",suffix);
@@ -378,7 +371,7 @@ int main(int argc, char *argv[])
     }
     else
     {
-        fprintf(fout,"#Second\tNum_res\tLatency\tLatency-95-Perc\tNum_replicas\tCpu_Freq\tCore_Joules\tCpu_Joules\n");
+        fprintf(fout,"#Second\tNum_res\tLatency\tLatency-95-Perc\tNum_replicas\tCpu_Freq\tCore_Joules\tCpu_Joules\tSolve_usecs\tForecast_APE\tMoved_keys\n");
         //merge the two statistics and print them to file
         //assuming that collector stats are reported on a second basis
         //and that control step is multiple of second
@@ -391,6 +384,7 @@ int main(int argc, char *argv[])
         int last_par_deg=-1;
         int last_freq=-1;
         double reconf_amplitude=0;
+        int moved_j=-1;
 
         //same step for printing and control (at most one stat of difference)
 
@@ -400,7 +394,10 @@ int main(int argc, char *argv[])
                 j++;
             fprintf(fout,"%-6.3f\t%-6Ld\t%-6.4f\t%-6.4f\t",coll_stats->getTime(i),coll_stats->getRecvResults(i),coll_stats->getLatency(i),coll_stats->getLatencyPercentile95(i));
             fprintf(fout,"%-6d\t%-6d\t",rec_stat->getParDegree(j),(int)rec_stat->getFrequency(j));
-            fprintf(fout,"%-6.3f\t%-6.3f\n",rec_stat->getJouleCore(j),rec_stat->getJouleCpu(j));
+            fprintf(fout,"%-6.3f\t%-6.3f\t%-6.0f\t%-6.2f\t",rec_stat->getJouleCore(j),rec_stat->getJouleCpu(j),rec_stat->getSolveTime(j),rec_stat->getForecastError(j));
+            //the keys moved in a control step are reported only once
+            fprintf(fout,"%-6d\n",(j!=moved_j)?rec_stat->getMovedClasses(j):0);
+            moved_j=j;
             //we add also stat on the latencies, needed for testing (not used here)
             //fprintf(fout,"%-6.3f\t%-6.3f\t%-6.3f\n",coll_stats->getLatencyPercentile99(i),coll_stats->getLatencyTop(i),coll_stats->getStdDev(i));
             if(sd->type==StrategyType::LATENCY  || sd->type == StrategyType::LATENCY_RULE || sd->type==StrategyType::LATENCY_ENERGY) //check violation to latency threshold
@@ -428,6 +425,10 @@ int main(int argc, char *argv[])
 
         fprintf(fout,"#Total number of reconfigurations:      %d\n",rec_stat->getTotReconf());
         fprintf(stdout,"#Total number of reconfigurations:      %d\n",rec_stat->getTotReconf());
+        fprintf(fout,"#Rebalancings of the keys:              %d\n",rec_stat->getNumClassRebalances());
+        fprintf(stdout,"#Rebalancings of the keys:              %d\n",rec_stat->getNumClassRebalances());
+        fprintf(fout,"#Keys moved between replicas:           %ld\n",rec_stat->getTotMovedClasses());
+        fprintf(stdout,"#Keys moved between replicas:           %ld\n",rec_stat->getTotMovedClasses());
         if(sd->type==StrategyType::LATENCY_ENERGY)
         {
             fprintf(fout,"#Adjustments to the number of replicas: %d\n",rec_stat->getParDegreeReconf());
@@ -451,6 +452,15 @@ int main(int argc, char *argv[])
         fprintf(stdout,"#Average Watt consumed:                 %f\n",rec_stat->getTotJoulesCore()/(coll_stats->getTime(coll_stats->getStatsNumber()-1)-coll_stats->getTime(0))); //joules per second
         fprintf(fout,"#Reconfiguration amplitude:             %.3f\n",reconf_amplitude/rec_stat->getTotReconf());
         fprintf(stdout,"#Reconfiguration amplitude:             %.3f\n",reconf_amplitude/rec_stat->getTotReconf());
+        if(sd->predictive)
+        {
+            fprintf(fout,"#Strategy resolution time (usecs):      avg %.1f, max %.0f\n",rec_stat->getAvgSolveTime(),rec_stat->getMaxSolveTime());
+            fprintf(stdout,"#Strategy resolution time (usecs):      avg %.1f, max %.0f\n",rec_stat->getAvgSolveTime(),rec_stat->getMaxSolveTime());
+            fprintf(fout,"#Resolutions over the time budget:      %d\n",rec_stat->getSolveOverBudget());
+            fprintf(stdout,"#Resolutions over the time budget:      %d\n",rec_stat->getSolveOverBudget());
+            fprintf(fout,"#Forecast MAPE:                         %.2f%%\n",rec_stat->getMAPE());
+            fprintf(stdout,"#Forecast MAPE:                         %.2f%%\n",rec_stat->getMAPE());
+        }
         fprintf(fout,"#Strategy: %s\n",sd->toString());
 
     }
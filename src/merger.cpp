@@ -44,6 +44,9 @@
 #include "../includes/messages.hpp"
 #include "../includes/statistics.hpp"
 #include "../includes/strategy_descriptor.hpp"
+#include "../includes/channel.hpp"
+#include "../includes/reorder_buffer.hpp"
+#include "../includes/pane.hpp"
 
 using namespace ff;
 using namespace std;
@@ -62,6 +65,7 @@ void * collector(void *args) {
     int partial_rcvd=0;
     long start_usecs,last_print;
     long  print_rate=(long)PRINT_RATE*1000; //NON TOCCARE, ALTRIMENTI DEVI SISTEMARE IL CALCOLO DELLA LATENZA MONITORATA
+	int window_size=data->window_size;
 	int window_slide=data->window_slide;
 	int num_workers=data->num_workers;
 	int num_classes=data->num_classes;
@@ -69,20 +73,25 @@ void * collector(void *args) {
     StrategyDescriptor *sd=data->sd;
 
 
-	//vector for computing response time percentile (maybe we can find something more efficient)
-	vector<double> percentile_lat;
+	//distribution of latencies for computing percentiles: since the last print and of the whole run
+    stats::LatencyHistogram lat_hist;
+    stats::LatencyHistogram run_lat_hist;
+    #if defined(PER_KEY_LATENCY)
+    stats::LatencyHistogram *key_lat_hist=new stats::LatencyHistogram[num_classes];
+    #endif
 	//Ordering variables
 	//expected internal id for the received results (it will be used for correctness)
     int64_t *expected_iid=new int64_t[num_classes]();
-	//number of results received disordered partial results for each class
-    int *disordered=new int[num_classes]();
-	//buffer for results received out of order
-    vector<vector<winresult_t>> buffer_disordered;
+	//buffers for results received out of order (one for each class)
+    ReorderBuffer *reorder=new ReorderBuffer[num_classes];
     //initialize them
     for(int i=0;i<num_classes;i++)
+    {
         expected_iid[i]=window_slide-1; //since the ids start from 0
-    for(int i=0;i<num_classes;i++)
-        buffer_disordered.emplace_back(5);
+        reorder[i].setWindowSlide(window_slide);
+    }
+    //results of the split classes are computed from the summaries of their panes (allocated at the first one received)
+    SplitKeyMerger **split=new SplitKeyMerger*[num_classes]();
 
 	//latencies, percentiles, actual par degree... all these metrics are printed in a file
 	//at the end of the program (on a second basis)
@@ -103,6 +112,10 @@ void * collector(void *args) {
 
 	pthread_barrier_t *barrier = data->barrier;
 	SWSR_Ptr_Buffer **inqueue=data->inqueue;
+    //results are popped in batches from the replicas' queues
+    ChannelReader *readers=new ChannelReader[max_workers];
+    for(int i=0;i<num_workers;i++)
+        readers[i].init(inqueue[i],sd->channel_batch);
     //the queue for sending monitoring data to the controller
     SWSR_Ptr_Buffer *cn_outqueue=data->cn_outqueue;
 
@@ -110,13 +123,14 @@ void * collector(void *args) {
     long monitoring_timer;
     long monitoring_step_usecs=sd->control_step*1000; //express it in usecs
     msg::CollectorMonitoring *monitoring=nullptr;
+    msg::MonitoringRing<msg::CollectorMonitoring> *mon_ring=data->mon_ring;
     SWSR_Ptr_Buffer *cn_inqueue=nullptr;
     msg::ReconfCollector *reconf_data;
     bool reconf_phase_pard_down=false; //if it is true, it means that we are in a reconfiguration phase in which we have to terminate some worker
-    char work_down_degree;
+    int work_down_degree;
 
     #if defined(MONITORING)
-        monitoring=new msg::CollectorMonitoring(num_classes);
+        monitoring=mon_ring->next();
         if(sd->type!=StrategyType::NONE)
         {
 			//in the case of the adaptive version we have also incoming data (the reconfiguration commands) from the controller
@@ -151,19 +165,138 @@ void * collector(void *args) {
     last_print=start_global_usecs;
     start_usecs=current_time_usecs();
 
+    //The merger does not poll the replicas' queues: the replicas signal on the ready mask that
+    //they have pushed something. A round visits all the signalled replicas (taken at once from the mask),
+    //each one drained of up to MERGER_MAX_DRAIN results
+    ReadyMask *ready_mask=data->ready_mask;
+    int mask_words=ready_mask->getNumWords();
+    uint64_t *to_visit=new uint64_t[mask_words](); //replicas still to be visited in the current round
+    int drained=0; //results received from the current replica (index)
+    index=-1;
+    auto next_result=[&]()->bool{
+        if(index>=0)
+        {
+            if(inqueue[index]!=NULL && drained<MERGER_MAX_DRAIN && readers[index].pop((void **)&rcvd))
+            {
+                drained++;
+                return true;
+            }
+            if(drained>=MERGER_MAX_DRAIN) //it may still have results, visit it again in the next round
+                ready_mask->set(index);
+            index=-1;
+        }
+        for(int round=0;round<2;round++)
+        {
+            for(int w=0;w<mask_words;w++)
+            {
+                while(to_visit[w]!=0)
+                {
+                    int i=w*64+__builtin_ctzll(to_visit[w]);
+                    to_visit[w]&=to_visit[w]-1;
+                    if(inqueue[i]!=NULL && readers[i].pop((void **)&rcvd)) //the queue may have been removed
+                    {
+                        index=i;
+                        drained=1;
+                        return true;
+                    }
+                }
+            }
+            //start a new round
+            for(int w=0;w<mask_words;w++)
+                to_visit[w]=ready_mask->take(w);
+        }
+        return false;
+    };
+
+    //timers are checked with the TSC, and at most every MERGER_TIMER_CHECK results (or when idle)
+    int results_since_check=0;
+    ticks now_ticks=getticks();
+    ticks print_step_ticks=(ticks)print_rate*freq;
+    long delay=last_print+print_rate-current_time_usecs();
+    ticks print_timer_ticks=now_ticks+(delay>0?delay*freq:0);
+    #if defined(MONITORING)
+    ticks monitoring_step_ticks=(ticks)monitoring_step_usecs*freq;
+    delay=monitoring_timer-current_time_usecs();
+    ticks monitoring_timer_ticks=now_ticks+(delay>0?delay*freq:0);
+    #endif
+
+    //idle handling (see wait_policy.hpp): the merger parks on a single doorbell, rung by all its producers
+    int empty_polls=0; //consecutive polls that found nothing to receive
+    Doorbell *doorbell=nullptr;
+    bool doorbell_attached=true; //false if some producer cannot ring it (registry full): then the merger yields
+    if(wait_policy()==WaitPolicy::SPIN_FUTEX)
+    {
+        doorbell=DoorbellRegistry::create();
+        for(int i=0;i<num_workers;i++)
+            doorbell_attached&=doorbells().attach(inqueue[i],doorbell);
+        if(cn_inqueue)
+            doorbell_attached&=doorbells().attach(cn_inqueue,doorbell);
+    }
+    auto ready=[&]()->bool{
+        return ready_mask->any() || (cn_inqueue!=nullptr && !cn_inqueue->empty());
+    };
+
     long start_nsecs=current_time_nsecs();
     long last_recvd_nsecs=start_nsecs;
     long curr_nsecs;
 
+    //delivers a result in order
+    auto deliver=[&](const winresult_t *res){
+        //IN REAL IMPLEMENTATIONS, the result will be sent afterward to the next module
+        //e.g. save data to file for succesive computation
+        #if defined(SAVE_RESULTS)
+        fprintf(fresults,"%d\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",res->type,res->p0_ask,res->p1_ask,res->p2_ask,res->p0_bid,res->p1_bid,res->p2_bid);
+        fprintf(fresults_candle,"%d\tASK\t%.3f\t%.3f\t%.3f\t%.3f\n",res->type,res->open_ask,res->close_ask,res->low_ask,res->high_ask);
+        fprintf(fresults_candle,"%d\tBID\t%.3f\t%.3f\t%.3f\t%.3f\n",res->type,res->open_bid,res->close_bid,res->low_bid,res->high_bid);
+        #endif
+
+        //the latency is computed as the difference between the time elapsed from the beginning of the
+        //operator computattion and the difference between the tuples' timestamps
+        //the original timestamps are reported in usecs
+        long lat=((curr_nsecs/1000-start_global_usecs)-(res->timestamp-first_tuple_timestamp));
+
+        lat_hist.record(lat);
+        #if defined(PER_KEY_LATENCY)
+        key_lat_hist[res->type].record(lat);
+        #endif
+
+        //compute average latency and standard dev
+        dlat+=lat;
+        latency_stats.Push(lat);
+        #if defined (MONITORING)
+            monitoring->results++;
+            monitoring->results_per_class[res->type]++;
+            monitoring->latency_per_class[res->type]+=lat; //usec
+        #endif
+    };
+
+    //delivers the results of a split class that can be computed
+    auto produce_split=[&](int type){
+        winresult_t res;
+        while(split[type]->produce(expected_iid[type],res))
+        {
+            rcvd_results++;
+            partial_rcvd++;
+            recvd_per_worker[res.wid]++;
+            deliver(&res);
+            expected_iid[type]+=window_slide;
+            reorder[type].release(expected_iid[type],deliver);
+        }
+    };
+
 	while(received_EOS<num_workers) //the collector has to receive the EOS from all the workers
 	{
-		//Round-robin polling from the various workers
-		if(inqueue[index]->pop((void **)&rcvd)) 
+        bool check_timers=false;
+		//take the next result from the replicas that have signalled something
+		if(next_result())
         {
+            empty_polls=0;
+            if(++results_since_check>=MERGER_TIMER_CHECK)
+                check_timers=true;
             //cout <<"Result arrived"<<endl;
+            curr_nsecs=current_time_nsecs();
             #if defined(MONITORING)
             //save the value of service time as the time elapsed from the last reception (nsecs)
-            curr_nsecs=current_time_nsecs();
             stat_service_time.Push((curr_nsecs-last_recvd_nsecs)/1000000.0);
             last_recvd_nsecs=curr_nsecs;
 
@@ -198,16 +331,19 @@ void * collector(void *args) {
                             for(int i=0;i>reconf_data->par_degree_changes;i--) //(att: par_degree_cahnges<0)
                             {
                                 //destroy the queues
+                                if(doorbell)
+                                    doorbells().detach(inqueue[num_workers+i-1]);
                                 delete(inqueue[num_workers+i-1]);
                                 //set to NULL outqueues (they will destructed by workers)
                                 inqueue[num_workers+i-1]=NULL;
+                                readers[num_workers+i-1].bind(NULL);
                             }
 
                             //set the new num_workers
                             num_workers+=reconf_data->par_degree_changes;
                             reconf_phase_pard_down=false;
                             //send ack to the controller
-                            msg::CollectorMonitoring *reconf_finished=new msg::CollectorMonitoring(0); //we don't need additional data
+                            msg::CollectorMonitoring *reconf_finished=mon_ring->next(); //we don't need additional data
                             reconf_finished->tag=msg::MonitoringTag::RECONF_FINISHED_TAG;
                             bsend(reconf_finished,cn_outqueue);
                             DEBUG(cout<<ANSI_COLOR_YELLOW "[COLLECTOR] reconf finished" ANSI_COLOR_RESET<<endl;)
@@ -222,6 +358,14 @@ void * collector(void *args) {
                     received_EOS++;
                 }
 			}
+			else if(rcvd->pane!=NULL)
+			{
+				//summary of a pane of a split class
+				if(split[rcvd->type]==NULL)
+					split[rcvd->type]=new SplitKeyMerger(rcvd->type,window_size,window_slide);
+				split[rcvd->type]->add(rcvd);
+				produce_split(rcvd->type);
+			}
 			else
 			{
 				//standard result coming from a Worker
@@ -233,104 +377,45 @@ void * collector(void *args) {
 				{
 					//we have received a partial result out of order
 					//we have to buffer it and reuse when necessary
-					//CURRENTLY IT IS IMPLEMENTED, BUT NOT INTENSIVELY TESTED
-
-					//buffer it
                     //cerr<<"[CONTROLLER] Received partial result disordered for class: "<<rcvd->type <<" from Worker "<<index <<" expected: " << expected_iid[rcvd->type] <<" received: "<<rcvd->id <<endl;
-					//insert it into the right position (in order)
-					buffer_disordered[rcvd->type].push_back(*rcvd);
-					disordered[rcvd->type]++;
+                    reorder[rcvd->type].insert(rcvd,expected_iid[rcvd->type],deliver);
 				}
 				else
 				{
-					//IN REAL IMPLEMENTATIONS, the result will be sent afterward to the next module
-                    //e.g. save data to file for succesive computation
-                    #if defined(SAVE_RESULTS)
-                    fprintf(fresults,"%d\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",rcvd->type,rcvd->p0_ask,rcvd->p1_ask,rcvd->p2_ask,rcvd->p0_bid,rcvd->p1_bid,rcvd->p2_bid);
-                    fprintf(fresults_candle,"%d\tASK\t%.3f\t%.3f\t%.3f\t%.3f\n",rcvd->type,rcvd->open_ask,rcvd->close_ask,rcvd->low_ask,rcvd->high_ask);
-                    fprintf(fresults_candle,"%d\tBID\t%.3f\t%.3f\t%.3f\t%.3f\n",rcvd->type,rcvd->open_bid,rcvd->close_bid,rcvd->low_bid,rcvd->high_bid);
-                    #endif
-
-                    //the latency is computed as the difference between the time elapsed from the beginning of the
-                    //operator computattion and the difference between the tuples' timestamps
-                    //the original timestamps are reported in usecs
-
-                    long lat=((current_time_usecs()-start_global_usecs)-(rcvd->timestamp-first_tuple_timestamp));
-
-					percentile_lat.push_back(lat);
-
-                    //compute average latency and standard dev
-					dlat+=lat;
-                    latency_stats.Push(lat);
-					#if defined (MONITORING)
-                        monitoring->results++;
-                        monitoring->results_per_class[rcvd->type]++;
-                        monitoring->latency_per_class[rcvd->type]+=lat; //usec
-					#endif
+                    deliver(rcvd);
 					expected_iid[rcvd->type]+=window_slide;
-
-					if(disordered[rcvd->type]>0) //previously we received disordered results: the idea is that we sent all the results
-					{
-						//look if there is the next in the vector
-						for(int i=0;i<buffer_disordered[rcvd->type].size();i++)
-						{
-							if(buffer_disordered[rcvd->type][i].id==expected_iid[rcvd->type])
-							{
-								//ok it is the right one
-								//send afterwards
-								//....
-                                #if defined(SAVE_RESULTS)
-                                fprintf(fresults,"%d\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n",rcvd->type,rcvd->p0_ask,rcvd->p1_ask,rcvd->p2_ask,rcvd->p0_bid,rcvd->p1_bid,rcvd->p2_bid);
-                                fprintf(fresults_candle,"%d\tASK\t%.3f\t%.3f\t%.3f\t%.3f\n",rcvd->type,rcvd->open_ask,rcvd->close_ask,rcvd->low_ask,rcvd->high_ask);
-                                fprintf(fresults_candle,"%d\tBID\t%.3f\t%.3f\t%.3f\t%.3f\n",rcvd->type,rcvd->open_bid,rcvd->close_bid,rcvd->low_bid,rcvd->high_bid);
-                                #endif
-                                double lat=(double)((current_time_usecs()-start_global_usecs)-(buffer_disordered[rcvd->type][i].timestamp-first_tuple_timestamp));
-								dlat+=lat;
-								#if defined (MONITORING)
-                                    monitoring->results++;
-                                    monitoring->results_per_class[rcvd->type]++;
-                                    monitoring->latency_per_class[rcvd->type]+=lat; //usec
-								#endif
-								expected_iid[rcvd->type]+=window_slide;
-								//erase the element
-								buffer_disordered[rcvd->type].erase(buffer_disordered[rcvd->type].begin()+i);
-								disordered[rcvd->type]--;
-								//reset i to zero, we have to start from the beginning
-								i=0;
-                               // cerr<<"[CONTROLLER] Received partial result out of order for class: "<<rcvd->type<<" problem resolved!"<<endl;
-							}
-						}
-					}
 				}
+                //send afterwards the buffered results that are now in order (if any)
+                reorder[rcvd->type].release(expected_iid[rcvd->type],deliver);
+                //the last results computed by a replica before the class was split
+                if(split[rcvd->type]!=NULL)
+                    produce_split(rcvd->type);
 			}
 		}
+        else
+        {
+            empty_polls++;
+            check_timers=true;
+        }
+        if(check_timers)
+        {
+            now_ticks=getticks();
+            results_since_check=0;
+        }
 		
 		//check if we have to print
-        if(current_time_usecs()-last_print>print_rate)
+        if(check_timers && now_ticks>print_timer_ticks)
 		{
+            print_timer_ticks=now_ticks+print_step_ticks;
             double avglat=latency_stats.Mean();
             double std_dev_lat=latency_stats.StandardDeviation();
             last_print=current_time_usecs();
-            int indexp=0;
-			//sort percentiles
             double curr_sec=((double)(last_print-start_usecs))/1000000.0;
-            //for the moment being we handle this here
-			if(percentile_lat.size()>0)
-
-			{
-				sort(percentile_lat.begin(), percentile_lat.end()); 
-                indexp=percentile_lat.size()*0.95;
-
-                //cout<< fixed<<std::setprecision(3)<<ANSI_COLOR_GREEN "Time: "<< curr_sec <<", Num Replica: "<<num_workers<<", recvd results: "<<partial_rcvd <<", avg latency (usec): "<< avglat<<", 95-percentile: "<<percentile_lat[indexp]<<" (top: " <<percentile_lat[percentile_lat.size()-1] << ")" ANSI_COLOR_RESET<<endl;
-                cout<< fixed<<std::setprecision(3)<<ANSI_COLOR_GREEN "Time: "<< curr_sec <<", Num Replicas: "<<num_workers<<", recvd results: "<<partial_rcvd <<", avg latency (usec): "<< avglat<< ANSI_COLOR_RESET<<endl;
-
-                #if defined(MONITORING)
-                monitoring->lat_95+=percentile_lat[indexp];
-                #endif
-                // monitoring->lat_95+=percentile_lat[percentile_lat.size()-1];
-			}
-			else
-                cout<< fixed<<std::setprecision(3)<<ANSI_COLOR_GREEN "Time: "<< curr_sec <<", Num Replicas: "<<num_workers<<", recvd results: "<<partial_rcvd <<", avg latency (usec): "<< avglat<< ANSI_COLOR_RESET<<endl;
+            cout<< fixed<<std::setprecision(3)<<ANSI_COLOR_GREEN "Time: "<< curr_sec <<", Num Replicas: "<<num_workers<<", recvd results: "<<partial_rcvd <<", avg latency (usec): "<< avglat<< ANSI_COLOR_RESET<<endl;
+            #if defined(MONITORING)
+            if(lat_hist.count()>0)
+                monitoring->lat_95+=lat_hist.percentile(0.95);
+            #endif
 			
             dlat=0;
 			//throughput per worker
@@ -341,31 +426,24 @@ void * collector(void *args) {
 
             //save metrics for print them to file
             #if defined(MONITORING)
-            if(percentile_lat.size()>0)
-            {
-                to_save_lat95=percentile_lat[indexp];
-                to_save_lat99=percentile_lat[(int)(percentile_lat.size()*0.99)];
-                to_save_lat_top=percentile_lat[percentile_lat.size()-1];
-            }
-            else{
-                to_save_lat95=0;
-                to_save_lat99=0;
-                to_save_lat_top=0;
-            }
+            to_save_lat95=lat_hist.percentile(0.95);
+            to_save_lat99=lat_hist.percentile(0.99);
+            to_save_lat_top=lat_hist.max();
             stats->addStat(((double)(current_time_usecs()-start_usecs))/1000000.0,partial_rcvd,avglat,to_save_lat95,to_save_lat99,to_save_lat_top,std_dev_lat);
             monitoring->avg_lat+=avglat; //sign it in order to take into account the average lat per mon step
             #endif
 			partial_rcvd=0;
-			percentile_lat.clear();
+            run_lat_hist.merge(lat_hist);
+            lat_hist.clear();
             latency_stats.Clear();
 			memset(recvd_per_worker,0,num_workers*sizeof(int));
 
         }
         #if defined(MONITORING)
         //check if we can send monitoring data to controller
-        if(current_time_usecs()>monitoring_timer)
+        if(check_timers && now_ticks>monitoring_timer_ticks)
         {
-
+            monitoring_timer_ticks=now_ticks+monitoring_step_ticks;
             monitoring_timer=current_time_usecs()+monitoring_step_usecs;
 
             asm volatile("":::"memory");
@@ -381,7 +459,7 @@ void * collector(void *args) {
             //blocking send towards the collector
             bsend(monitoring,cn_outqueue);
             //create a new message
-            monitoring=new msg::CollectorMonitoring(num_classes);
+            monitoring=mon_ring->next();
             //printf("Collector sent step: %d, lqueue:%d\n",mon_step++,cn_outqueue->length());
             stat_service_time.Clear();
         }
@@ -401,11 +479,16 @@ void * collector(void *args) {
 					
 					//take the new queues
 					for(int i=0;i<reconf_data->par_degree_changes;i++)
+                    {
 						inqueue[num_workers+i]=reconf_data->wqueues[i];
+                        readers[num_workers+i].init(reconf_data->wqueues[i],sd->channel_batch);
+                        if(doorbell)
+                            doorbell_attached&=doorbells().attach(reconf_data->wqueues[i],doorbell);
+                    }
 					//increments the par degree
 					num_workers+=reconf_data->par_degree_changes;
                     //ok, notify to the collector that the reconfiguration has finished
-                    msg::CollectorMonitoring *reconf_finished=new msg::CollectorMonitoring(0);
+                    msg::CollectorMonitoring *reconf_finished=mon_ring->next();
                     reconf_finished->tag=msg::MonitoringTag::RECONF_FINISHED_TAG;
                     bsend(reconf_finished,cn_outqueue);
 				}
@@ -419,37 +502,32 @@ void * collector(void *args) {
 					}
 			}
         }
-		index=(index+1)%num_workers;
+        //nothing arrived for a while: release the core according to the wait policy
+        if(empty_polls>WAIT_SPIN_ROUNDS)
+        {
+            //fallback: a queue that has something but whose bit is not set is signalled again
+            for(int i=0;i<num_workers;i++)
+                if(inqueue[i]!=NULL && !readers[i].empty())
+                    ready_mask->set(i);
+            if(doorbell && doorbell_attached)
+                doorbell->park(ready);
+            else if(wait_policy()!=WaitPolicy::SPIN)
+                sched_yield();
+            empty_polls=0;
+        }
 	}
 	
 	//last print
     double avglat=latency_stats.Mean();
     double std_dev_lat=latency_stats.StandardDeviation();
-	//order percentile
-    int indexp=percentile_lat.size()*0.95;
     double curr_sec=((double)(last_print-start_usecs))/1000000.0;
-
-	if(percentile_lat.size()>0)
-	{
-		sort(percentile_lat.begin(), percentile_lat.end()); 
-        //cout<< fixed<<std::setprecision(3)<<ANSI_COLOR_GREEN "Time: "<< curr_sec <<", Num Replica: "<<num_workers<<", recvd results: "<<partial_rcvd <<", avg latency (usec): "<< avglat<<", 95-percentile: "<<percentile_lat[indexp]<<" (top: " <<percentile_lat[percentile_lat.size()-1] << ")" ANSI_COLOR_RESET<<endl;
-        cout<< fixed<<std::setprecision(3)<<ANSI_COLOR_GREEN "Time: "<< curr_sec <<", Num Replicas: "<<num_workers<<", recvd results: "<<partial_rcvd <<", avg latency (usec): "<< avglat<< ANSI_COLOR_RESET<<endl;
-	}
-	else
-        cout<< fixed<<std::setprecision(3)<<ANSI_COLOR_GREEN "Time: "<< curr_sec <<", Num Replicas: "<<num_workers<<", recvd results: "<<partial_rcvd <<", avg latency (usec): "<< avglat<< ANSI_COLOR_RESET<<endl;
+    cout<< fixed<<std::setprecision(3)<<ANSI_COLOR_GREEN "Time: "<< curr_sec <<", Num Replicas: "<<num_workers<<", recvd results: "<<partial_rcvd <<", avg latency (usec): "<< avglat<< ANSI_COLOR_RESET<<endl;
 
     //for print to file
-    if(percentile_lat.size()>0)
-    {
-        to_save_lat95=percentile_lat[indexp];
-        to_save_lat99=percentile_lat[(int)(percentile_lat.size()*0.99)];
-        to_save_lat_top=percentile_lat[percentile_lat.size()-1];
-    }
-    else{
-        to_save_lat95=0;
-        to_save_lat99=0;
-        to_save_lat_top=0;
-    }
+    to_save_lat95=lat_hist.percentile(0.95);
+    to_save_lat99=lat_hist.percentile(0.99);
+    to_save_lat_top=lat_hist.max();
+    run_lat_hist.merge(lat_hist);
     stats->addStat((double)(current_time_usecs()-start_usecs)/1000000.0,partial_rcvd,avglat,to_save_lat95,to_save_lat99,to_save_lat_top,std_dev_lat);
 
 	#if defined(MONITORING)
@@ -460,6 +538,29 @@ void * collector(void *args) {
 	#endif
 
     cout<< "Program terminated, received results: "<<rcvd_results<<endl;
+    if(run_lat_hist.count()>0)
+        cout<< "Latency (usec) over the whole run, 50-percentile: "<<run_lat_hist.percentile(0.5)<<", 95-percentile: "<<run_lat_hist.percentile(0.95)<<", 99-percentile: "<<run_lat_hist.percentile(0.99)<<", top: "<<run_lat_hist.max()<<endl;
+    #if defined(PER_KEY_LATENCY)
+    //latency distribution of each key
+    char key_lat_file[100];
+    sprintf(key_lat_file,"%s_per_key_%s.dat",LAT_FILE,suffix);
+    FILE *fkeylat=fopen(key_lat_file,"w");
+    fprintf(fkeylat,"#Key\tResults\t50-perc\t95-perc\t99-perc\tTop\n");
+    for(int i=0;i<num_classes;i++)
+        if(key_lat_hist[i].count()>0)
+            fprintf(fkeylat,"%d\t%Ld\t%.3f\t%.3f\t%.3f\t%.3f\n",i,(long long)key_lat_hist[i].count(),key_lat_hist[i].percentile(0.5),key_lat_hist[i].percentile(0.95),key_lat_hist[i].percentile(0.99),key_lat_hist[i].max());
+    fclose(fkeylat);
+    delete[] key_lat_hist;
+    #endif
+    int64_t reordered=0,skipped=0,max_depth=0;
+    for(int i=0;i<num_classes;i++)
+    {
+        reordered+=reorder[i].getReordered();
+        skipped+=reorder[i].getSkipped();
+        max_depth=std::max(max_depth,reorder[i].getMaxDepth());
+    }
+    if(reordered>0)
+        cout<< "Results received out of order: "<<reordered<<" (max depth: "<<max_depth<<" windows, given up: "<<skipped<<")"<<endl;
     #if defined(SAVE_RESULTS)
     fclose(fresults);
     fclose(fresults_candle);
@@ -44,6 +44,7 @@
 #include "../includes/cycle.h"
 #include "../includes/general.h"
 #include "../includes/utils.h"
+#include "../includes/wire_format.hpp"
 
 using namespace std;
 int numb_class;
@@ -174,25 +175,40 @@ int main(int argc, char *argv[])
       			time_scale=atoi(optarg);
       			break;
         }
-    tuple_t* tasks=readDailyQuote(tuple_dataset,num_task,time_scale); //da sistemare time scaling
+    tuple_t* dataset=readDailyQuote(tuple_dataset,num_task,time_scale); //da sistemare time scaling
+    //quotes are sent in the compact wire format
+    wire_quote_t *tasks;
+    posix_memalign((void **)&tasks,CACHE_LINE_SIZE,num_task*sizeof(wire_quote_t));
+    for(int i=0;i<num_task;i++)
+        wire_from_tuple(&dataset[i],&tasks[i]);
+    free(dataset);
 
 
-    cout<<"Expected data generation time (sec): "<<(tasks[num_task-1].original_timestamp-tasks[0].original_timestamp)/1000000.0<<endl;
+    cout<<"Expected data generation time (sec): "<<(wire_original_timestamp(&tasks[num_task-1])-wire_original_timestamp(&tasks[0]))/1000000.0<<endl;
 	
 	int socket=connect_to(host,port);
 
 	// fcntl(socket, F_SETFL, O_NONBLOCK);
 
+	//send the header of the stream
+	wire_header_t header;
+	wire_header(&header);
+	if((ret=socket_send(socket,&header,sizeof(wire_header_t)))!=sizeof(wire_header_t))
+	{
+		fprintf(stderr,"Error in sending the header of the stream\n");
+		exit(-1);
+	}
+
 	//send the first dummy task for synchronizing the global start time...
 	volatile ticks start_ticks=getticks();
     long  start_t=current_time_usecs();
-    tuple_t t;
+    wire_quote_t t;
 	t.type=-10;
     ticks no_more_init=(unsigned long long)FREQ*NO_MORE_INIT; //for the moment is set to an high value in order to not be used
-    t.timestamp=tasks[0].original_timestamp;
-    t.original_timestamp=tasks[0].original_timestamp;
+    t.timestamp=wire_original_timestamp(&tasks[0]);
+    t.ts_delta=0;
 
-    if((ret=socket_send(socket,&t,sizeof(tuple_t)))!=sizeof(tuple_t))
+    if((ret=socket_send(socket,&t,sizeof(wire_quote_t)))!=sizeof(wire_quote_t))
 	{
 		
 			fprintf(stderr,"The receiving program is a bottlenck\n");
@@ -218,9 +234,9 @@ int main(int argc, char *argv[])
             curr_t=current_time_nsecs();
         //altrimenti anche qui, partendo dal primo timestamp, ci aggiungi quello che serve
         //tasks[i].timestamp=tasks[i].original_timestamp;
-        ret=socket_send(socket,&tasks[i],sizeof(tuple_t));
+        ret=socket_send(socket,&tasks[i],sizeof(wire_quote_t));
 
-        if(ret!=sizeof(tuple_t))
+        if(ret!=sizeof(wire_quote_t))
         {
             if(ret==BOTTLENECK_ERR)
             {
@@ -252,7 +268,7 @@ int main(int argc, char *argv[])
     }
 
 	t.type=-1;
-    if((ret=socket_send(socket,&t,sizeof(tuple_t)))!=sizeof(tuple_t))
+    if((ret=socket_send(socket,&t,sizeof(wire_quote_t)))!=sizeof(wire_quote_t))
 	{
 		if(ret==BOTTLENECK_ERR)
 		{
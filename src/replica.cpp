@@ -32,7 +32,6 @@
 #include <unistd.h>
 #include <ff/buffer.hpp>
 #include <iostream>
-#include <unordered_map>
 #include <vector>
 #include <sched.h>
 #include <set>
@@ -40,7 +39,9 @@
 #include "../includes/general.h"
 #include "../includes/elastic-hft.h"
 #include "../includes/messages.hpp"
-#include "../includes/cbwindow.hpp"
+#include "../includes/window_directory.hpp"
+#include "../includes/pane.hpp"
+#include "../includes/channel.hpp"
 #include "../includes/strategy_descriptor.hpp"
 #include <ff/allocator.hpp>
 #include <ff/buffer.hpp>
@@ -49,7 +50,7 @@
 using namespace ff;
 using namespace std;
 
-void processAndSendTask(CBWindow *window,tuple_t *task,winresult_t *res_buff, int& bi,int buff_size, int worker_id,SWSR_Ptr_Buffer *outqueue,msg::WorkerMonitoring *monitoring,long int freq) __attribute__((always_inline));
+void processAndSendTask(window_t *window,tuple_t *task,winresult_t *res_buff, int& bi,int buff_size, int worker_id,ChannelWriter *outchannel,msg::WorkerMonitoring *monitoring,long int freq) __attribute__((always_inline));
 /**
  * @brief standardProcessTask process the task passed, inserting into the window and triggering the computation if needed.
  * It performs also monitoring
@@ -57,9 +58,9 @@ void processAndSendTask(CBWindow *window,tuple_t *task,winresult_t *res_buff, in
  * @param task the task to insert
  * @param res_buff the result buffer, containing all the results to be sent on the collector (we use buffer just for recycle memory)
  * @param bi buffer index. It will be modified
- * @param outqueue queue toward collector
+ * @param outchannel channel toward collector
  */
-inline void processAndSendTask(CBWindow *window, tuple_t *task, winresult_t *res_buff, int& bi, int buff_size, int worker_id, SWSR_Ptr_Buffer *outqueue, msg::WorkerMonitoring *monitoring, long freq)
+inline void processAndSendTask(window_t *window, tuple_t *task, winresult_t *res_buff, int& bi, int buff_size, int worker_id, ChannelWriter *outchannel, msg::WorkerMonitoring *monitoring, long freq)
 {
     #if defined(MONITORING)
         asm volatile("":::"memory");
@@ -80,14 +81,15 @@ inline void processAndSendTask(CBWindow *window, tuple_t *task, winresult_t *res
         res_buff[bi].id=task->internal_id; //for the moment just for ordering
         res_buff[bi].type=task->type;
         res_buff[bi].isEOS=false;
-        res_buff[bi].wid=(char)worker_id;
+        res_buff[bi].wid=(worker_id_t)worker_id;
+        res_buff[bi].pane=NULL;
         if((res_buff[bi].id+1)%25!=0) //a check used while programming this stuff
         {
             cerr<<ANSI_COLOR_RED "[WORKER "<<worker_id<<"] Fatal error: computed erronoeusly on class "<<task->type <<" with int id "<<task->internal_id<< ANSI_COLOR_RESET<<endl;
             exit(-1);
         }
         //send result to the collector
-        send(&res_buff[bi],outqueue);
+        outchannel->push(&res_buff[bi]);
         //advance the buffer index
         bi=(bi+1)%buff_size;
        // printf("[%d] Computato risultato per: %d\n",worker_id,task->type);
@@ -99,13 +101,105 @@ inline void processAndSendTask(CBWindow *window, tuple_t *task, winresult_t *res
         monitoring->computations_per_class[task->type]++;
         monitoring->computations++;
         //calc_times->push_back((double)(getticks()-start)/freq);
-        (monitoring->calc_times)->push_back(last_tcalc);
+        monitoring->calc_times.push_back(last_tcalc);
         //if((double)(getticks()-start)/freq>monitoring->max_tcalc_per_class[task->type])
         //    monitoring->max_tcalc_per_class[task->type]=(double)(getticks()-start)/freq;
         #endif
     }
 }
 
+/**
+ * @brief sendPane sends to the collector the summary of a pane (or of a fragment of it) of a split class
+ * @param pane the summary. It is copied in the slot of pane_buff that corresponds to the result, and then emptied
+ * @param timestamp timestamps of the last task of the pane (they are used only if it is the triggering one)
+ */
+inline void sendPane(pane_summary_t *pane, int type, long timestamp, long original_timestamp, winresult_t *res_buff, pane_summary_t *pane_buff, int& bi, int buff_size, int worker_id, ChannelWriter *outchannel)
+{
+    pane_buff[bi]=*pane;
+    res_buff[bi].pane=&pane_buff[bi];
+    res_buff[bi].timestamp=timestamp;
+    res_buff[bi].original_timestamp=original_timestamp;
+    res_buff[bi].id=pane->first_iid+pane->n-1;
+    res_buff[bi].type=type;
+    res_buff[bi].isEOS=false;
+    res_buff[bi].wid=(worker_id_t)worker_id;
+    outchannel->push(&res_buff[bi]);
+    bi=(bi+1)%buff_size;
+    pane->n=0;
+}
+
+/**
+ * @brief processSplitTask adds a task of a split class to the summary of its pane. When the pane is complete
+ * the summary is sent to the collector, that computes the result. It performs also monitoring
+ * @param pane the summary of the pane that the replica is receiving for this class
+ */
+inline void processSplitTask(pane_summary_t *pane, tuple_t *task, int window_slide, winresult_t *res_buff, pane_summary_t *pane_buff, int& bi, int buff_size, int worker_id, ChannelWriter *outchannel, msg::WorkerMonitoring *monitoring)
+{
+    #if defined(MONITORING)
+        asm volatile("":::"memory");
+        long start_nsecs=current_time_nsecs();
+        asm volatile("":::"memory");
+    #endif
+    if(pane->n==0)
+        pane_init(pane,task->internal_id);
+    pane_add(pane,task->original_timestamp,(task->bid_size>0)?task->bid_price:NAN,(task->ask_size>0)?task->ask_price:NAN);
+    if((task->internal_id+1)%window_slide==0)
+    {
+        sendPane(pane,task->type,task->timestamp,task->original_timestamp,res_buff,pane_buff,bi,buff_size,worker_id,outchannel);
+        #if defined(MONITORING)
+        double last_tcalc=(double)(current_time_nsecs()-start_nsecs)/1000.0;
+        monitoring->tcalc_per_class[task->type]+=last_tcalc; //usec
+        monitoring->computations_per_class[task->type]++;
+        monitoring->computations++;
+        monitoring->calc_times.push_back(last_tcalc);
+        #endif
+    }
+}
+
+/**
+ * @brief exportWindow sends to the collector the summaries of the panes in the window of a class that has been split,
+ * starting from the first one needed by the next result. Their results have already been computed, apart from the
+ * last pane if it is not complete: its summary is a fragment that will be completed by the replicas receiving the rest of it
+ */
+inline void exportWindow(window_t *window, int type, int window_size, int window_slide, winresult_t *res_buff, pane_summary_t *pane_buff, int& bi, int buff_size, int worker_id, ChannelWriter *outchannel)
+{
+    int64_t first_needed=((window->getFirstId()+window->getTotalElements())/window_slide-window_size/window_slide+1)*window_slide;
+    window->summarize(first_needed,[&](pane_summary_t *pane){
+        sendPane(pane,type,0,0,res_buff,pane_buff,bi,buff_size,worker_id,outchannel);
+    });
+}
+
+/**
+ * @brief processRefillingTask inserts a task in the window of a class that is no more split (see SPLIT_END): the window
+ * starts from the first quote of a pane and, until it is full, the results would be computed on a part of it.
+ * Instead, the summaries of its panes are sent to the collector, that computes these results as for a split class
+ */
+inline void processRefillingTask(window_t *window, tuple_t *task, int window_slide, winresult_t *res_buff, pane_summary_t *pane_buff, int& bi, int buff_size, int worker_id, ChannelWriter *outchannel)
+{
+    window->insert(*task);
+    if(window->isComputable())
+    {
+        winresult_t partial;
+        window->compute(partial); //discarded, the window has only to start a new slide
+        window->summarize(task->internal_id+1-window_slide,[&](pane_summary_t *pane){
+            sendPane(pane,task->type,task->timestamp,task->original_timestamp,res_buff,pane_buff,bi,buff_size,worker_id,outchannel);
+        });
+    }
+}
+
+/**
+ * @brief receiveTask receives the next task. If there is nothing to do, the results staged
+ * on the channel toward the collector are sent before waiting
+ */
+inline void receiveTask(ChannelReader &input, ChannelWriter &output, tuple_t **task)
+{
+    if(!input.pop((void **)task))
+    {
+        output.flush();
+        input.receive((void **)task);
+    }
+}
+
 void * worker(void *args) {
 
 
@@ -133,13 +227,30 @@ void * worker(void *args) {
     winresult_t *res_buff; //result buffer in order to reuse memory
     int buff_size;
     int bi=0;
-    CBWindow *window;
-    //map that contains the various association key->window
-    unordered_map<int,CBWindow*> map;
+    window_t *window;
+    //association key->window
+    WindowDirectory windows(num_classes,window_size,window_slide,data->arena);
+    //(possibly batched) channels from the emitter and toward the collector
+    ChannelReader input(inqueue,sd->channel_batch);
+    ChannelWriter output(outqueue,sd->channel_batch,(ticks)sd->channel_flush_usecs*freq);
+    output.setReadyMask(data->ready_mask,id);
     //create a buffer of results that have to be sent to the collector
     //in order to reuse memory (we can have a lot o messages) we allocate an additional number of messages
-    buff_size=QUEUE_SIZE+10;
-    posix_memalign((void **)&res_buff,CACHE_LINE_SIZE, buff_size*sizeof(winresult_t));
+    //(results staged on the channel and the ones already popped by the collector are out of the queue, see channel.hpp)
+    buff_size=REPLICA_RES_BUFF_SIZE;
+    if(data->res_buff!=NULL) //already allocated by the replica pool
+        res_buff=data->res_buff;
+    else
+        posix_memalign((void **)&res_buff,CACHE_LINE_SIZE, result_buffer_size(sd->hot_key_split));
+    //split classes: the summaries sent to the collector follow the result buffer (a result refers to the one with its index),
+    //while the ones of the panes that are being received are allocated when needed
+    pane_summary_t *pane_buff=nullptr;
+    pane_summary_t **split_panes=nullptr;
+    if(sd->hot_key_split)
+    {
+        pane_buff=(pane_summary_t *)(res_buff+buff_size);
+        split_panes=new pane_summary_t*[num_classes]();
+    }
 	
 
     //define the data structures for monitoring
@@ -154,12 +265,26 @@ void * worker(void *args) {
     bool reconfiguration_phase=false; //indicate the whole process
     set<int> classes_moving_in; //it will contains all the id of the classes that are currently moving in
     classes_moving_in.clear();
-    vector<tuple_t *> task_moving_in; //it will contain all the task belonging to moving in classes (not yet arrived to the worker) (to see why i choose vector look at the explnation below, when i use it)
+    vector<tuple_t> task_moving_in; //it will contain (a copy of) all the task belonging to moving in classes (not yet arrived to the worker) (to see why i choose vector look at the explnation below, when i use it)
     int max_enqueued=0; //for testing the state migration protocol, if needed
     #if defined(MONITORING)
-        monitoring=new msg::WorkerMonitoring(num_classes);
+        msg::MonitoringRing<msg::WorkerMonitoring> *mon_ring=data->mon_ring;
+        monitoring=mon_ring->next();
         task_moving_in.reserve(10000);
 	#endif
+    //process a task of a split class
+    auto processSplit=[&](tuple_t *t){
+        if(split_panes[t->type]==NULL)
+            split_panes[t->type]=new pane_summary_t();
+        processSplitTask(split_panes[t->type],t,window_slide,res_buff,pane_buff,bi,buff_size,id,&output,monitoring);
+    };
+    //process a task of a class owned by the replica
+    auto processOwned=[&](window_t *w, tuple_t *t){
+        if(w->getFirstId()>0 && w->getTotalElements()+1<window_size)
+            processRefillingTask(w,t,window_slide,res_buff,pane_buff,bi,buff_size,id,&output);
+        else
+            processAndSendTask(w,t,res_buff,bi,buff_size,id,&output,monitoring,freq);
+    };
 
 
 
@@ -189,7 +314,7 @@ void * worker(void *args) {
 		Start receiving elements
 	*/
 
-	receive((void **)&tmp,inqueue);
+	receiveTask(input,output,&tmp);
 
 
 
@@ -209,19 +334,19 @@ void * worker(void *args) {
         {
 
             //Version with adaptivity: we have to handle all the messages for reconfiguration
-            if(tmp->punctuation==NO) //standard task
+            if(tmp->punctuation==NO || tmp->punctuation==SPLIT_PANE) //standard task
             {
 
                 if(!reconfiguration_phase) //no reconf phase, just process it
                 {
-                    window=map[tmp->type];
-                    if(window==NULL) //it's a new logical stream that has arrived
+                    if(tmp->punctuation==SPLIT_PANE)
+                        processSplit(tmp);
+                    else
                     {
-                        window=new CBWindow(window_size, window_slide);
-                        map[tmp->type]=window;
+                        window=windows.getOrCreate(tmp->type);
+                        //insert the element in window
+                        processOwned(window,tmp);
                     }
-                    //insert the element in window
-                    processAndSendTask(window,tmp,res_buff,bi,buff_size,id,outqueue,monitoring,freq);
                     #if !defined(TASK_BUFF)
                         #if defined(USE_FFALLOC)
                             ffalloc->free(tmp);
@@ -256,7 +381,7 @@ void * worker(void *args) {
                                 //add to my map
                                 //get the window from repository (it will be also removed)
                                 window=repository->getAndRemoveWindow(moving_class);
-                                map[moving_class]=window;
+                                windows.set(moving_class,window);
                                 //erase from the set of class thare are currently ''come'' toward this worker
                                 classes_moving_in.erase(it++);
                                 //look in the vector of task arrived during the coming_in phase: if some of them refer to this class add to the window
@@ -266,10 +391,10 @@ void * worker(void *args) {
                                 int ntask=0;
                                 for(int i=0;i<task_moving_in.size();i++)
                                 {
-                                    if(task_moving_in[i]->type==moving_class)
+                                    if(task_moving_in[i].type==moving_class)
                                     {
-                                        //printf("Inserisco task con id: %Ld\n",task_moving_in[i]->internal_id);
-                                        processAndSendTask(window,task_moving_in[i],res_buff,bi,buff_size,id,outqueue,monitoring,freq);
+                                        //printf("Inserisco task con id: %Ld\n",task_moving_in[i].internal_id);
+                                        processOwned(window,&task_moving_in[i]);
                                         ntask++;
                                     }
                                 }
@@ -282,17 +407,6 @@ void * worker(void *args) {
                         {
                             //we finished the reconfiguration phase
                             reconfiguration_phase_in=false;
-                            //free the elements in the vector (we cannot free them previously otherwise new task will take their place in vector due to the heap recyclement)
-                            #if !defined(TASK_BUFF)
-                            for(int i=0;i<task_moving_in.size();i++)
-                            {
-                                #if defined(USE_FFALLOC)
-                                ffalloc->free(task_moving_in[i]);
-                                #else
-                                free(task_moving_in[i]);
-                                 #endif
-                            }
-                            #endif
                             task_moving_in.clear();
 
                         }
@@ -314,21 +428,34 @@ void * worker(void *args) {
                     if(reconfiguration_phase_in && classes_moving_in.count(tmp->type)==1) //the new task refers to a still moving in class
                     {
                         //we don't see the class in the repository
-                        //add the task to task_coming_in (respecting the order)
-                        task_moving_in.push_back(tmp);
+                        //add the task to task_coming_in (respecting the order). It is copied, so that the task
+                        //can be released immediately (this is needed in TASK_BUFF mode, where the emitter recycles tasks)
+                        task_moving_in.push_back(*tmp);
+                        #if !defined(TASK_BUFF)
+                            #if defined(USE_FFALLOC)
+                            ffalloc->free(tmp);
+                            #else
+                            free(tmp);
+                            #endif
+                        #endif
+                    }
+                    else if(tmp->punctuation==SPLIT_PANE)
+                    {
+                        processSplit(tmp);
+                        #if !defined(TASK_BUFF)
+                            #if defined(USE_FFALLOC)
+                            ffalloc->free(tmp);
+                            #else
+                            free(tmp);
+                            #endif
+                        #endif
                     }
                     else
                     {
                         //it is a task that refer to a class currently held by the worker (or that it has just moved in)
-                        window=map[tmp->type];
-
-                        if(window==NULL) //it's a new logical stream that has arrived
-                        {
-                            window=new CBWindow(window_size, window_slide);
-                            map[tmp->type]=window;
-                        }
+                        window=windows.getOrCreate(tmp->type);
                         //insert the element in window
-                        processAndSendTask(window,tmp,res_buff,bi,buff_size,id,outqueue,monitoring,freq);
+                        processOwned(window,tmp);
 
                         #if !defined(TASK_BUFF)
                             #if defined(USE_FFALLOC)
@@ -350,20 +477,13 @@ void * worker(void *args) {
                         reconfiguration_phase_out=true; //we are entering in the reconfiguration phase
                         reconfiguration_phase=true;
                     }
-                    if(!(window=map[tmp->type]))
+                    if(!(window=windows.remove(tmp->type)))
                     {
                         //the worker does not have this class. Probably it is not yet arrived. We will create a new window
                         //and insert it into the repository
-                        window=new CBWindow(window_size, window_slide);
-                        repository->setWindow(tmp->type,window);
-                        map.erase(tmp->type);
-                    }
-                    else
-                    {
-                        repository->setWindow(tmp->type,map[tmp->type]);
-                        //remove from the worker's map
-                        map.erase(tmp->type); //NOTA: se ci fossero problemi (in teoria dovrebbe richiamare il distruttore), semplicemente mettere a NULL
+                        window=windows.create();
                     }
+                    repository->setWindow(tmp->type,window);
                     //moving_time[tmp->type]=getticks();
                     free(tmp); //allocated by the emitter
                 }
@@ -384,20 +504,39 @@ void * worker(void *args) {
                         //printf("Worker %d: inserted class size%d\n",id,classes_moving_in.size());
                         free(tmp); //it was dynamically allocated by the emitter
                     }
+                    else
+                        if(tmp->punctuation==SPLIT_START)
+                        {
+                            //the class has become split: the panes still needed go to the collector, the window is no more used
+                            if((window=windows.remove(tmp->type)))
+                                exportWindow(window,tmp->type,window_size,window_slide,res_buff,pane_buff,bi,buff_size,id,&output);
+                            free(tmp);
+                        }
+                        else
+                            if(tmp->punctuation==SPLIT_FLUSH)
+                            {
+                                //the replica is going to be removed: send the part of the pane that it has received
+                                if(split_panes[tmp->type]!=NULL && split_panes[tmp->type]->n>0)
+                                    sendPane(split_panes[tmp->type],tmp->type,0,0,res_buff,pane_buff,bi,buff_size,id,&output);
+                                free(tmp);
+                            }
+                            else
+                                if(tmp->punctuation==SPLIT_END)
+                                {
+                                    //the replica owns the class that is no more split: its window starts from the next task
+                                    window=windows.getOrCreate(tmp->type);
+                                    window->reset();
+                                    window->setFirstId(tmp->internal_id);
+                                    free(tmp);
+                                }
             }
         }
         else
         {
             //no adaptivity: simply insert tasks
-            window=map[tmp->type];
-
-            if(window==NULL) //it's a new logical stream that has arrived
-            {
-                window=new CBWindow(window_size, window_slide);
-                map[tmp->type]=window;
-            }
+            window=windows.getOrCreate(tmp->type);
             //insert the element in window
-            processAndSendTask(window,tmp,res_buff,bi,buff_size,id,outqueue,monitoring,freq);
+            processAndSendTask(window,tmp,res_buff,bi,buff_size,id,&output,monitoring,freq);
             #if !defined(TASK_BUFF)
                 #if defined(USE_FFALLOC)
                     ffalloc->free(tmp);
@@ -413,14 +552,17 @@ void * worker(void *args) {
 
                 bsend(monitoring,cn_outqueue);
                 monitoring_timer=getticks();
-                //create a new monitoring message
-                monitoring=new msg::WorkerMonitoring(num_classes);
+                //take a new monitoring message
+                monitoring=mon_ring->next();
                 monitoring_timer+=monitoring_step; //advance monitoring timer
 
             }
         #endif
+        //results must not wait more than the flush bound
+        if(sd->channel_batch>1)
+            output.checkFlush(getticks());
         //receive the next element
-        receive((void **)&tmp,inqueue);
+        receiveTask(input,output,&tmp);
     }
 
     if(sd->type!=StrategyType::NONE)
@@ -441,14 +583,14 @@ void * worker(void *args) {
 
                     //take it, add to the map of class's windows hold by the worker
                     window=repository->getAndRemoveWindow(moving_class);
-                    map[moving_class]=window;
+                    windows.set(moving_class,window);
                     //erase from the set of class thare are currently ''come'' toward this worker
                     classes_moving_in.erase(it++);
                     for(int i=0;i<task_moving_in.size();i++)
                     {
-                        if(task_moving_in[i]->type==moving_class)
+                        if(task_moving_in[i].type==moving_class)
                         {
-                            processAndSendTask(window,task_moving_in[i],res_buff,bi,buff_size,id,outqueue,monitoring,freq);
+                            processOwned(window,&task_moving_in[i]);
                         }
                     }
                 }
@@ -460,17 +602,6 @@ void * worker(void *args) {
             {
                 //we finished the reconfiguration phase
                 reconfiguration_phase_in=false;
-                //free the elements in the vector (we cannot free them previously otherwise new task will take their place in vector)
-                #if !defined(TASK_BUFF)
-                for(int i=0;i<task_moving_in.size();i++)
-                {
-                    #if defined(USE_FFALLOC)
-                    ffalloc->free(task_moving_in[i]);
-                    #else
-                    free(task_moving_in[i]);
-                    #endif
-                }
-                #endif
                 task_moving_in.clear();
                 //repo->reconfiguration_finished[id].store(1); we do it after
             }
@@ -488,6 +619,15 @@ void * worker(void *args) {
 	//send EOS to collector	
 	res_buff[bi].isEOS=true;
 	res_buff[bi].res_buff=res_buff;
-	send(&res_buff[bi],outqueue);
+	res_buff[bi].pane=NULL;
+	output.push(&res_buff[bi]);
+	output.flush();
+    //the partial panes have been flushed before the removal of the replica (SPLIT_FLUSH)
+    if(split_panes!=nullptr)
+    {
+        for(int i=0;i<num_classes;i++)
+            delete split_panes[i];
+        delete[] split_panes;
+    }
     return NULL;
 }
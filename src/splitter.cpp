@@ -41,6 +41,11 @@
 #include "../includes/messages.hpp"
 #include "../includes/repository.hpp"
 #include "../includes/strategy_descriptor.hpp"
+#include "../includes/socket_reader.hpp"
+#include "../includes/tuple_ring.hpp"
+#include "../includes/wire_format.hpp"
+#include "../includes/channel.hpp"
+#include "../includes/consistent_hash.hpp"
 
 #include <sys/ioctl.h>
 #include <linux/sockios.h>
@@ -55,9 +60,9 @@ using namespace std;
 	according to a round robin allocation strategy of the logical streams
 	to the Workers
 */
-char next_schedulingRR=0;
-char * scheduling_table;
-inline char schedulingRR (tuple_t *t, int num_workers)
+int next_schedulingRR=0;
+worker_id_t * scheduling_table;
+inline worker_id_t schedulingRR (const wire_quote_t *t, int num_workers)
 {
 	//The scheduling table is a simple array with numb_classes positions
 	//if the i-th element is zero then for that logical stream we don't have 
@@ -80,13 +85,12 @@ inline char schedulingRR (tuple_t *t, int num_workers)
 void *emitter(void *args)
 {
 
-    tuple_t tmp;                            //received tuple
+    wire_quote_t tmp;                       //received record
     struct timeval tmp_t;                   //timing
 	long start_t=0, end_t=0;
 	
 
-	char to_send_to;
-    int ret;
+	worker_id_t to_send_to;
     //Init: take data passed from main
 	emitter_data_t *data = (emitter_data_t *) args;
 	pthread_barrier_t *barrier = data->barrier;
@@ -103,14 +107,19 @@ void *emitter(void *args)
     tuple_t eos_t; //tuple for terminating workers
     StrategyDescriptor *sd=data->sd;
 	eos_t.type=-1;
-    scheduling_table=new char[num_classes](); //the mapping function class_id(aka key)->worker
-    //by default use a round robin mapping
-    char w=0;
+    scheduling_table=alloc_scheduling_table(num_classes); //the mapping function class_id(aka key)->worker
+    //by default use a round robin mapping (or the consistent hash, if required)
+    int w=0;
     for(int i=0;i<num_classes;i++)
     {
-        scheduling_table[i]=w+1;
-        w++;
-        w%=num_workers;
+        if(sd->routing==RoutingType::CONSISTENT_HASH)
+            scheduling_table[i]=jump_consistent_hash(i,num_workers)+1;
+        else
+        {
+            scheduling_table[i]=w+1;
+            w++;
+            w%=num_workers;
+        }
     }
 
     //Statistics computed on the fly  considering the timestamps of the tuples
@@ -118,22 +127,41 @@ void *emitter(void *args)
 
 	//frequency counter for the various classes
     int64_t *classes_freq=new int64_t[num_classes]();
+    //classes involved in a state migration
+    int *moved_classes=new int[num_classes];
+    //split classes: replica that receives the current pane of each one (-1 if it has to be chosen), in round robin
+    int *split_target=nullptr;
+    int next_split=0;
+    //split classes that have been unsplit: replica (id+1) that will own each one from the start of its next pane (0 if none)
+    worker_id_t *unsplit_owner=nullptr;
+    if(sd->hot_key_split)
+    {
+        split_target=new int[num_classes];
+        for(int i=0;i<num_classes;i++)
+            split_target[i]=-1;
+        unsplit_owner=new worker_id_t[num_classes]();
+    }
 
 	#if defined(TASK_BUFF)
-		printf(ANSI_COLOR_RED "Pay attention to this version with task_buff!\n" ANSI_COLOR_RESET);
-		//create the buffer for tasks
-        tuple_t * task_buff;
-		//We do not know how large should be this buffer in order to guarantee correctness
-		int buff_size=num_workers*(QUEUE_SIZE+2)*num_workers;
-        posix_memalign((void **)&task_buff,CACHE_LINE_SIZE, buff_size*sizeof(Tuple));
-		int bi=0; //index pointer for the task buffer
+        //tasks are not allocated: each replica has its ring of preallocated tuples
+        //(created when the replica is used for the first time, and recycled if it is removed and then added again)
+        TupleRing **task_rings=new TupleRing*[data->max_workers]();
+        for(int i=0;i<num_workers;i++)
+            task_rings[i]=new TupleRing();
 	#else
         #if defined(USE_FFALLOC)
 
             ff_allocator *ffalloc=data->ffalloc;
 		#endif
 	#endif
+    //tuples are sent to the replicas through (possibly batched) channels
+    ChannelWriter *channels=new ChannelWriter[data->max_workers];
+    ticks flush_ticks=(ticks)sd->channel_flush_usecs*freq;
+    for(int i=0;i<data->max_workers;i++)
+        channels[i].init(i<num_workers?outqueue[i]:NULL,sd->channel_batch,flush_ticks);
+    ticks next_flush_check=0;
     tuple_t *tb;
+    const wire_quote_t *rcvd; //received quote, it refers directly to the reception buffer
 
 	#if defined(MONITORING)
 		//define the data structures for monitoring
@@ -146,15 +174,14 @@ void *emitter(void *args)
         //reconf_data_em_t *reconf_data;
         msg::ReconfEmitter *reconf_data;
 
-        msg::EmitterMonitoring* monitoring=new msg::EmitterMonitoring(num_classes);
+        msg::MonitoringRing<msg::EmitterMonitoring> *mon_ring=data->mon_ring;
+        msg::EmitterMonitoring* monitoring=mon_ring->next();
         Repository *repository=data->repository;
         SWSR_Ptr_Buffer *cn_inqueue = nullptr;
         if(sd->type!=StrategyType::NONE)//there is an adaptation strategy
         {
 			//queue from the controller for incoming reconfiguration commands
             cn_inqueue =data->cn_inqueue;
-			//this particular monitoring data is used to notify that the reconfiguration is finished
-            //it does not need to be deleted by the controller
         }
 	#endif
 	
@@ -172,13 +199,26 @@ void *emitter(void *args)
         int socket;
         socket=*(int *)receive_connection(1,port);
     #endif
+    //tuples are received in bulk
+    SocketReader reader(socket);
+    wire_header_t header;
+    if(!reader.receive(&header,sizeof(wire_header_t)))
+    {
+        fprintf(stderr,"Error in receiving the header of the stream\n");
+        exit(-1);
+    }
+    if(!wire_check_header(&header))
+    {
+        cerr << ANSI_COLOR_RED "[EMITTER] Unsupported stream format (version: "<<header.version<<", record size: "<<header.record_size<<")" ANSI_COLOR_RESET<<endl;
+        exit(-1);
+    }
 
 	/**
 		The first receives are for tacking global start time used for
         computing the latency. It reports the original_timestamp of the first tuple
 	*/
 
-    if((ret=socket_receive(socket, &tmp, sizeof(tuple_t)))!=sizeof(tuple_t))
+    if(!reader.receive(&tmp,sizeof(wire_quote_t)))
 	{
 		fprintf(stderr,"The program is a bottleneck\n");
 		exit(BOTTLENECK_ERR);
@@ -200,16 +240,7 @@ void *emitter(void *args)
 		Start receiving real elements
 	*/
 
-	#if defined(TASK_BUFF)
-		tb=&task_buff[bi];
-	#else
-        #if defined(USE_FFALLOC)
-            tb=(tuple_t *)ffalloc->malloc(sizeof(tuple_t)); //posix memalign does not work for ff allocator (bugged)
-		#else
-            posix_memalign((void **)&tb,CACHE_LINE_SIZE,sizeof(tuple_t));
-		#endif
-	#endif
-    if((ret=socket_receive(socket, tb, sizeof(tuple_t)))!=sizeof(tuple_t))
+    if((rcvd=(const wire_quote_t *)reader.next(sizeof(wire_quote_t)))==NULL)
 	{
         std::cerr<<"The program is a bottleneck\n"<<endl;
 		exit(BOTTLENECK_ERR);
@@ -223,35 +254,88 @@ void *emitter(void *args)
     //for computing variance on the fly (all referring to ticks)
 
     long curr_usecs;
-    double last_recv_timestamp=tb->timestamp;
+    double last_recv_timestamp=rcvd->timestamp;
     //for TPDS strategy
     ticks congestion_index=0;
     //start receiving and distribute task
-    while(tb->type!=-1)
+    while(rcvd->type!=-1)
 	{
 		msg++;
 		#if defined (MONITORING)
             monitoring->elements++;
-            monitoring->elements_per_class[tb->type]++;
+            monitoring->elements_per_class[rcvd->type]++;
 			//on the fly variance, but we have to consider only elements that trigger a computation
 			//(the interarrival time refers to interarrival of tuples that trigger a slide)
             if(monitoring->elements%window_slide==0) //we take it every window_slide
 			{
 
 				//stat computed by using the timestamp into the tuples
-                stat_timestamp.Push(tb->original_timestamp-last_recv_timestamp);
-                last_recv_timestamp=tb->original_timestamp;
+                stat_timestamp.Push(wire_original_timestamp(rcvd)-last_recv_timestamp);
+                last_recv_timestamp=wire_original_timestamp(rcvd);
 
 			}
 		#endif
 
+        //the routing entry and the counter of the class are accessed for each tuple: fetch the ones of a tuple
+        //that is already in the reception buffer, in order to hide the miss when the classes are many
+        const wire_quote_t *ahead=(const wire_quote_t *)reader.peek(sizeof(wire_quote_t),ROUTING_PREFETCH_DISTANCE);
+        if(ahead!=NULL && ahead->type>=0)
+        {
+            __builtin_prefetch(&scheduling_table[ahead->type]);
+            __builtin_prefetch(&classes_freq[ahead->type],1);
+        }
+		to_send_to=schedulingRR(rcvd,num_workers); //e qui
+        punctation_t punctuation=NO;
+        if(to_send_to==SPLIT_CLASS-1)
+        {
+            if(classes_freq[rcvd->type]%window_slide==0 && unsplit_owner[rcvd->type]!=0)
+            {
+                //the class has been unsplit: the new owner receives it from this pane on, starting a new window
+                scheduling_table[rcvd->type]=unsplit_owner[rcvd->type];
+                unsplit_owner[rcvd->type]=0;
+                split_target[rcvd->type]=-1;
+                to_send_to=scheduling_table[rcvd->type]-1;
+                tuple_t *signalt=new tuple_t;
+                signalt->type=rcvd->type;
+                signalt->punctuation=SPLIT_END;
+                signalt->internal_id=classes_freq[rcvd->type];
+                if(!channels[to_send_to].push(signalt))
+                {
+                    cerr << ANSI_COLOR_RED "[EMITTER] Worker "<<to_send_to<<" is a bottleneck" ANSI_COLOR_RESET<<endl;
+                    exit(BOTTLENECK_ERR);
+                }
+            }
+            else
+            {
+                //hot key: its panes are spread on the replicas
+                if(classes_freq[rcvd->type]%window_slide==0 || split_target[rcvd->type]<0)
+                {
+                    split_target[rcvd->type]=next_split;
+                    next_split=(next_split+1)%num_workers;
+                }
+                to_send_to=split_target[rcvd->type];
+                punctuation=SPLIT_PANE;
+            }
+        }
+
+        //take the memory for the task that will be sent
+        #if defined(TASK_BUFF)
+            tb=task_rings[to_send_to]->next();
+        #else
+            #if defined(USE_FFALLOC)
+                tb=(tuple_t *)ffalloc->malloc(sizeof(tuple_t)); //posix memalign does not work for ff allocator (bugged)
+            #else
+                posix_memalign((void **)&tb,CACHE_LINE_SIZE,sizeof(tuple_t));
+            #endif
+        #endif
+        wire_to_tuple(rcvd,tb);
+        tb->id=msg;
 		tb->internal_id=classes_freq[tb->type]++;
-		tb->punctuation=NO;
-		to_send_to=schedulingRR(tb,num_workers); //e qui
+		tb->punctuation=punctuation;
 
         if(sd->type!=StrategyType::TPDS)
         {
-            if(!send(tb,outqueue[to_send_to]))
+            if(!channels[to_send_to].push(tb))
             {
                 cerr<<ANSI_COLOR_RED<< "Replica "<<to_send_to<<" is a bottleneck"<<ANSI_COLOR_RESET<<endl;
                 exit(BOTTLENECK_ERR);
@@ -260,23 +344,21 @@ void *emitter(void *args)
         else
         {
             //we have to count the congestion
-            congestion_index+=ci_send(tb,outqueue[to_send_to]);
+            congestion_index+=channels[to_send_to].ci_push(tb);
+        }
+        if(sd->channel_batch>1)
+        {
+            //tuples staged for the replicas that are not receiving anything must not wait more than the flush bound
+            ticks now=getticks();
+            if(now>next_flush_check)
+            {
+                for(int i=0;i<num_workers;i++)
+                    channels[i].checkFlush(now);
+                next_flush_check=now+flush_ticks/2;
+            }
         }
 
 
-        //take the pointer to the next task that will be received
-		#if defined(TASK_BUFF)
-            //advance buffer index
-			bi=(bi+1)%(buff_size);
-			tb=&task_buff[bi];
-		#else
-            #if defined(USE_FFALLOC)
-                tb=(tuple_t *)ffalloc->malloc(sizeof(tuple_t));
-			#else
-                posix_memalign((void **)&tb,CACHE_LINE_SIZE,sizeof(tuple_t));
-			#endif
-		#endif
-
 		#if defined(MONITORING)
 
             if(sd->type!=StrategyType::NONE)
@@ -292,7 +374,14 @@ void *emitter(void *args)
                         DEBUG(cout << ANSI_COLOR_YELLOW "[EMITTER] reconfiguration message: add " << reconf_data->par_degree_changes <<" workers " ANSI_COLOR_RESET<<endl;)
                         //take the new queues
                         for(int i=0;i<reconf_data->par_degree_changes;i++)
+                        {
                             outqueue[num_workers+i]=reconf_data->wqueues[i];
+                            channels[num_workers+i].bind(reconf_data->wqueues[i]);
+                            #if defined(TASK_BUFF)
+                            if(task_rings[num_workers+i]==NULL)
+                                task_rings[num_workers+i]=new TupleRing();
+                            #endif
+                        }
                         //increments the par degree
                         num_workers+=reconf_data->par_degree_changes;
                     }
@@ -308,61 +397,109 @@ void *emitter(void *args)
 
 
                     //Find and handle differences between current and previous scheduling table. Start proper state migrations.
+                    //The tables are compared once, the classes that change replica are collected in moved_classes
                     int differences=0;
-
-
                     for(int i=0;i<num_classes;i++)
-                    {
-
                         if(scheduling_table[i]!=reconf_data->scheduling_table[i])
+                            moved_classes[differences++]=i;
+                        else if(unsplit_owner && unsplit_owner[i]!=0) //split again before being unsplit
+                            unsplit_owner[i]=0;
+
+                    for(int d=0;d<differences;d++)
+                    {
+                        int i=moved_classes[d];
+                        if(scheduling_table[i]==SPLIT_CLASS)
+                        {
+                            //the class is unsplit: there is no replica that holds its window, it will be
+                            //assigned at the start of its next pane (the panes are complete only there)
+                            unsplit_owner[i]=reconf_data->scheduling_table[i];
+                            continue;
+                        }
+                        //send the proper signal to the worker that until now has mantained the class
+                        //it is sent as a special tuple
+                        tuple_t *signalt=new tuple_t;
+                        signalt->type=i; //signal the class that has to be moved
+                        if(reconf_data->scheduling_table[i]==SPLIT_CLASS)
                         {
-                            differences++;
-                            //send the proper signal to the worker that until now has mantained the class
-                            //it is sent as a special tuple
-                            tuple_t *signalt=new tuple_t;
-                            signalt->type=i; //signal the class that has to be moved
-                            signalt->punctuation=MOVING_OUT;
-                            //<R4-R2>: This is used for testing proprerty R4 and R2 of the state migration
-                            //protocol (involved workers are blocked during reconfiguration)
-                            //repository->setHasToMoveOut(scheduling_table[i]-1,true);//</R4>
-                            if(!send(signalt,outqueue[scheduling_table[i]-1]))
+                            //the class is split: there is no state migration, its window is summarized to the collector
+                            signalt->punctuation=SPLIT_START;
+                            if(!channels[scheduling_table[i]-1].push(signalt))
                             {
                                 cerr << ANSI_COLOR_RED "[EMITTER] Worker "<<scheduling_table[i]-1<<" is a bottleneck" ANSI_COLOR_RESET<<endl;
                                 exit(BOTTLENECK_ERR);
                             }
-                            //set the atomic value to zero (it will be used to understand when the reconfiguration has finished)
-                            repository->setWorkerFinished(scheduling_table[i]-1,false);
-
+                            continue;
+                        }
+                        signalt->punctuation=MOVING_OUT;
+                        //<R4-R2>: This is used for testing proprerty R4 and R2 of the state migration
+                        //protocol (involved workers are blocked during reconfiguration)
+                        //repository->setHasToMoveOut(scheduling_table[i]-1,true);//</R4>
+                        if(!channels[scheduling_table[i]-1].push(signalt))
+                        {
+                            cerr << ANSI_COLOR_RED "[EMITTER] Worker "<<scheduling_table[i]-1<<" is a bottleneck" ANSI_COLOR_RESET<<endl;
+                            exit(BOTTLENECK_ERR);
                         }
+                        //set the atomic value to zero (it will be used to understand when the reconfiguration has finished)
+                        repository->setWorkerFinished(scheduling_table[i]-1,false);
                     }
                     //now send move_in
-                    for(int i=0;i<num_classes;i++)
+                    for(int d=0;d<differences;d++)
                     {
-
-                        if(scheduling_table[i]!=reconf_data->scheduling_table[i])
+                        int i=moved_classes[d];
+                        if(reconf_data->scheduling_table[i]==SPLIT_CLASS)
                         {
-                            tuple_t *signalt=new tuple_t;
-                            signalt->type=i; //signal task
-                            signalt->punctuation=MOVING_IN;
-                            if(!send(signalt,outqueue[reconf_data->scheduling_table[i]-1]))
-                            {
-                                cerr << ANSI_COLOR_RED "[EMITTER] Worker "<<scheduling_table[i]-1<<" is a bottleneck" ANSI_COLOR_RESET<<endl;
-                                exit(BOTTLENECK_ERR);
-                            }
-                            repository->setWorkerFinished(scheduling_table[i]-1,false);
+                            scheduling_table[i]=SPLIT_CLASS;
+                            continue;
+                        }
+                        if(scheduling_table[i]==SPLIT_CLASS) //unsplit, see above
+                            continue;
+                        tuple_t *signalt=new tuple_t;
+                        signalt->type=i; //signal task
+                        signalt->punctuation=MOVING_IN;
+                        if(!channels[reconf_data->scheduling_table[i]-1].push(signalt))
+                        {
+                            cerr << ANSI_COLOR_RED "[EMITTER] Worker "<<scheduling_table[i]-1<<" is a bottleneck" ANSI_COLOR_RESET<<endl;
+                            exit(BOTTLENECK_ERR);
                         }
+                        repository->setWorkerFinished(scheduling_table[i]-1,false);
                         //copy the entry in the scheduling table
                         scheduling_table[i]=reconf_data->scheduling_table[i];
                     }
 
+                    //reconfiguration messages must be delivered immediately
+                    for(int i=0;i<num_workers;i++)
+                        channels[i].bflush();
+
                     //if this is a reconfiguration that requires the termination of some worker,
                     //send the EOS to them (it is assumed that scheduling table was correctly derived from the strategy)
                     if(reconf_data->tag==msg::ReconfTag::DECREASE_PAR_DEGREE)
                     {
+                        //the panes of the split classes that were going to the removed workers: the partial
+                        //ones are sent to the collector before the EOS, the rest goes to the first replica.
+                        //It is never removed, so a pane is flushed at most once: together with the part exported
+                        //by the previous owner (SPLIT_START) a pane has at most three fragments (see SplitKeyMerger)
+                        for(int i=0;split_target && i<num_classes;i++)
+                        {
+                            if(scheduling_table[i]!=SPLIT_CLASS || split_target[i]<num_workers+reconf_data->par_degree_changes)
+                                continue;
+                            if(classes_freq[i]%window_slide!=0)
+                            {
+                                tuple_t *signalt=new tuple_t;
+                                signalt->type=i;
+                                signalt->punctuation=SPLIT_FLUSH;
+                                channels[split_target[i]].bpush(signalt);
+                                split_target[i]=0;
+                            }
+                            else
+                                split_target[i]=-1;
+                        }
+                        next_split=0;
                         //we will terminate the workers with highest id
                         for(int i=0;i>reconf_data->par_degree_changes;i--)
                         {
-                            bsend(&eos_t,outqueue[num_workers+i-1]);
+                            channels[num_workers+i-1].bpush(&eos_t);
+                            channels[num_workers+i-1].bflush();
+                            channels[num_workers+i-1].bind(NULL);
                             //set to NULL outqueues (they will destructed by workers)
                             outqueue[num_workers+i-1]=NULL;
                         }
@@ -373,7 +510,7 @@ void *emitter(void *args)
 
                     CONTROL_PRINT(cout << ANSI_COLOR_YELLOW "[EMITTER] "<<differences<<" associations have changed " ANSI_COLOR_RESET<<endl;)
                     //ok, notify to the controller that the reconfiguration has finished
-                    msg::EmitterMonitoring* reconf_finished=new msg::EmitterMonitoring(0);
+                    msg::EmitterMonitoring* reconf_finished=mon_ring->next();
                     reconf_finished->tag=msg::MonitoringTag::RECONF_FINISHED_TAG;
                     bsend((void*)reconf_finished,cn_outqueue);
 
@@ -393,9 +530,10 @@ void *emitter(void *args)
                 //Scaleup: since we are monitoring through the tuples timestamp, we could not capture the real
                 //current  interarrival time. Therefore if there a certain (large) number of tuples
                 //in the incoming socket we will lower the monittored interarrival time in order force scaleup
+                //(tuples already received in the reception buffer are counted as well)
                 int value;
                 ioctl(socket, SIOCINQ, &value);
-                int nenq=value/sizeof(tuple_t);
+                int nenq=(value+reader.buffered())/sizeof(wire_quote_t);
 
                 if(nenq>10000)//force scaleup by saying that ta is smaller than the currently monitored
                 {
@@ -417,8 +555,8 @@ void *emitter(void *args)
 
                 bsend(monitoring,cn_outqueue); //pay attention, if queue is full it is blocked
                 monitoring_timer=current_time_usecs();
-                //create a new message
-                monitoring=new msg::EmitterMonitoring(num_classes);
+                //take a new message
+                monitoring=mon_ring->next();
                 monitoring_timer+=monitoring_step_usecs;
 
 				//reset variables for variance calculation
@@ -427,7 +565,13 @@ void *emitter(void *args)
             }
 			
 		#endif
-        if((ret=socket_receive(socket, tb, sizeof(tuple_t)))!=sizeof(tuple_t))
+        if(reader.buffered()<sizeof(wire_quote_t))
+        {
+            //the next receive may block: send what has been staged so far
+            for(int i=0;i<num_workers;i++)
+                channels[i].flush();
+        }
+        if((rcvd=(const wire_quote_t *)reader.next(sizeof(wire_quote_t)))==NULL)
 		{
             cerr << ANSI_COLOR_RED "[EMITTER] Error in receiving from the  socket. The operator is a bottleneck?"<<endl;
 			exit(BOTTLENECK_ERR);
@@ -447,11 +591,17 @@ void *emitter(void *args)
             //check if there are newly spawned threads
             if(reconf_data->par_degree_changes>0)
             {
+                //take the new queues (they will receive only the EOS)
+                for(int i=0;i<reconf_data->par_degree_changes;i++)
+                {
+                    outqueue[num_workers+i]=reconf_data->wqueues[i];
+                    channels[num_workers+i].bind(reconf_data->wqueues[i]);
+                }
                 //increments the par degree
                 num_workers+=reconf_data->par_degree_changes;
             }
 
-            msg::EmitterMonitoring* reconf_finished=new msg::EmitterMonitoring(0);
+            msg::EmitterMonitoring* reconf_finished=mon_ring->next();
             reconf_finished->tag=msg::MonitoringTag::RECONF_FINISHED_TAG;
             bsend((void*)reconf_finished,cn_outqueue);
 
@@ -463,7 +613,8 @@ void *emitter(void *args)
 	for(int i=0;i<num_workers;i++)
 	{
 		//printf("Emitter, send EOS to:%d\n",i);
-		send(tb,outqueue[i]);
+		channels[i].push(&eos_t);
+		channels[i].flush();
 	}
 	
 	#if defined(MONITORING)
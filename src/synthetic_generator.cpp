@@ -44,6 +44,7 @@
 #include "../includes/cycle.h"
 #include "../includes/general.h"
 #include "../includes/utils.h"
+#include "../includes/wire_format.hpp"
 
 
 int num_task=1000000;
@@ -243,8 +244,17 @@ int main(int argc, char *argv[])
 	RandomGenerator generator(1);
     double waitingTime=(((double)1000000000)/(rate)); //expressed in nano secs
 	
+	//send the header of the stream
+	wire_header_t header;
+	wire_header(&header);
+	if((ret=socket_send(socket,&header,sizeof(wire_header_t)))!=sizeof(wire_header_t))
+	{
+		fprintf(stderr,"Error in sending the header of the stream\n");
+		exit(-1);
+	}
+
 	//send the first dummy task for synchronizing the global start time...
-    tuple_t t;
+    wire_quote_t t;
 	t.type=-10;
     ticks no_more_init=(unsigned long long)NO_MORE_INIT;
 
@@ -252,8 +262,8 @@ int main(int argc, char *argv[])
     timestamp_t start_t=current_time_usecs();
     //start from zero
     t.timestamp=0;
-    t.original_timestamp=0;
-    if((ret=socket_send(socket,&t,sizeof(tuple_t)))!=sizeof(tuple_t))
+    t.ts_delta=0;
+    if((ret=socket_send(socket,&t,sizeof(wire_quote_t)))!=sizeof(wire_quote_t))
 	{
 			fprintf(stderr,"The receiving program is a bottlenck\n");
 			exit(BOTTLENECK_ERR);
@@ -262,8 +272,8 @@ int main(int argc, char *argv[])
         bool bsend=true;
 	int sent=0;
 	long int start_slot=start_t;
-    tuple_t task;
-	task.original_timestamp=0;
+    wire_quote_t task;
+	task.ts_delta=0;
 	task.timestamp=0;
     double next_send_time_nsecs=0;          //the time (in nanosec) at which the next tuple has to be sent
     long start_time=current_time_nsecs();
@@ -297,7 +307,6 @@ int main(int argc, char *argv[])
 		}
 
         //fill the tuple
-        task.id=i;
 		task.type=generateRandomClass(distributions[act_distr],numb_class);
 		// printf("Invio classe: %d\n",task.type);
 		task.bid_price=generator.uniform(100, 200);
@@ -311,15 +320,15 @@ int main(int argc, char *argv[])
         while(curr_t<end_wait)
             curr_t=current_time_nsecs();
        //T task.timestamp=(curr_t-start_time)/1000;
-        task.original_timestamp=((int)(task.timestamp/1000))*1000;
+        task.ts_delta=((int)(task.timestamp/1000))*1000-task.timestamp;
        // printf("%Ld %Ld\n",task.timestamp ,task.original_timestamp);
         //altrimenti:
         //-ri-timstampa qui, con il minimo tra next_send... e tempo attuale
         //- la attesa sopra la fai sul timestamp
         //---- in questa maniera non gestisci il collo di bottiglia però!!
-        ret=socket_send(socket,&task,sizeof(tuple_t));
+        ret=socket_send(socket,&task,sizeof(wire_quote_t));
 
-        if(ret!=sizeof(tuple_t))
+        if(ret!=sizeof(wire_quote_t))
 		{
 			if(ret==BOTTLENECK_ERR)
 			{
@@ -329,7 +338,7 @@ int main(int argc, char *argv[])
 		}
         next_send_time_nsecs+=waitingTime;
         task.timestamp=(long)(next_send_time_nsecs/1000.0);  //the timestamp is in usec basis
-         task.original_timestamp=((int)(task.timestamp/1000))*1000;
+        task.ts_delta=((int)(task.timestamp/1000))*1000-task.timestamp;
 
         //T task.timestamp=task.timestamp+waitingTime; //nsecs
         if(bsend && current_time_usecs()-start_t>no_more_init)
@@ -343,7 +352,7 @@ int main(int argc, char *argv[])
 		sent++;
 	}
 	task.type=-1;
-    if((ret=socket_send(socket,&task,sizeof(tuple_t)))!=sizeof(tuple_t))
+    if((ret=socket_send(socket,&task,sizeof(wire_quote_t)))!=sizeof(wire_quote_t))
 	{
 		if(ret==BOTTLENECK_ERR)
 		{
@@ -0,0 +1,169 @@
+/*
+ * ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include "../includes/general.h"
+#include "../includes/ohlc.hpp"
+
+using namespace std;
+
+//Micro-benchmark of the candlestick computation over the last window slide:
+//the original branchy loop over the tuples is compared against the kernels on the
+//structure of arrays layout used by CBWindow.
+//Usage: bench-ohlc [iterations]
+
+/**
+ * The loop originally used in CBWindow::compute
+ */
+void ohlc_tuples(const tuple_t *elements, int n, candlestick_t *cbid, candlestick_t *cask)
+{
+    ohlc_init(cbid);
+    ohlc_init(cask);
+    int last_valid_bid=0, last_valid_ask=0;
+    for(int i=0;i<n;i++)
+    {
+        if(elements[i].bid_size>0)
+        {
+            if(cbid->open==0)
+                cbid->open=elements[i].bid_price;
+            if(elements[i].bid_price>cbid->high)
+                cbid->high=elements[i].bid_price;
+            if(elements[i].bid_price<cbid->low)
+                cbid->low=elements[i].bid_price;
+            last_valid_bid=i;
+        }
+        if(elements[i].ask_size>0)
+        {
+            if(cask->open==0)
+                cask->open=elements[i].ask_price;
+            if(elements[i].ask_price>cask->high)
+                cask->high=elements[i].ask_price;
+            if(elements[i].ask_price<cask->low)
+                cask->low=elements[i].ask_price;
+            last_valid_ask=i;
+        }
+    }
+    cbid->close=elements[last_valid_bid].bid_price;
+    cask->close=elements[last_valid_ask].ask_price;
+}
+
+bool same(const candlestick_t &a, const candlestick_t &b)
+{
+    return a.open==b.open && a.close==b.close && a.high==b.high && a.low==b.low;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations=(argc>1)?atoi(argv[1]):100000;
+    const int max_slide=1024;
+    //a pool of quotes from which slides are taken at different offsets
+    const int pool=max_slide*16;
+    std::mt19937 gen(7);
+    tuple_t *tuples=new tuple_t[pool];
+    float *bid, *ask;
+    if(posix_memalign((void **)&bid,CACHE_LINE_SIZE,pool*sizeof(float))!=0 || posix_memalign((void **)&ask,CACHE_LINE_SIZE,pool*sizeof(float))!=0)
+    {
+        cerr << "Error in allocating memory" <<endl;
+        exit(-1);
+    }
+    for(int i=0;i<pool;i++)
+    {
+        tuples[i].bid_price=50+(gen()%10000)/100.0;
+        tuples[i].ask_price=tuples[i].bid_price+0.01;
+        //about one quote in five misses one of the two sides
+        tuples[i].bid_size=(gen()%10==0)?0:1+gen()%100;
+        tuples[i].ask_size=(gen()%10==0)?0:1+gen()%100;
+        bid[i]=tuples[i].bid_size>0?tuples[i].bid_price:NAN;
+        ask[i]=tuples[i].ask_size>0?tuples[i].ask_price:NAN;
+    }
+
+    struct{
+        const char *name;
+        ohlc_kernel_t kernel;
+        bool supported;
+    }kernels[]={
+        {"scalar",ohlc_scalar,true},
+#if defined(OHLC_X86_DISPATCH)
+        {"avx2",ohlc_avx2,(bool)__builtin_cpu_supports("avx2")},
+#if defined(OHLC_AVX512)
+        {"avx512",ohlc_avx512,(bool)__builtin_cpu_supports("avx512f")},
+#endif
+#endif
+    };
+    int nkernels=sizeof(kernels)/sizeof(kernels[0]);
+
+    cout << "Nanoseconds per slide (both sides), "<<iterations<<" iterations"<<endl;
+    cout << setw(8)<<"slide"<<setw(12)<<"tuples";
+    for(int k=0;k<nkernels;k++)
+        cout <<setw(12)<<kernels[k].name;
+    cout <<endl;
+    int slides[]={1,5,10,25,50,100,250,500,1000};
+    volatile float sink=0;
+    for(int slide:slides)
+    {
+        int offsets=pool/slide;
+        cout << setw(8)<<slide;
+        //original loop
+        candlestick_t rb, ra, cb, ca;
+        long start=current_time_nsecs();
+        for(int it=0;it<iterations;it++)
+        {
+            ohlc_tuples(tuples+(it%offsets)*slide,slide,&rb,&ra);
+            sink+=rb.close+ra.close;
+        }
+        cout << setw(12)<<fixed<<setprecision(1)<<(double)(current_time_nsecs()-start)/iterations;
+        for(int k=0;k<nkernels;k++)
+        {
+            if(!kernels[k].supported)
+            {
+                cout << setw(12)<<"-";
+                continue;
+            }
+            //check the correctness against the scalar version
+            for(int o=0;o<offsets;o++)
+            {
+                candlestick_t sb, sa;
+                ohlc_scalar(bid+o*slide,ask+o*slide,slide,&sb,&sa);
+                kernels[k].kernel(bid+o*slide,ask+o*slide,slide,&cb,&ca);
+                if(!same(sb,cb) || !same(sa,ca))
+                {
+                    cerr << ANSI_COLOR_RED "Kernel "<<kernels[k].name<<" differs from the scalar version (slide "<<slide<<", offset "<<o<<")" ANSI_COLOR_RESET<<endl;
+                    exit(-1);
+                }
+            }
+            start=current_time_nsecs();
+            for(int it=0;it<iterations;it++)
+            {
+                kernels[k].kernel(bid+(it%offsets)*slide,ask+(it%offsets)*slide,slide,&cb,&ca);
+                sink+=cb.close+ca.close;
+            }
+            cout << setw(12)<<fixed<<setprecision(1)<<(double)(current_time_nsecs()-start)/iterations;
+        }
+        cout <<endl;
+    }
+    free(bid);
+    free(ask);
+    delete[] tuples;
+}
@@ -0,0 +1,214 @@
+/*
+ * ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+*/
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include "../includes/general.h"
+#include "../includes/strategies.hpp"
+
+using namespace std;
+
+//Benchmark of the resolution of the strategies for different maximum parallelism degrees and horizons:
+//- response time (Lat-Node): the exhaustive search (resolve_strategy_rt) is compared against
+//  the dynamic programming one (resolve_strategy_rt_dp);
+//- response time and power (Lat-Power): the branch and bound (resolve_strategy_energy_rt_bb)
+//  is compared against the dynamic programming one (resolve_strategy_energy_rt_dp) for
+//  a synthetic voltage table.
+//For each problem the two solvers must return the same trajectory. The objective values are computed with
+//the same operations, but the compiler may contract them differently in the two solvers (e.g. with FMA):
+//they are compared with a relative tolerance.
+//Usage: bench-strategies [problems]
+
+/**
+ * @brief same_value compares two values computed by different solvers
+ */
+bool same_value(double a, double b)
+{
+    return a==b || fabs(a-b)<=1e-12*fmax(fabs(a),fabs(b));
+}
+
+int main(int argc, char *argv[])
+{
+    int problems=(argc>1)?atoi(argv[1]):20;
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> unif(0,1);
+    //parameters of the strategy (as in the configuration files)
+    const double rt_threshold=1000, alpha=2, beta=0.5, gamma=0.4;
+    const double tcalc=450;          //usecs per tuple with one replica
+    int degrees[]={4,8,16,24,32};
+    int horizons[]={1,2,3,4};
+    //the exhaustive search is skipped above this number of trajectories
+    const double max_enumerated=2e7;
+    int mismatches=0;
+
+    cout << "Microseconds per resolution (average over "<<problems<<" problems)"<<endl;
+    cout << setw(6)<<"N"<<setw(4)<<"h"<<setw(16)<<"exhaustive"<<setw(12)<<"dp"<<setw(12)<<"speedup"<<endl;
+    for(int n:degrees)
+    {
+        for(int h:horizons)
+        {
+            bool run_exhaustive=pow((double)n,h)<=max_enumerated;
+            double *forecasted=new double[h];
+            int *reconf_vector=new int[h]();
+            //not modified if there is not an admissible trajectory
+            int *res_ex=new int[h]();
+            int *res_dp=new int[h]();
+            long t_ex=0, t_dp=0;
+            for(int p=0;p<problems;p++)
+            {
+                //arrival rates (tuples per usec) that require from 1 to n replicas
+                for(int j=0;j<h;j++)
+                    forecasted[j]=(0.5+unif(gen)*(n-0.5))*MAX_RHO_MODULE/tcalc;
+                int curr=1+gen()%n;
+                double c_arr=0.5+unif(gen), c_serv=0.5+unif(gen), ksf=0.5+unif(gen);
+                double min_ex=INT_MAX, min_dp=INT_MAX;
+                double rt_ex=0, rt_dp=0, king_ex=0, king_dp=0;
+                long start;
+                if(run_exhaustive)
+                {
+                    start=current_time_nsecs();
+                    resolve_strategy_rt(h,0,n,reconf_vector,forecasted,tcalc,rt_threshold,c_arr,c_serv,ksf,alpha,beta,gamma,curr,res_ex,&min_ex,&rt_ex,&king_ex);
+                    t_ex+=current_time_nsecs()-start;
+                }
+                start=current_time_nsecs();
+                resolve_strategy_rt_dp(h,n,forecasted,tcalc,rt_threshold,c_arr,c_serv,ksf,alpha,beta,gamma,curr,res_dp,&min_dp,&rt_dp,&king_dp);
+                t_dp+=current_time_nsecs()-start;
+                if(run_exhaustive)
+                {
+                    bool same=same_value(rt_ex,rt_dp);
+                    for(int j=0;j<h;j++)
+                        same=same && (res_ex[j]==res_dp[j]);
+                    if(!same)
+                    {
+                        cerr << ANSI_COLOR_RED "Different trajectories for N="<<n<<" h="<<h<<":";
+                        for(int j=0;j<h;j++)
+                            cerr << " "<<res_ex[j]<<"/"<<res_dp[j];
+                        cerr << ANSI_COLOR_RESET<<endl;
+                        mismatches++;
+                    }
+                }
+            }
+            cout << setw(6)<<n<<setw(4)<<h;
+            if(run_exhaustive)
+                cout <<setw(16)<<fixed<<setprecision(2)<<(double)t_ex/(problems*1000.0);
+            else
+                cout <<setw(16)<<"-";
+            cout <<setw(12)<<fixed<<setprecision(2)<<(double)t_dp/(problems*1000.0);
+            if(run_exhaustive)
+                cout <<setw(12)<<fixed<<setprecision(1)<<(double)t_ex/t_dp;
+            cout <<endl;
+            delete[] forecasted;
+            delete[] reconf_vector;
+            delete[] res_ex;
+            delete[] res_dp;
+        }
+    }
+
+    //Lat-Power: frequencies from 1.2 to 2.6 GHz (in KHz, as returned by Mammut) with 100 MHz steps
+    vector<mammut::cpufreq::Frequency> frequencies;
+    for(int f=1200000;f<=2600000;f+=100000)
+        frequencies.push_back(f);
+    //voltage grows with the frequency and (slightly) with the number of active cores
+    map<pair<int,int>,double> voltages;
+    for(int n=1;n<=32+4;n++)
+        for(mammut::cpufreq::Frequency f:frequencies)
+            voltages[make_pair(n,(int)f)]=0.7+0.4*(f-frequencies.front())/(double)(frequencies.back()-frequencies.front())+0.002*n;
+    //the branch and bound is skipped if it takes too long (its cost depends on the data)
+    const long max_bb_nsecs=10000000000L;
+    cout << endl<<"Lat-Power, "<<frequencies.size()<<" frequencies"<<endl;
+    cout << setw(6)<<"N"<<setw(4)<<"h"<<setw(16)<<"branch&bound"<<setw(12)<<"dp"<<setw(12)<<"speedup"<<endl;
+    for(int n:degrees)
+    {
+        for(int h:horizons)
+        {
+            bool run_bb=true;
+            double *forecasted=new double[h];
+            reconf_choice_energy_t *reconf_vector=new reconf_choice_energy_t[h]();
+            reconf_choice_energy_t *res_bb=new reconf_choice_energy_t[h]();
+            reconf_choice_energy_t *res_dp=new reconf_choice_energy_t[h]();
+            long t_bb=0, t_dp=0;
+            int p;
+            for(p=0;p<problems;p++)
+            {
+                for(int j=0;j<h;j++)
+                    forecasted[j]=(0.5+unif(gen)*(n-0.5))*MAX_RHO_MODULE/tcalc;
+                int curr=1+gen()%n;
+                mammut::cpufreq::Frequency curr_freq=frequencies[gen()%frequencies.size()];
+                double c_arr=0.5+unif(gen), c_serv=0.5+unif(gen), ksf=0.5+unif(gen);
+                double min_bb=INT_MAX, min_dp=INT_MAX;
+                double rt_bb=0, rt_dp=0, king_bb=0, king_dp=0;
+                long start;
+                if(run_bb)
+                {
+                    start=current_time_nsecs();
+                    resolve_strategy_energy_rt_bb(h,0,0,0,0,n,frequencies,&voltages,reconf_vector,forecasted,tcalc,rt_threshold,c_arr,c_serv,ksf,alpha,beta,gamma,curr,curr_freq,res_bb,&min_bb,&rt_bb,&king_bb);
+                    t_bb+=current_time_nsecs()-start;
+                    run_bb=t_bb<max_bb_nsecs;
+                }
+                start=current_time_nsecs();
+                resolve_strategy_energy_rt_dp(h,n,frequencies,&voltages,forecasted,tcalc,rt_threshold,c_arr,c_serv,ksf,alpha,beta,gamma,curr,curr_freq,res_dp,&min_dp,&rt_dp,&king_dp);
+                t_dp+=current_time_nsecs()-start;
+                if(t_bb>0)
+                {
+                    bool same=same_value(min_bb,min_dp) && same_value(rt_bb,rt_dp);
+                    for(int j=0;j<h;j++)
+                        same=same && (res_bb[j].nw==res_dp[j].nw) && (res_bb[j].freq==res_dp[j].freq);
+                    if(!same)
+                    {
+                        cerr << ANSI_COLOR_RED "Different trajectories for N="<<n<<" h="<<h<<":";
+                        for(int j=0;j<h;j++)
+                            cerr << " ["<<res_bb[j].nw<<","<<res_bb[j].freq<<"]/["<<res_dp[j].nw<<","<<res_dp[j].freq<<"]";
+                        cerr << ANSI_COLOR_RESET<<endl;
+                        mismatches++;
+                    }
+                }
+                if(!run_bb)
+                {
+                    p++;
+                    break;
+                }
+            }
+            cout << setw(6)<<n<<setw(4)<<h;
+            //if it has been stopped, the branch and bound is reported on the problems it has solved
+            if(t_bb>0)
+                cout <<setw(16)<<fixed<<setprecision(2)<<(double)t_bb/(p*1000.0);
+            else
+                cout <<setw(16)<<"-";
+            cout <<setw(12)<<fixed<<setprecision(2)<<(double)t_dp/(p*1000.0);
+            if(t_bb>0)
+                cout <<setw(12)<<fixed<<setprecision(1)<<(double)t_bb/t_dp;
+            cout <<endl;
+            delete[] forecasted;
+            delete[] reconf_vector;
+            delete[] res_bb;
+            delete[] res_dp;
+        }
+    }
+
+    if(mismatches>0)
+    {
+        cerr << ANSI_COLOR_RED << mismatches<<" problems with different solutions"<< ANSI_COLOR_RESET<<endl;
+        return -1;
+    }
+    return 0;
+}
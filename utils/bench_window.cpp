@@ -0,0 +1,107 @@
+/*
+ * ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+*/
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include "../includes/general.h"
+#include "../includes/cbwindow.hpp"
+#include "../includes/pane_window.hpp"
+
+using namespace std;
+
+//Micro-benchmark of the windows: the same stream of quotes is inserted in a CBWindow and in
+//a PaneWindow, computing at every slide. Results are checked against each other and the
+//time per quote (insertion plus the share of the computation) and the memory of a window are reported.
+//Usage: bench-window [quotes]
+
+/**
+ * Inserts the quotes and computes at each slide
+ * @return nanoseconds per quote
+ */
+template <typename W>
+double run(W &w, const tuple_t *tuples, int n, winresult_t *res)
+{
+    int r=0;
+    long start=current_time_nsecs();
+    for(int i=0;i<n;i++)
+    {
+        w.insert(tuples[i]);
+        if(w.isComputable())
+            w.compute(res[r++]);
+    }
+    return (double)(current_time_nsecs()-start)/n;
+}
+
+bool close_to(double a, double b)
+{
+    return (std::isnan(a) && std::isnan(b)) || fabs(a-b)<=1e-5*(fabs(a)+fabs(b)+1e-9);
+}
+
+int main(int argc, char *argv[])
+{
+    int n=(argc>1)?atoi(argv[1]):1000000;
+    std::mt19937 gen(7);
+    tuple_t *tuples=new tuple_t[n];
+    long ts=1000000;
+    for(int i=0;i<n;i++)
+    {
+        //about two quotes in three have the same timestamp of the previous one
+        if(gen()%3==0)
+            ts+=1+gen()%3;
+        tuples[i].original_timestamp=ts;
+        tuples[i].bid_price=50+(gen()%10000)/100.0;
+        tuples[i].ask_price=tuples[i].bid_price+0.01;
+        tuples[i].bid_size=(gen()%10==0)?0:1+gen()%100;
+        tuples[i].ask_size=(gen()%10==0)?0:1+gen()%100;
+    }
+
+    cout << "Nanoseconds per quote, "<<n<<" quotes"<<endl;
+    cout << setw(8)<<"size"<<setw(8)<<"slide"<<setw(12)<<"cbwindow"<<setw(12)<<"pane"<<setw(14)<<"cb bytes"<<setw(14)<<"pane bytes"<<endl;
+    int configs[][2]={{1000,1},{1000,10},{1000,50},{1000,100},{1000,250},{1000,1000},{10000,100},{10000,1000}};
+    for(auto &c:configs)
+    {
+        int size=c[0], slide=c[1];
+        winresult_t *rcb=new winresult_t[n/slide+1];
+        winresult_t *rpane=new winresult_t[n/slide+1];
+        CBWindow cb(size,slide);
+        PaneWindow pane(size,slide);
+        double tcb=run(cb,tuples,n,rcb);
+        double tpane=run(pane,tuples,n,rpane);
+        for(int r=0;r<n/slide;r++)
+        {
+            double a[]={rcb[r].p0_bid,rcb[r].p1_bid,rcb[r].p2_bid,rcb[r].p0_ask,rcb[r].p1_ask,rcb[r].p2_ask,rcb[r].open_bid,rcb[r].close_bid,rcb[r].high_bid,rcb[r].low_bid};
+            double b[]={rpane[r].p0_bid,rpane[r].p1_bid,rpane[r].p2_bid,rpane[r].p0_ask,rpane[r].p1_ask,rpane[r].p2_ask,rpane[r].open_bid,rpane[r].close_bid,rpane[r].high_bid,rpane[r].low_bid};
+            for(int k=0;k<10;k++)
+                if(!close_to(a[k],b[k]))
+                {
+                    cerr << ANSI_COLOR_RED "PaneWindow differs from CBWindow (size "<<size<<", slide "<<slide<<", result "<<r<<")" ANSI_COLOR_RESET<<endl;
+                    exit(-1);
+                }
+        }
+        cout << setw(8)<<size<<setw(8)<<slide<<setw(12)<<fixed<<setprecision(1)<<tcb<<setw(12)<<tpane;
+        cout << setw(14)<<sizeof(CBWindow)+CBWindow::storageSize(size,slide)<<setw(14)<<sizeof(PaneWindow)+PaneWindow::storageSize(size,slide)<<endl;
+        delete[] rcb;
+        delete[] rpane;
+    }
+    delete[] tuples;
+}
@@ -0,0 +1,301 @@
+/*
+ * ---------------------------------------------------------------------
+
+    Copyright (C) 2015- by Tiziano De Matteis (dematteis <at> di.unipi.it)
+
+    This file is part of elastic-hft.
+
+    elastic-hft is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+    ---------------------------------------------------------------------
+*/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <limits>
+#include "../includes/general.h"
+#include "../includes/strategy_descriptor.hpp"
+#include "../includes/strategies.hpp"
+#include "../includes/forecaster.hpp"
+#include "../includes/strategy_trace.hpp"
+#include "../includes/utils.h"
+
+using namespace std;
+
+//Offline replay of a strategy over a trace recorded by the controller (trace_file parameter).
+//The workload of each control step (arrival rate, calculation time, coefficients of variation) is
+//taken from the trace, while the configuration (replicas and frequency) is the one chosen by the
+//strategy under test. The latency of a step is estimated with the Kingman formula, scaled by
+//the ratio between the latency measured in the recorded run and the one predicted by Kingman
+//for the recorded configuration (the ksf correction used by the controller).
+//The calculation time is scaled with the frequency (tcalc*recorded_freq/freq).
+//Usage: strategy-sim <config_file> <trace_file> [voltage_table (default ./voltages.txt)] [output_file]
+
+/**
+ * Expected waiting time according to Kingman for a module with n replicas (msec),
+ * infinity if it is a bottleneck
+ */
+double kingman_wait(double tcalc, double rate, int n, double c_arr, double c_serv)
+{
+    double rho=tcalc*rate/n;
+    if(rho>=1)
+        return std::numeric_limits<double>::infinity();
+    return (rho/(1-rho))*((c_arr*c_arr+c_serv*c_serv)/2)*(tcalc/n);
+}
+
+/**
+ * Statistics of a run (simulated or recorded)
+ */
+typedef struct{
+    int steps;
+    int violations;
+    int bottlenecks;
+    double replica_seconds;
+    int reconf;
+    int reconf_par_degree;
+    int reconf_freq;
+}run_stats_t;
+
+void account(run_stats_t *st, int n, uint32_t f, int prev_n, uint32_t prev_f, double lat, double threshold, bool check_threshold, double step_secs)
+{
+    st->steps++;
+    st->replica_seconds+=n*step_secs;
+    if(lat==std::numeric_limits<double>::infinity())
+        st->bottlenecks++;
+    if(check_threshold && lat>threshold)
+        st->violations++;
+    if(st->steps>1)
+    {
+        if(n!=prev_n)
+            st->reconf_par_degree++;
+        if(f!=prev_f)
+            st->reconf_freq++;
+        if(n!=prev_n || f!=prev_f)
+            st->reconf++;
+    }
+}
+
+void print(const char *name, const run_stats_t &st, double step_secs, bool check_threshold, bool energy)
+{
+    cout << "#"<<name<<endl;
+    if(check_threshold)
+        cout << "#Violations wrt the threshold:          "<<st.violations<<" ("<<fixed<<setprecision(1)<<100.0*st.violations/st.steps<<"% of the steps)"<<endl;
+    cout << "#Steps with a bottleneck:               "<<st.bottlenecks<<endl;
+    cout << "#Replica-seconds:                       "<<fixed<<setprecision(1)<<st.replica_seconds<<endl;
+    cout << "#Average Number of used replica:        "<<fixed<<setprecision(3)<<((st.steps>0)?st.replica_seconds/(st.steps*step_secs):0)<<endl;
+    cout << "#Total number of reconfigurations:      "<<st.reconf<<endl;
+    if(energy)
+    {
+        cout << "#Adjustments to the number of replicas: "<<st.reconf_par_degree<<endl;
+        cout << "#Adjustements to the CPU frequency:     "<<st.reconf_freq<<endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc<3)
+    {
+        cerr << "Usage: "<<argv[0]<<" <config_file> <trace_file> [voltage_table] [output_file]"<<endl;
+        return -1;
+    }
+    StrategyDescriptor *sd;
+    try{
+        sd=new StrategyDescriptor(argv[1]);
+    }catch(std::exception &e){
+        cerr << ANSI_COLOR_RED "Error in reading the configuration file: "<<e.what()<< ANSI_COLOR_RESET<<endl;
+        return -1;
+    }
+    trace_header_t header;
+    vector<uint32_t> trace_freqs;
+    vector<trace_step_t> steps;
+    if(!readTrace(argv[2],&header,trace_freqs,steps) || steps.empty())
+    {
+        cerr << ANSI_COLOR_RED "Error in reading the trace "<<argv[2]<< ANSI_COLOR_RESET<<endl;
+        return -1;
+    }
+    sd->print();
+    if(sd->type!=StrategyType::NONE && sd->control_step!=header.control_step)
+        cerr << ANSI_COLOR_YELLOW "Warning: the trace has been recorded with a control step of "<<header.control_step<<" msec, it will be used"<< ANSI_COLOR_RESET<<endl;
+
+    const int max_workers=header.max_workers;
+    const double step_secs=header.control_step/1000.0;
+    const bool energy=(sd->type==StrategyType::LATENCY_ENERGY);
+    const bool check_threshold=(sd->type==StrategyType::LATENCY || sd->type==StrategyType::LATENCY_ENERGY || sd->type==StrategyType::LATENCY_RULE);
+    vector<mammut::cpufreq::Frequency> available_frequencies(trace_freqs.begin(),trace_freqs.end());
+    map<pair<int,int>,double> *voltages=nullptr;
+    if(energy)
+    {
+        if(available_frequencies.empty())
+        {
+            cerr << ANSI_COLOR_RED "The trace does not contain the available frequencies"<< ANSI_COLOR_RESET<<endl;
+            return -1;
+        }
+        try{
+            voltages=loadVoltageTable(argc>3?argv[3]:"./voltages.txt");
+        }catch(std::exception &e){
+            cerr << ANSI_COLOR_RED << e.what()<< ANSI_COLOR_RESET<<endl;
+            return -1;
+        }
+    }
+    FILE *fout=nullptr;
+    if(argc>4)
+    {
+        fout=fopen(argv[4],"w");
+        if(fout==nullptr)
+        {
+            cerr << ANSI_COLOR_RED "Error in opening the output file "<<argv[4]<< ANSI_COLOR_RESET<<endl;
+            return -1;
+        }
+        fprintf(fout,"#Time\tRate\tNum_replicas\tCpu_Freq\tLatency\tRec_Num_replicas\tRec_Latency\n");
+    }
+
+    //state of the controller (as in controller.cpp)
+    Forecaster *forecaster=nullptr;
+    double *forecasted=nullptr;
+    int *pred_trajectory=nullptr;
+    reconf_choice_energy_t *pred_trajectory_energy=nullptr;
+    if(sd->predictive)
+    {
+        forecaster=createForecaster(sd);
+        forecasted=new double[sd->horizon]();
+        pred_trajectory=new int[sd->horizon]();
+        pred_trajectory_energy=new reconf_choice_energy_t[sd->horizon]();
+    }
+    int current_level=steps[0].num_workers;
+    int *p_i=nullptr,*thr_first_i=nullptr,*thr_last_i=nullptr;
+    bool *c_i=nullptr;
+    double s=0;
+    if(sd->type==StrategyType::TPDS)
+    {
+        p_i=new int[sd->max_level+1]();
+        c_i=new bool[sd->max_level+1]();
+        thr_first_i=new int[sd->max_level+1]();
+        thr_last_i=new int[sd->max_level+1]();
+        s=0.1+(1.0-sd->change_sensitivity)*0.9;
+        for(int i=0;i<=sd->max_level;i++)
+        {
+            p_i[i]=-1;
+            c_i[i]=true;
+            thr_last_i[i]=INT_MAX;
+            thr_first_i[i]=-1;
+        }
+    }
+    double ksf=1, ksf_samples[3]={1,1,1};
+    int ksf_samples_idx=0;
+    double kingman_prev=0, exp_rt=0;
+    double mape_sum=0;
+    int mape_count=0;
+
+    //simulated configuration
+    int num_workers=steps[0].num_workers;
+    mammut::cpufreq::Frequency frequency=steps[0].frequency;
+    int prev_n=num_workers, rec_prev_n=num_workers;
+    uint32_t prev_f=frequency, rec_prev_f=frequency;
+    double ksf_true=1;          //correction of Kingman measured in the recorded run
+    run_stats_t sim, rec;
+    memset(&sim,0,sizeof(sim));
+    memset(&rec,0,sizeof(rec));
+    long start=current_time_usecs();
+
+    for(size_t k=0;k<steps.size();k++)
+    {
+        const trace_step_t &t=steps[k];
+        double rate=t.trigger_per_second/1000.0;   //per msec
+        //correction measured in the recorded run
+        double w_rec=kingman_wait(t.module_tcalc,rate,t.num_workers,t.c_arr,t.c_serv);
+        if(t.avg_lat>0 && w_rec>0 && w_rec<std::numeric_limits<double>::infinity())
+            ksf_true=MAX(0,(t.avg_lat/1000.0-t.module_tcalc)/w_rec);
+        //the simulated step
+        double tcalc=(t.frequency>0 && frequency>0)?t.module_tcalc*t.frequency/frequency:t.module_tcalc;
+        double wait=kingman_wait(tcalc,rate,num_workers,t.c_arr,t.c_serv);
+        double lat=tcalc+wait*ksf_true;
+        account(&sim,num_workers,frequency,prev_n,prev_f,lat,sd->threshold,check_threshold,step_secs);
+        account(&rec,t.num_workers,t.frequency,rec_prev_n,rec_prev_f,t.avg_lat/1000.0,sd->threshold,check_threshold,step_secs);
+        if(fout)
+            fprintf(fout,"%-6.3f\t%-6.4f\t%-6d\t%-6d\t%-6.4f\t%-6d\t%-6.4f\n",t.time,rate,num_workers,(int)frequency,lat,t.num_workers,t.avg_lat/1000.0);
+        prev_n=num_workers;
+        prev_f=frequency;
+        rec_prev_n=t.num_workers;
+        rec_prev_f=t.frequency;
+
+        //decision of the strategy
+        int n_opt=num_workers;
+        mammut::cpufreq::Frequency freq_opt=frequency;
+        if(sd->predictive)
+        {
+            if(k>0 && rate>0)
+            {
+                mape_sum+=100*fabs(rate-forecasted[0])/rate;
+                mape_count++;
+            }
+            forecaster->update(rate);
+            forecaster->forecast(sd->horizon,forecasted);
+            if(k>2 && kingman_prev>0 && lat<std::numeric_limits<double>::infinity())
+            {
+                ksf_samples[ksf_samples_idx]=(lat-tcalc)/kingman_prev;
+                ksf=(ksf_samples[0]+ksf_samples[1]+ksf_samples[2])/3;
+                ksf_samples_idx=(ksf_samples_idx+1)%3;
+            }
+            if(sd->type==StrategyType::LATENCY)
+            {
+                predict_reconf_rt(sd,max_workers,num_workers,forecasted,tcalc,t.c_arr,t.c_serv,ksf,pred_trajectory,&exp_rt,&kingman_prev);
+                n_opt=pred_trajectory[0];
+            }
+            else
+            {
+                predict_reconf_energy_rt(sd,max_workers,available_frequencies,voltages,num_workers,frequency,forecasted,tcalc,t.c_arr,t.c_serv,ksf,pred_trajectory_energy,&exp_rt,&kingman_prev);
+                n_opt=pred_trajectory_energy[0].nw;
+                freq_opt=pred_trajectory_energy[0].freq;
+            }
+        }
+        else
+            if(sd->type==StrategyType::TPDS)
+            {
+                //results per second and congestion of the splitter as if the module were a bottleneck
+                double capacity=num_workers/tcalc;
+                int thr=(int)(MIN(rate,capacity)*1000);
+                bool congestion=(wait==std::numeric_limits<double>::infinity());
+                n_opt=predict_tpds(sd,k,&current_level,thr,congestion,p_i,c_i,thr_last_i,thr_first_i,s);
+            }
+            else
+                if(sd->type==StrategyType::LATENCY_RULE)
+                {
+                    if(lat>sd->threshold*1.1)
+                        n_opt=MIN(num_workers+1,max_workers);
+                    if(lat<sd->threshold*0.7)
+                        n_opt=MAX(num_workers-1,1);
+                }
+        if(n_opt<=0)
+            n_opt=1;
+        if(n_opt>max_workers)
+            n_opt=max_workers;
+        //as in the controller, the first steps are not used for reconfiguring
+        if(k>1 && sd->type!=StrategyType::NONE)
+        {
+            num_workers=n_opt;
+            if(freq_opt!=0)
+                frequency=freq_opt;
+        }
+    }
+    long elapsed=current_time_usecs()-start;
+
+    cout << "#Replayed "<<steps.size()<<" control steps of "<<header.control_step<<" msec in "<<elapsed/1000.0<<" msec"<<endl;
+    print("Simulated",sim,step_secs,check_threshold,energy);
+    if(sd->predictive && mape_count>0)
+        cout << "#Forecast MAPE:                         "<<fixed<<setprecision(2)<<mape_sum/mape_count<<"%"<<endl;
+    print("Recorded run",rec,step_secs,check_threshold,energy);
+    if(fout)
+        fclose(fout);
+    return 0;
+}